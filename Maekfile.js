@@ -40,9 +40,19 @@ const main_objs = [
 	maek.CPP('Source/Tools/VkTypeHelper.cpp'),
 	maek.CPP('Source/Tools/TypeHelper.cpp'),
 	maek.CPP('Source/Tools/Timer.cpp'),
+	maek.CPP('Source/Tools/ThreadPool.cpp'),
+	maek.CPP('Source/Tools/RadixSort.cpp'),
+	maek.CPP('Source/Culling/OcclusionCuller.cpp'),
 	maek.CPP('Source/Camera/Camera.cpp'),
 	maek.CPP('Source/Configuration/RTG.cpp'),
 	maek.CPP('Source/VkMemory/Helpers.cpp'),
+	maek.CPP('Source/VkMemory/BlockAllocator.cpp'),
+	maek.CPP('Source/VkMemory/StagingPool.cpp'),
+	maek.CPP('Source/VkMemory/UploadBatcher.cpp'),
+	maek.CPP('Source/VkMemory/UploadRing.cpp'),
+	maek.CPP('Source/VkMemory/MeshPool.cpp'),
+	maek.CPP('Source/VkMemory/BarrierBatch.cpp'),
+	maek.CPP('Source/VkMemory/Timeline.cpp'),
 	maek.CPP('Source/main.cpp'),
 	maek.CPP('lib/sejp.cpp'),
 ];
@@ -64,13 +74,27 @@ const lines_shaders = [
 ];
 main_objs.push(maek.CPP('Source/Pipelines/Wanderer/LinesPipeline.cpp', undefined, { depends: [...lines_shaders] }));
 
-// build objects shaders and pipeline:
+// build objects shaders (per-draw texture, push constant and bindless variants) and pipeline:
 const objects_shaders = [
 	maek.GLSLC('Source/Shader/Wanderer/objects.vert'),
 	maek.GLSLC('Source/Shader/Wanderer/objects.frag'),
+	maek.GLSLC('Source/Shader/Wanderer/objects.frag', 'spv/Source/Shader/Wanderer/objects-push.frag', { GLSLCFlags: ['-DPUSH_CONSTANTS'] }),
+	maek.GLSLC('Source/Shader/Wanderer/objects.frag', 'spv/Source/Shader/Wanderer/objects-bindless.frag', { GLSLCFlags: ['-DBINDLESS'] }),
 ];
 main_objs.push(maek.CPP('Source/Pipelines/Wanderer/ObjectsPipeline.cpp', undefined, { depends: [...objects_shaders] }));
 
+// build culling compute shaders (frustum-only and Hi-Z variants) and pipelines:
+const cull_shaders = [
+	maek.GLSLC('Source/Shader/Wanderer/cull.comp'),
+	maek.GLSLC('Source/Shader/Wanderer/cull.comp', 'spv/Source/Shader/Wanderer/cull-hiz.comp', { GLSLCFlags: ['-DHIZ'] }),
+];
+main_objs.push(maek.CPP('Source/Pipelines/Wanderer/CullPipeline.cpp', undefined, { depends: [...cull_shaders] }));
+
+const hiz_shaders = [
+	maek.GLSLC('Source/Shader/Wanderer/hiz.comp'),
+];
+main_objs.push(maek.CPP('Source/Pipelines/Wanderer/HiZPipeline.cpp', undefined, { depends: [...hiz_shaders] }));
+
 const main_exe = maek.LINK([...main_objs], 'bin/main');
 
 //default targets:
@@ -87,8 +111,8 @@ function custom_flags_and_rules() {
 		const GLFW_DIR = process.env.GLFW_DIR || `../glfw-3.4/out`;
 		console.log(`Using GLFW_DIR='${GLFW_DIR}'; set GLFW_DIR environment variable to override.`);
 
-		maek.options.CPP = ['g++', '-std=c++20', '-Wall', '-Werror', '-g'];
-		maek.options.LINK = ['g++', '-std=c++20', '-Wall', '-Werror', '-g'];
+		maek.options.CPP = ['g++', '-std=c++20', '-Wall', '-Werror', '-g', '-pthread'];
+		maek.options.LINK = ['g++', '-std=c++20', '-Wall', '-Werror', '-g', '-pthread'];
 
 		maek.options.CPPFlags = [
 			'-O2',
@@ -7,13 +7,67 @@
 #include "Source/Tools/LoadMgr.hpp"
 #include "Source/Tools/SceneMgr.hpp"
 #include "Source/Tools/TypeHelper.hpp"
+#include "Source/Tools/RadixSort.hpp"
 #include "Source/Helper/VK.hpp"
 
 #include <vulkan/vk_enum_string_helper.h>
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <variant>
+
 Wanderer::Wanderer(RTG &rtg_) : rtg(rtg_)
 {
+	// GPU-driven culling needs indirect draw features the device might not have:
+	//	(checked first: the depth format and render passes depend on the final culling mode)
+	gpu_culling_supported = rtg.device_features.multiDrawIndirect && rtg.device_features.drawIndirectFirstInstance && rtg.device_features_12.drawIndirectCount;
+	if ((rtg.configuration.culling_mode & RTG::Configuration::Culling_Mode::GPU_FRUSTUM) && !gpu_culling_supported)
+	{
+		std::cout << "[Wanderer] (Culling) gpu-frustum: indirect count drawing not supported by device; falling back to frustum." << std::endl;
+		rtg.configuration.culling_mode &= ~uint32_t(RTG::Configuration::Culling_Mode::GPU_FRUSTUM | RTG::Configuration::Culling_Mode::GPU_OCCLUSION);
+		rtg.configuration.culling_mode |= RTG::Configuration::Culling_Mode::FRUSTUM;
+	}
+
+	// multi-draw indirect needs several draws per call, each with its own firstInstance:
+	if (rtg.configuration.draw_indirect && !(rtg.device_features.multiDrawIndirect && rtg.device_features.drawIndirectFirstInstance))
+	{
+		std::cout << "[Wanderer] (Drawing) draw-indirect: multi-draw indirect not supported by device; falling back to direct draws." << std::endl;
+		rtg.configuration.draw_indirect = false;
+	}
+
+	// bindless textures need descriptor indexing and room for the whole texture array in the fragment stage:
+	if (rtg.configuration.bindless)
+	{
+		VkPhysicalDeviceLimits const &limits = rtg.helpers.physical_device_properties.limits;
+		bool supported = rtg.device_features_12.runtimeDescriptorArray && rtg.device_features_12.shaderSampledImageArrayNonUniformIndexing && rtg.device_features_12.descriptorBindingPartiallyBound
+					  && limits.maxPerStageDescriptorSampledImages >= ObjectsPipeline::MaxTextures && limits.maxPerStageDescriptorSamplers >= ObjectsPipeline::MaxTextures;
+		if (!supported)
+		{
+			std::cout << "[Wanderer] (Drawing) bindless: descriptor indexing not supported by device; falling back to per-draw texture binds." << std::endl;
+			rtg.configuration.bindless = false;
+		}
+	}
+
+	// push constants pick textures from an array (bindless has no per-draw binds left to replace):
+	if (rtg.configuration.push_constants && rtg.configuration.bindless)
+	{
+		rtg.configuration.push_constants = false;
+	}
+	if (rtg.configuration.push_constants)
+	{
+		VkPhysicalDeviceLimits const &limits = rtg.helpers.physical_device_properties.limits;
+		bool supported = rtg.device_features.shaderSampledImageArrayDynamicIndexing
+					  && limits.maxPerStageDescriptorSampledImages >= ObjectsPipeline::MaxTextures && limits.maxPerStageDescriptorSamplers >= ObjectsPipeline::MaxTextures;
+		if (!supported)
+		{
+			std::cout << "[Wanderer] (Drawing) push-constants: texture array indexing not supported by device; falling back to per-draw texture binds." << std::endl;
+			rtg.configuration.push_constants = false;
+		}
+	}
+
 	// set up application prerequisites
 	init_depth_format();
 	create_render_pass();
@@ -22,6 +76,30 @@ Wanderer::Wanderer(RTG &rtg_) : rtg(rtg_)
 	create_description_pool();
 	setup_workspaces();
 
+	if (rtg.configuration.culling_mode & RTG::Configuration::Culling_Mode::GPU_OCCLUSION)
+	{ // sampler for the Hi-Z pyramid (read with texelFetch, so filtering never happens):
+		VkSamplerCreateInfo create_info{
+			.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+			.flags = 0,
+			.magFilter = VK_FILTER_NEAREST,
+			.minFilter = VK_FILTER_NEAREST,
+			.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+			.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+			.mipLodBias = 0.0f,
+			.anisotropyEnable = VK_FALSE,
+			.maxAnisotropy = 0.0f,
+			.compareEnable = VK_FALSE,
+			.compareOp = VK_COMPARE_OP_ALWAYS,
+			.minLod = 0.0f,
+			.maxLod = VK_LOD_CLAMP_NONE,
+			.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
+			.unnormalizedCoordinates = VK_FALSE,
+		};
+		VK(vkCreateSampler(rtg.device, &create_info, nullptr, &hiz_sampler));
+	}
+
 	// load scene graph related info
 	SceneMgr &sceneMgr = rtg.configuration.sceneMgr;
 	LoadMgr::load_scene_graph_info_from_s72(rtg.configuration.scene_graph_path, sceneMgr);
@@ -30,6 +108,15 @@ Wanderer::Wanderer(RTG &rtg_) : rtg(rtg_)
 	// update animation time
 	animation_timer.tmax = sceneMgr.get_animation_duration();
 
+	// find the sun lights, which light the world:
+	for (auto const &[name, node] : sceneMgr.nodeObjectMap)
+	{
+		auto findLightResult = sceneMgr.lightObjectMap.find(node->refLightName);
+		if (findLightResult != sceneMgr.lightObjectMap.end() && std::holds_alternative<SceneMgr::SunLight>(findLightResult->second->light))
+			sun_light_nodes.emplace_back(name);
+	}
+	std::sort(sun_light_nodes.begin(), sun_light_nodes.end());
+
 	// update scene camera info in sceneMgr
 	sceneMgr.sceneCameraCount = sceneMgr.cameraObjectMap.size();
 
@@ -95,6 +182,29 @@ Wanderer::Wanderer(RTG &rtg_) : rtg(rtg_)
 	// set up textures
 	create_diy_textures();
 	create_textures_descriptor();
+	if (rtg.configuration.bindless)
+		create_bindless_descriptor();
+	if (rtg.configuration.push_constants)
+		create_texture_array_descriptor();
+
+	// static resources defragmentation (`--defrag`) may move, and how to follow them:
+	for (uint32_t i = 0; i < uint32_t(textures.size()); ++i)
+	{
+		rtg.helpers.track_movable(&textures[i], TextureUsage, 1, [this, i]()
+								  { texture_moved(i); });
+	}
+	if (material_buffer.handle != VK_NULL_HANDLE)
+	{
+		rtg.helpers.track_movable(&material_buffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, [this]()
+								  { material_buffer_moved(); });
+	}
+	// (the mesh pool moves by compacting into a new buffer, which also packs mesh offsets; its copies go through
+	//  record_moves in the next frame -- ahead of, never inside, cached commands -- and the commands that bound the old
+	//  buffer are dropped right away)
+	rtg.helpers.track_relocatable(&mesh_pool.buffer, [this]()
+								  {
+									  mesh_pool.rebuild(rtg.helpers, mesh_pool.capacity);
+									  sync_mesh_pool(); });
 }
 
 Wanderer::~Wanderer()
@@ -107,6 +217,13 @@ Wanderer::~Wanderer()
 	}
 
 	// remove static resources
+	for (Helpers::AllocatedImage &texture : textures)
+	{
+		rtg.helpers.untrack_movable(&texture);
+	}
+	rtg.helpers.untrack_movable(&material_buffer);
+	rtg.helpers.untrack_movable(&mesh_pool.buffer);
+
 	if (texture_descriptor_pool)
 	{
 		vkDestroyDescriptorPool(rtg.device, texture_descriptor_pool, nullptr);
@@ -116,6 +233,29 @@ Wanderer::~Wanderer()
 		texture_descriptors.clear();
 	}
 
+	if (bindless_descriptor_pool)
+	{
+		vkDestroyDescriptorPool(rtg.device, bindless_descriptor_pool, nullptr);
+		bindless_descriptor_pool = VK_NULL_HANDLE;
+
+		// (this also frees bindless_descriptors)
+		bindless_descriptors = VK_NULL_HANDLE;
+	}
+
+	if (material_buffer.handle != VK_NULL_HANDLE)
+	{
+		rtg.helpers.destroy_buffer(std::move(material_buffer));
+	}
+
+	if (texture_array_descriptor_pool)
+	{
+		vkDestroyDescriptorPool(rtg.device, texture_array_descriptor_pool, nullptr);
+		texture_array_descriptor_pool = VK_NULL_HANDLE;
+
+		// (this also frees texture_array_descriptors)
+		texture_array_descriptors = VK_NULL_HANDLE;
+	}
+
 	if (texture_sampler)
 	{
 		vkDestroySampler(rtg.device, texture_sampler, nullptr);
@@ -135,7 +275,8 @@ Wanderer::~Wanderer()
 	}
 	textures.clear();
 
-	rtg.helpers.destroy_buffer(std::move(object_vertices));
+	mesh_residency.clear(); // (waits for .b72 reads still in flight)
+	mesh_pool.destroy(rtg.helpers);
 
 	// remove swapchain-dependent resources
 	if (swapchain_depth_image.handle != VK_NULL_HANDLE)
@@ -144,6 +285,22 @@ Wanderer::~Wanderer()
 	}
 
 	// remove per-workspace resources
+	for (std::vector<CachedCommands> &workspace_cache : cached_commands)
+	{
+		for (CachedCommands &cached : workspace_cache)
+		{
+			if (cached.command_buffer != VK_NULL_HANDLE)
+			{
+				vkFreeCommandBuffers(rtg.device, command_pool, 1, &cached.command_buffer);
+				cached.command_buffer = VK_NULL_HANDLE;
+			}
+		}
+	}
+	cached_commands.clear();
+
+	camera_uniform.destroy(rtg.helpers);
+	world_uniform.destroy(rtg.helpers);
+
 	for (Workspace &workspace : workspaces)
 	{
 		if (workspace.command_buffer != VK_NULL_HANDLE)
@@ -152,47 +309,52 @@ Wanderer::~Wanderer()
 			workspace.command_buffer = VK_NULL_HANDLE;
 		}
 
-		if (workspace.lines_vertices_src.handle != VK_NULL_HANDLE)
+		for (Workspace::Recorder &recorder : workspace.recorders)
 		{
-			rtg.helpers.destroy_buffer(std::move(workspace.lines_vertices_src));
+			// (this also frees recorder.command_buffer)
+			vkDestroyCommandPool(rtg.device, recorder.command_pool, nullptr);
 		}
-		if (workspace.lines_vertices.handle != VK_NULL_HANDLE)
+		workspace.recorders.clear();
+
+		workspace.upload_ring.destroy(rtg.helpers);
+		// Camera_descriptors, World_descriptors and Transform_descriptors are freed when pool is destroyed.
+
+		for (StagingPool::Buffer &staging : workspace.staging)
 		{
-			rtg.helpers.destroy_buffer(std::move(workspace.lines_vertices));
+			rtg.helpers.staging.release(std::move(staging));
 		}
+		workspace.staging.clear();
 
-		if (workspace.Camera_src.handle != VK_NULL_HANDLE)
+		if (workspace.CullInstances.handle != VK_NULL_HANDLE)
 		{
-			rtg.helpers.destroy_buffer(std::move(workspace.Camera_src));
+			rtg.helpers.destroy_buffer(std::move(workspace.CullInstances));
 		}
 
-		if (workspace.Camera.handle != VK_NULL_HANDLE)
+		if (workspace.DrawCommands.handle != VK_NULL_HANDLE)
 		{
-			rtg.helpers.destroy_buffer(std::move(workspace.Camera));
+			rtg.helpers.destroy_buffer(std::move(workspace.DrawCommands));
 		}
-		// Camera_descriptors is freed when pool is destroyed.
 
-		if (workspace.World_src.handle != VK_NULL_HANDLE)
+		if (workspace.DrawCounts.handle != VK_NULL_HANDLE)
 		{
-			rtg.helpers.destroy_buffer(std::move(workspace.World_src));
+			rtg.helpers.destroy_buffer(std::move(workspace.DrawCounts));
 		}
 
-		if (workspace.World.handle != VK_NULL_HANDLE)
+		if (workspace.Occluded.handle != VK_NULL_HANDLE)
 		{
-			rtg.helpers.destroy_buffer(std::move(workspace.World));
+			rtg.helpers.destroy_buffer(std::move(workspace.Occluded));
 		}
-		// World_descriptors is freed when pool is destroyed.
 
-		if (workspace.Transforms_src.handle != VK_NULL_HANDLE)
+		if (workspace.CullParams.handle != VK_NULL_HANDLE)
 		{
-			rtg.helpers.destroy_buffer(std::move(workspace.Transforms_src));
+			rtg.helpers.destroy_buffer(std::move(workspace.CullParams));
 		}
 
-		if (workspace.Transforms.handle != VK_NULL_HANDLE)
+		if (workspace.CullStats.handle != VK_NULL_HANDLE)
 		{
-			rtg.helpers.destroy_buffer(std::move(workspace.Transforms));
+			rtg.helpers.destroy_buffer(std::move(workspace.CullStats));
 		}
-		// Transform_descriptors is freed when pool is destroyed.
+		// Cull_descriptors is freed when pool is destroyed.
 	}
 	workspaces.clear();
 
@@ -206,6 +368,14 @@ Wanderer::~Wanderer()
 	background_pipeline.destroy(rtg);
 	lines_pipeline.destroy(rtg);
 	objects_pipeline.destroy(rtg);
+	cull_pipeline.destroy(rtg);
+	hiz_pipeline.destroy(rtg);
+
+	if (hiz_sampler != VK_NULL_HANDLE)
+	{
+		vkDestroySampler(rtg.device, hiz_sampler, nullptr);
+		hiz_sampler = VK_NULL_HANDLE;
+	}
 
 	if (render_pass != VK_NULL_HANDLE)
 	{
@@ -213,6 +383,18 @@ Wanderer::~Wanderer()
 		render_pass = VK_NULL_HANDLE;
 	}
 
+	if (render_pass_early != VK_NULL_HANDLE)
+	{
+		vkDestroyRenderPass(rtg.device, render_pass_early, nullptr);
+		render_pass_early = VK_NULL_HANDLE;
+	}
+
+	if (render_pass_late != VK_NULL_HANDLE)
+	{
+		vkDestroyRenderPass(rtg.device, render_pass_late, nullptr);
+		render_pass_late = VK_NULL_HANDLE;
+	}
+
 	if (command_pool != VK_NULL_HANDLE)
 	{
 		vkDestroyCommandPool(rtg.device, command_pool, nullptr);
@@ -228,14 +410,15 @@ void Wanderer::on_swapchain(RTG &rtg_, RTG::SwapchainEvent const &swapchain) //
 		destroy_framebuffers();
 	}
 
+	bool gpu_occlusion = rtg.configuration.culling_mode & RTG::Configuration::Culling_Mode::GPU_OCCLUSION;
+
 	// allocate depth image for framebuffers to share
-	swapchain_depth_image = rtg.helpers.create_image(
+	//	(never stored, so transient and lazily allocated where supported -- unless the Hi-Z pyramid is built from it,
+	//	 which stores and samples it, making it an ordinary image)
+	swapchain_depth_image = rtg.helpers.create_transient_attachment(
 		swapchain.extent,
 		depth_format,
-		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		Helpers::Unmapped);
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (gpu_occlusion ? VK_IMAGE_USAGE_SAMPLED_BIT : 0));
 
 	// create depth image view
 	{
@@ -253,6 +436,9 @@ void Wanderer::on_swapchain(RTG &rtg_, RTG::SwapchainEvent const &swapchain) //
 		VK(vkCreateImageView(rtg.device, &create_info, nullptr, &swapchain_depth_image_view));
 	};
 
+	// recorded commands reference the old framebuffers:
+	invalidate_cached_commands();
+
 	// make framebuffers for each swapchain image:
 	swapchain_framebuffers.assign(swapchain.image_views.size(), VK_NULL_HANDLE);
 	for (size_t i = 0; i < swapchain.image_views.size(); ++i)
@@ -272,9 +458,80 @@ void Wanderer::on_swapchain(RTG &rtg_, RTG::SwapchainEvent const &swapchain) //
 		VK(vkCreateFramebuffer(rtg.device, &create_info, nullptr, &swapchain_framebuffers[i]));
 	}
 
+	// (the early and late render passes are compatible with render_pass, so they share these framebuffers)
+	if (gpu_occlusion)
+	{
+		create_hiz_resources(swapchain.extent);
+	}
+
 	std::cout << "[Wanderer] (Swapchain count) recreating " << swapchain.images.size() << " swapchains" << std::endl;
 }
 
+Wanderer::ObjectsPipeline::World Wanderer::make_world(SceneMgr &sceneMgr) const
+{
+	// defaults, for scenes without sun lights:
+	ObjectsPipeline::World world{};
+
+	world.SKY_DIRECTION.x = 0.0f;
+	world.SKY_DIRECTION.y = 0.0f;
+	world.SKY_DIRECTION.z = 1.0f;
+
+	world.SKY_ENERGY.r = 0.1f;
+	world.SKY_ENERGY.g = 0.1f;
+	world.SKY_ENERGY.b = 0.2f;
+
+	world.SUN_DIRECTION.x = 6.0f / 23.0f;
+	world.SUN_DIRECTION.y = 13.0f / 23.0f;
+	world.SUN_DIRECTION.z = 18.0f / 23.0f;
+
+	world.SUN_ENERGY.r = 1.0f;
+	world.SUN_ENERGY.g = 1.0f;
+	world.SUN_ENERGY.b = 0.9f;
+
+	// the first sun light covering the whole hemisphere (angle of pi) is the sky, the first other one is the sun;
+	//  both shine along their node's local -z, so the direction towards them is local +z in world space:
+	bool found_sky = false;
+	bool found_sun = false;
+	for (std::string const &name : sun_light_nodes)
+	{
+		SceneMgr::NodeObject const *node = sceneMgr.nodeObjectMap.at(name);
+		SceneMgr::LightObject const *light = sceneMgr.lightObjectMap.at(node->refLightName);
+		SceneMgr::SunLight const &sun = std::get<SceneMgr::SunLight>(light->light);
+
+		auto findMatrixResult = sceneMgr.nodeMatrixMap.find(name);
+		if (findMatrixResult == sceneMgr.nodeMatrixMap.end())
+			continue;
+
+		glm::vec3 direction = glm::normalize(glm::vec3(findMatrixResult->second * glm::vec4(0.0f, 0.0f, 1.0f, 0.0f)));
+		glm::vec3 energy = light->tint * sun.strength;
+
+		bool is_sky = sun.angle >= float(M_PI) - 1e-3f;
+		if (is_sky && !found_sky)
+		{
+			world.SKY_DIRECTION = {direction.x, direction.y, direction.z, 0.0f};
+			world.SKY_ENERGY = {energy.r, energy.g, energy.b, 0.0f};
+			found_sky = true;
+		}
+		else if (!is_sky && !found_sun)
+		{
+			world.SUN_DIRECTION = {direction.x, direction.y, direction.z, 0.0f};
+			world.SUN_ENERGY = {energy.r, energy.g, energy.b, 0.0f};
+			found_sun = true;
+		}
+	}
+
+	return world;
+}
+
+void Wanderer::invalidate_cached_commands()
+{
+	for (std::vector<CachedCommands> &workspace_cache : cached_commands)
+	{
+		for (CachedCommands &cached : workspace_cache)
+			cached.valid = false;
+	}
+}
+
 void Wanderer::destroy_framebuffers()
 {
 	for (VkFramebuffer &framebuffer : swapchain_framebuffers)
@@ -290,168 +547,284 @@ void Wanderer::destroy_framebuffers()
 	swapchain_depth_image_view = VK_NULL_HANDLE;
 
 	rtg.helpers.destroy_image(std::move(swapchain_depth_image));
+
+	destroy_hiz_resources();
 }
 
-void Wanderer::render(RTG &rtg_, RTG::RenderParams const &render_params)
+void Wanderer::create_hiz_resources(VkExtent2D const &extent)
 {
+	// level 0 is half the depth buffer (each texel covers 2x2 depth pixels), every further level halves again down to 1x1:
+	VkExtent2D hiz_extent{
+		.width = std::max(1u, extent.width / 2),
+		.height = std::max(1u, extent.height / 2)};
+	hiz_levels = uint32_t(std::floor(std::log2(float(std::max(hiz_extent.width, hiz_extent.height))))) + 1;
+
+	hiz_image = rtg.helpers.create_image(
+		hiz_extent,
+		VK_FORMAT_R32_SFLOAT,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, // written by the Hi-Z pipeline, read by the next level and the cull pipeline
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		Helpers::Unmapped,
+		hiz_levels,
+		Helpers::Attachments);
 
-	// assert that parameters are valid:
-	assert(&rtg == &rtg_);
-	assert(render_params.workspace_index < workspaces.size());
-	assert(render_params.image_index < swapchain_framebuffers.size());
-
-	// get more convenient names for the current workspace and target framebuffer:
-	Workspace &workspace = workspaces[render_params.workspace_index];
-	[[maybe_unused]] VkFramebuffer framebuffer = swapchain_framebuffers[render_params.image_index];
-
-	// //record (into `workspace.command_buffer`) commands that run a `render_pass` that just clears `framebuffer`:
+	{ // view of every level, for the cull pipeline:
+		VkImageViewCreateInfo create_info{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image = hiz_image.handle,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = VK_FORMAT_R32_SFLOAT,
+			.subresourceRange{
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.baseMipLevel = 0,
+				.levelCount = hiz_levels,
+				.baseArrayLayer = 0,
+				.layerCount = 1}};
+		VK(vkCreateImageView(rtg.device, &create_info, nullptr, &hiz_view));
+	};
 
-	// reset the command buffer
-	VK(vkResetCommandBuffer(workspace.command_buffer, 0));
+	// one view per level, for building the pyramid:
+	hiz_level_views.assign(hiz_levels, VK_NULL_HANDLE);
+	for (uint32_t level = 0; level < hiz_levels; ++level)
+	{
+		VkImageViewCreateInfo create_info{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image = hiz_image.handle,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = VK_FORMAT_R32_SFLOAT,
+			.subresourceRange{
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.baseMipLevel = level,
+				.levelCount = 1,
+				.baseArrayLayer = 0,
+				.layerCount = 1}};
+		VK(vkCreateImageView(rtg.device, &create_info, nullptr, &hiz_level_views[level]));
+	}
 
-	{ // begin recording: command_buffer
-		VkCommandBufferBeginInfo begin_info{
-			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-			//.pNext = nullptr,
-			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, // record again every submit
+	{ // descriptor pool for one set per level plus the cull pipeline's set:
+		std::array<VkDescriptorPoolSize, 2> pool_sizes{
+			VkDescriptorPoolSize{
+				.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.descriptorCount = hiz_levels + 1,
+			},
+			VkDescriptorPoolSize{
+				.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				.descriptorCount = hiz_levels,
+			},
 		};
-		VK(vkBeginCommandBuffer(workspace.command_buffer, &begin_info));
-	}
 
-	// update line vertices:
-	if (!lines_vertices.empty())
-	{
+		VkDescriptorPoolCreateInfo create_info{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+			.flags = 0,
+			.maxSets = hiz_levels + 1,
+			.poolSizeCount = uint32_t(pool_sizes.size()),
+			.pPoolSizes = pool_sizes.data()};
 
-		// [re-]allocate lines buffers if needed:
-		size_t needed_bytes = lines_vertices.size() * sizeof(lines_vertices[0]);
+		VK(vkCreateDescriptorPool(rtg.device, &create_info, nullptr, &hiz_descriptor_pool));
+	};
 
-		if (workspace.lines_vertices_src.handle == VK_NULL_HANDLE || workspace.lines_vertices_src.size < needed_bytes)
+	{ // allocate and write descriptor sets:
+		std::vector<VkDescriptorSetLayout> layouts(hiz_levels, hiz_pipeline.set0_Levels);
+		hiz_level_descriptors.assign(hiz_levels, VK_NULL_HANDLE);
+
+		VkDescriptorSetAllocateInfo alloc_info{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = hiz_descriptor_pool,
+			.descriptorSetCount = uint32_t(layouts.size()),
+			.pSetLayouts = layouts.data()};
+		VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, hiz_level_descriptors.data()));
+
+		VkDescriptorSetAllocateInfo cull_alloc_info{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = hiz_descriptor_pool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &cull_pipeline.set1_HiZ};
+		VK(vkAllocateDescriptorSets(rtg.device, &cull_alloc_info, &hiz_cull_descriptors));
+
+		// level 0 reads the depth buffer (left read-only by the early render pass), level k reads level k-1:
+		std::vector<VkDescriptorImageInfo> src_infos(hiz_levels);
+		std::vector<VkDescriptorImageInfo> dst_infos(hiz_levels);
+		std::vector<VkWriteDescriptorSet> writes;
+		writes.reserve(2 * hiz_levels + 1);
+		for (uint32_t level = 0; level < hiz_levels; ++level)
 		{
-			size_t new_bytes = ((needed_bytes + 4096) / 4096) * 4096; // round up to nearest 4k to avoid re-allocat1ing
-																	  //  continuously if vertex count grows slowly
+			src_infos[level] = VkDescriptorImageInfo{
+				.sampler = hiz_sampler,
+				.imageView = (level == 0 ? swapchain_depth_image_view : hiz_level_views[level - 1]),
+				.imageLayout = (level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL)};
+			dst_infos[level] = VkDescriptorImageInfo{
+				.sampler = VK_NULL_HANDLE,
+				.imageView = hiz_level_views[level],
+				.imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+
+			writes.emplace_back(VkWriteDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = hiz_level_descriptors[level],
+				.dstBinding = 0,
+				.dstArrayElement = 0,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				.pImageInfo = &src_infos[level]});
+			writes.emplace_back(VkWriteDescriptorSet{
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = hiz_level_descriptors[level],
+				.dstBinding = 1,
+				.dstArrayElement = 0,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+				.pImageInfo = &dst_infos[level]});
+		}
 
-			if (workspace.lines_vertices_src.handle)
-			{
-				rtg.helpers.destroy_buffer(std::move(workspace.lines_vertices_src));
-			}
-			if (workspace.lines_vertices.handle)
-			{
-				rtg.helpers.destroy_buffer(std::move(workspace.lines_vertices));
-			}
+		VkDescriptorImageInfo pyramid_info{
+			.sampler = hiz_sampler,
+			.imageView = hiz_view,
+			.imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+		writes.emplace_back(VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = hiz_cull_descriptors,
+			.dstBinding = 0,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo = &pyramid_info});
 
-			workspace.lines_vertices_src = rtg.helpers.create_buffer( //"staging" buffer, storing a frame's lines data using the CPU
-				new_bytes,
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,											// have GPU copy data from lines_vertices_src
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host visible memory, coherent (no special sync needed)
-				Helpers::Mapped																// put it somewhere in the CPU address space
-			);
-			workspace.lines_vertices = rtg.helpers.create_buffer( // vertex buffer on GPU side
-				new_bytes,
-				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // use as a vertex buffer, and a target of a memory copy
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,								  // on GPU, not host visible
-				Helpers::Unmapped);
+		vkUpdateDescriptorSets(
+			rtg.device,
+			uint32_t(writes.size()), writes.data(), // descriptorWrites count, data
+			0, nullptr								// descriptorCopies count, data
+		);
+	};
 
-			std::cout << "Workspace #" << render_params.workspace_index << " ";
-			std::cout << "Re-allocating lines buffers to " << new_bytes << " bytes." << std::endl;
-		}
+	// the new pyramid holds nothing yet (it is moved to GENERAL in the first frame that uses it):
+	hiz_ready = false;
+
+	std::cout << "[Wanderer] (Hi-Z) " << hiz_extent.width << "x" << hiz_extent.height << " pyramid with " << hiz_levels << " levels." << std::endl;
+}
 
-		assert(workspace.lines_vertices_src.size == workspace.lines_vertices.size);
-		assert(workspace.lines_vertices_src.size >= needed_bytes);
+void Wanderer::destroy_hiz_resources()
+{
+	if (hiz_descriptor_pool != VK_NULL_HANDLE)
+	{
+		vkDestroyDescriptorPool(rtg.device, hiz_descriptor_pool, nullptr);
+		hiz_descriptor_pool = VK_NULL_HANDLE;
 
-		// host-side copy into liens_vertices_src:
-		assert(workspace.lines_vertices_src.allocation.mapped);
-		std::memcpy(workspace.lines_vertices_src.allocation.data(), lines_vertices.data(), needed_bytes);
+		// (this also frees the descriptor sets allocated from the pool)
+		hiz_level_descriptors.clear();
+		hiz_cull_descriptors = VK_NULL_HANDLE;
+	}
 
-		// device-side copy from lines_vertices_src to lines_vertices:
-		VkBufferCopy copy_region{
-			.srcOffset = 0,
-			.dstOffset = 0,
-			.size = needed_bytes};
-		vkCmdCopyBuffer(workspace.command_buffer, workspace.lines_vertices_src.handle, workspace.lines_vertices.handle, 1, &copy_region);
-	};
+	for (VkImageView &view : hiz_level_views)
+	{
+		vkDestroyImageView(rtg.device, view, nullptr);
+		view = VK_NULL_HANDLE;
+	}
+	hiz_level_views.clear();
 
-	{ // upload camera info:
-		LinesPipeline::Camera camera{
-			.CLIP_FROM_WORLD = CLIP_FROM_WORLD};
-		assert(workspace.Camera_src.size == sizeof(camera));
+	if (hiz_view != VK_NULL_HANDLE)
+	{
+		vkDestroyImageView(rtg.device, hiz_view, nullptr);
+		hiz_view = VK_NULL_HANDLE;
+	}
 
-		// host-side copy into Camera_src:
-		assert(workspace.Camera_src.allocation.mapped);
-		std::memcpy(workspace.Camera_src.allocation.data(), &camera, sizeof(camera));
+	if (hiz_image.handle != VK_NULL_HANDLE)
+	{
+		rtg.helpers.destroy_image(std::move(hiz_image));
+	}
 
-		// add device-side copy from Camera_src to Camera:
-		assert(workspace.Camera_src.size == workspace.Camera.size);
-		VkBufferCopy copy_region{
-			.srcOffset = 0,
-			.dstOffset = 0,
-			.size = workspace.Camera_src.size};
-		vkCmdCopyBuffer(workspace.command_buffer, workspace.Camera_src.handle, workspace.Camera.handle, 1, &copy_region);
-	};
+	hiz_levels = 0;
+	hiz_ready = false;
+}
 
-	{ // upload world info:
-		assert(workspace.Camera_src.size == sizeof(world));
+void Wanderer::render(RTG &rtg_, RTG::RenderParams const &render_params)
+{
 
-		// host-side copy into World_src:
-		memcpy(workspace.World_src.allocation.data(), &world, sizeof(world));
+	// assert that parameters are valid:
+	assert(&rtg == &rtg_);
+	assert(render_params.workspace_index < workspaces.size());
+	assert(render_params.image_index < swapchain_framebuffers.size());
 
-		// add device-side copy from World_src to World:
-		assert(workspace.World_src.size == workspace.World.size);
-		VkBufferCopy copy_region{
-			.srcOffset = 0,
-			.dstOffset = 0,
-			.size = workspace.World_src.size};
-		vkCmdCopyBuffer(workspace.command_buffer, workspace.World_src.handle, workspace.World.handle, 1, &copy_region);
-	};
+	// get more convenient names for the current workspace and target framebuffer:
+	Workspace &workspace = workspaces[render_params.workspace_index];
+	[[maybe_unused]] VkFramebuffer framebuffer = swapchain_framebuffers[render_params.image_index];
 
-	// upload object transforms info:
-	if (!object_instances.empty())
+	// the workspace is available again, so the culling stats it copied back last time are complete
+	//  (and the staging it streamed from can go back to the pool):
+	if (workspace.CullStats_pending)
 	{
+		report_gpu_culling_stats(workspace);
+	}
+	for (StagingPool::Buffer &staging : workspace.staging)
+	{
+		rtg.helpers.staging.release(std::move(staging));
+	}
+	workspace.staging.clear();
+
+	// bring this workspace's copies of the change-tracked uniforms up to date:
+	camera_uniform.set(LinesPipeline::Camera{
+		.CLIP_FROM_WORLD = CLIP_FROM_WORLD});
+	camera_uniform.sync(render_params.workspace_index);
+	world_uniform.sync(render_params.workspace_index);
+
+	// stream this frame's lines vertices, transforms and instance lists through the workspace's upload ring:
+	VkDeviceSize transforms_offset = 0;
+	VkDeviceSize instances_offset = 0;
+	VkDeviceSize commands_offset = 0; // (with --draw-indirect) one VkDrawIndirectCommand per draw group
+	VkDeviceSize lines_offset = 0;
+	{
+		VkPhysicalDeviceLimits const &limits = rtg.helpers.physical_device_properties.limits;
+		VkDeviceSize storage_alignment = std::max<VkDeviceSize>(limits.minStorageBufferOffsetAlignment, 16);
 
-		// [re-]allocate object transforms buffers if needed:
-		size_t needed_bytes = object_instances.size() * sizeof(ObjectsPipeline::Transform);
+		size_t lines_bytes = lines_vertices.size() * sizeof(lines_vertices[0]);
+		size_t transforms_bytes = size_t(scene_instance_count) * sizeof(ObjectsPipeline::Transform); // (before culling; unused slots are never read)
+		size_t instances_bytes = size_t(scene_instance_count) * sizeof(ObjectsPipeline::Instance);
+		size_t commands_bytes = rtg.configuration.draw_indirect ? size_t(scene_instance_count) * sizeof(VkDrawIndirectCommand) : 0; // (at most one group per instance)
 
-		// check if we need to re-allocate the buffers:
-		if (workspace.Transforms_src.handle == VK_NULL_HANDLE || workspace.Transforms_src.size < needed_bytes)
+		// [re-]allocate the ring if this frame doesn't fit:
+		//  (transforms and instances always get their whole ranges, since those are the ranges the descriptors were written with)
+		auto ring_bytes = [&]()
 		{
-			size_t new_bytes = ((needed_bytes + 4096) / 4096) * 4096; // round up to nearest 4k to avoid re-allocat1ing
-																	  //  continuously if vertex count grows slowly
-
-			if (workspace.Transforms_src.handle)
-			{
-				rtg.helpers.destroy_buffer(std::move(workspace.Transforms_src));
-			}
-			if (workspace.Transforms.handle)
-			{
-				rtg.helpers.destroy_buffer(std::move(workspace.Transforms));
-			}
-
-			workspace.Transforms_src = rtg.helpers.create_buffer(
+			return workspace.Transforms_range + workspace.Instances_range + commands_bytes + lines_bytes
+				 + 2 * storage_alignment + 2 * 16; // (worst-case alignment padding)
+		};
+		if (workspace.upload_ring.host.handle == VK_NULL_HANDLE || transforms_bytes > workspace.Transforms_range || instances_bytes > workspace.Instances_range || workspace.upload_ring.capacity() < ring_bytes())
+		{
+			// round up to nearest 4k to avoid re-allocating continuously if the counts grow slowly:
+			workspace.Transforms_range = std::max<VkDeviceSize>(workspace.Transforms_range, ((transforms_bytes + 4096) / 4096) * 4096);
+			workspace.Instances_range = std::max<VkDeviceSize>(workspace.Instances_range, ((instances_bytes + 4096) / 4096) * 4096);
+			VkDeviceSize new_bytes = ((ring_bytes() + 4096) / 4096) * 4096;
+
+			workspace.upload_ring.destroy(rtg.helpers);
+			for (CachedCommands &cached : cached_commands[render_params.workspace_index])
+				cached.valid = false; // (recorded with the old ring's buffer)
+			workspace.upload_ring.create(
+				rtg.helpers,
 				new_bytes,
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,											// have GPU copy data from Transforms_src
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host visible memory, coherent (no special sync needed)
-				Helpers::Mapped																// put it somewhere in the CPU address space
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT // transforms and instances, lines vertices, draw commands
 			);
-			workspace.Transforms = rtg.helpers.create_buffer(
-				new_bytes,
-				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // use as a storage buffer, and a target of a memory copy
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,								   // on GPU, not host visible
-				Helpers::Unmapped);
 
-			// update the descriptor set:
-			VkDescriptorBufferInfo Transforms_info{
-				.buffer = workspace.Transforms.handle,
-				.offset = 0,
-				.range = workspace.Transforms.size};
+			// update the descriptor sets (offsets are supplied at bind time):
+			std::array<VkDescriptorBufferInfo, 2> Transforms_infos{
+				VkDescriptorBufferInfo{
+					.buffer = workspace.upload_ring.buffer(),
+					.offset = 0,
+					.range = workspace.Transforms_range},
+				VkDescriptorBufferInfo{
+					.buffer = workspace.upload_ring.buffer(),
+					.offset = 0,
+					.range = workspace.Instances_range},
+			};
 
 			std::array<VkWriteDescriptorSet, 1> writes{
 				VkWriteDescriptorSet{
 					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-					.dstSet = workspace.Transform_descriptors, // make descriptors stay up to date with the re-allocated transforms buffer
+					.dstSet = workspace.Transform_descriptors,
 					.dstBinding = 0,
 					.dstArrayElement = 0,
-					.descriptorCount = 1,
-					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-					.pBufferInfo = &Transforms_info}};
+					.descriptorCount = uint32_t(Transforms_infos.size()), // bindings 0, 1 (consecutive bindings of the same type)
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+					.pBufferInfo = Transforms_infos.data()},
+			};
 
 			vkUpdateDescriptorSets(
 				rtg.device,
@@ -459,141 +832,714 @@ void Wanderer::render(RTG &rtg_, RTG::RenderParams const &render_params)
 				0, nullptr								// descriptorCopies count, data
 			);
 
-			std::cout << "Re-allocating Transforms buffers to " << new_bytes << " bytes." << std::endl;
+			std::cout << "Workspace #" << render_params.workspace_index << " ";
+			std::cout << "Re-allocating upload ring to " << new_bytes << " bytes." << std::endl;
 		}
 
-		assert(workspace.Transforms_src.size == workspace.Transforms.size);
-		assert(workspace.Transforms_src.size >= needed_bytes);
+		// (the workspace's last frame was waited on, so the GPU is done with last use of the ring)
+		workspace.upload_ring.reset();
+
+		{ // build object instances (with culling), writing their transforms into the ring:
+			transforms_offset = workspace.upload_ring.allocate(workspace.Transforms_range, storage_alignment);
+			assert(transforms_offset != VK_WHOLE_SIZE);
+
+			// the transforms data is built directly into the mapped ring, avoiding any copies:
+			ObjectsPipeline::Transform *transforms = reinterpret_cast<ObjectsPipeline::Transform *>(workspace.upload_ring.data(transforms_offset));
 
-		{ // copy transforms into Transforms_src:
-			assert(workspace.Transforms_src.allocation.mapped);
+			object_instances.clear();
+			object_bboxes.clear();
+			transform_draw_keys.resize(scene_instance_count);
+			transform_meshes.resize(scene_instance_count);
 
-			ObjectsPipeline::Transform *out = reinterpret_cast<ObjectsPipeline::Transform *>(
-				workspace.Transforms_src.allocation.data()); // the transforms data is built directly into the mapped transforms sources memory, avoiding any copies
+			// (releases mesh_pool's old ranges and buffers that frames the GPU has finished were the last to read)
+			mesh_pool.begin_frame(rtg.helpers);
+			sync_mesh_pool();
 
-			for (ObjectInstance const &inst : object_instances)
+			construct_scene_graph_vertices_with_culling(object_instances, transforms, rtg.configuration.sceneMgr, CLIP_FROM_WORLD);
+
+			if (rtg.configuration.mesh_budget > 0.0f)
 			{
-				*out = inst.transform;
-				++out;
+				update_mesh_residency(object_instances);
+				sync_mesh_pool();
 			}
+		}
 
-			// device-side copy from Transforms_src -> Transforms:
-			VkBufferCopy copy_region{
-				.srcOffset = 0,
-				.dstOffset = 0,
-				.size = needed_bytes};
+		{ // group what survived into instanced draws, writing the instance list into the ring:
+			instances_offset = workspace.upload_ring.allocate(workspace.Instances_range, storage_alignment);
+			assert(instances_offset != VK_WHOLE_SIZE);
 
-			vkCmdCopyBuffer(workspace.command_buffer, workspace.Transforms_src.handle, workspace.Transforms.handle, 1, &copy_region);
+			build_draw_groups(reinterpret_cast<ObjectsPipeline::Instance *>(workspace.upload_ring.data(instances_offset)));
 		}
-	}
 
-	{ // memory barrier to make sure copies complete before render pass:
-		VkMemoryBarrier memory_barrier{
-			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
-			.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT, // build barrier between src stage mask (Writring) -
-			.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT	 // & dst stage mask (Reading)
-		};
-
-		vkCmdPipelineBarrier(
-			workspace.command_buffer,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,		// src stage mask
-			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, // dst stage mask
-			0,									// dependency flags
-			1, &memory_barrier,					// memory barriers (count, data)
-			0, nullptr,							// buffer memory barriers (count, data)
-			0, nullptr							// image memory barriers (count, data)
-		);
-	};
+		if (rtg.configuration.draw_indirect && !draw_groups.empty())
+		{ // write the draw commands (read by one vkCmdDrawIndirect per texture bucket):
+			commands_offset = workspace.upload_ring.allocate(draw_groups.size() * sizeof(VkDrawIndirectCommand), 16);
+			assert(commands_offset != VK_WHOLE_SIZE);
 
-	// GPU commands here
-	 // render pass：describes layout, "input from", "output to" of attachments
+			VkDrawIndirectCommand *out = reinterpret_cast<VkDrawIndirectCommand *>(workspace.upload_ring.data(commands_offset));
+			for (DrawGroup const &group : draw_groups)
+			{
+				*out = VkDrawIndirectCommand{
+					.vertexCount = group.vertices.count,
+					.instanceCount = group.instance_count,
+					.firstVertex = group.vertices.first,
+					.firstInstance = group.first_instance, // gl_InstanceIndex starts here, so the shader finds the group's instance list entries
+				};
+				++out;
+			}
+		}
 
-		// set clear value (black)
-		[[maybe_unused]] std::array<VkClearValue, 2> clear_values{
-			VkClearValue{.color{.float32{0.6f, 0.6f, 0.6f, 1.0f}}},
-			VkClearValue{.depthStencil{.depth = 1.0f, .stencil = 0}},
-		};
+		if (!lines_vertices.empty())
+		{ // update line vertices:
+			lines_offset = workspace.upload_ring.allocate(lines_bytes, 16);
+			assert(lines_offset != VK_WHOLE_SIZE);
+			std::memcpy(workspace.upload_ring.data(lines_offset), lines_vertices.data(), lines_bytes);
+		}
+	}
 
-		// set render pass begin info
-		VkRenderPassBeginInfo begin_info{
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-			//.pNext = nullptr,
-			.renderPass = render_pass,
-			.framebuffer = framebuffer, // provide references to specific attachments
-			.renderArea{
-				.offset = {.x = 0, .y = 0},		// starting point of render area within framebuffer
-				.extent = rtg.swapchain_extent, // size of render area
-			},
+	// viewport and scissor of the objects (also what the Hi-Z pyramid's depth is rendered with):
+	VkViewport viewport{};
+	VkRect2D scissor{};
+	calculate_viewport_and_scissor(viewport, scissor);
 
-			.clearValueCount = uint32_t(clear_values.size()),
-			.pClearValues = clear_values.data(),
-		};
+	// copies of meshes mesh_pool moved, when they can't go in the frame's own command buffer (see below):
+	VkCommandBuffer moves_command_buffer = VK_NULL_HANDLE;
 
-		// begin render pass
-		vkCmdBeginRenderPass(workspace.command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+	// submits command_buffer (after moves_command_buffer, if any) for the GPU to run:
+	auto submit = [&](VkCommandBuffer command_buffer)
+	{
+		std::array<VkCommandBuffer, 2> command_buffers{moves_command_buffer, command_buffer};
+		uint32_t first_command_buffer = (moves_command_buffer == VK_NULL_HANDLE ? 1 : 0);
 
-		// Run pipelines here ==================================================================================================
+		std::array<VkSemaphore, 1> wait_semaphores{
+			render_params.image_available};
+		std::array<VkPipelineStageFlags, 1> wait_stages{
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+		static_assert(wait_semaphores.size() == wait_stages.size(), "every semaphore needs a stage");
 
-		// correct the window height and width
-		float swapchain_aspect = rtg.swapchain_extent.width / rtg.swapchain_extent.height;
-		float &camera_aspect = rtg.configuration.camera.camera_attributes.aspect;
+		std::array<VkSemaphore, 2> signal_semaphores{
+			render_params.image_done,  // signaled when GPU has finished rendering into this swapchain image
+			render_params.frame_done}; // and the frame's value on the frame timeline, when all of its work is done
+		std::array<uint64_t, 2> signal_values{
+			0, // (binary; ignored)
+			render_params.frame};
+		static_assert(signal_semaphores.size() == signal_values.size(), "every semaphore needs a value");
+
+		VkTimelineSemaphoreSubmitInfo timeline_info{
+			.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+			.signalSemaphoreValueCount = uint32_t(signal_values.size()),
+			.pSignalSemaphoreValues = signal_values.data()};
+		VkSubmitInfo submit_info{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = &timeline_info,
+			.waitSemaphoreCount = uint32_t(wait_semaphores.size()), // whcih semaphore the GPU should wait for before executing this task
+			.pWaitSemaphores = wait_semaphores.data(),
+			.pWaitDstStageMask = wait_stages.data(),
+			.commandBufferCount = uint32_t(command_buffers.size()) - first_command_buffer,
+			.pCommandBuffers = command_buffers.data() + first_command_buffer,
+			.signalSemaphoreCount = uint32_t(signal_semaphores.size()),
+			.pSignalSemaphores = signal_semaphores.data()};
 
-		float new_height = rtg.swapchain_extent.height;
-		float new_width = rtg.swapchain_extent.width;
-		float offset_x = 0.f;
-		float offset_y = 0.f;
+		VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
+	};
 
-		if (camera_aspect > swapchain_aspect) // letterbox
+	// with `--cache-commands`, CPU-driven frames are recorded into (and re-submitted from) a command buffer kept for this
+	//  workspace and swapchain image:
+	bool cache_commands = rtg.configuration.cache_commands && !(rtg.configuration.culling_mode & RTG::Configuration::Culling_Mode::GPU_FRUSTUM);
+	VkCommandBuffer command_buffer = workspace.command_buffer;
+	bool one_time_submit = true;
+	if (cache_commands)
+	{
+		std::vector<CachedCommands> &workspace_cache = cached_commands[render_params.workspace_index];
+		if (workspace_cache.size() != swapchain_framebuffers.size())
 		{
-			new_width = rtg.swapchain_extent.height * camera_aspect;
-			offset_x = (float(rtg.swapchain_extent.width) - new_width) / 2.f;
+			// (the swapchain was re-made with a different image count; this workspace's buffers are no longer pending)
+			for (size_t i = swapchain_framebuffers.size(); i < workspace_cache.size(); ++i)
+			{
+				vkFreeCommandBuffers(rtg.device, command_pool, 1, &workspace_cache[i].command_buffer);
+			}
+			workspace_cache.resize(swapchain_framebuffers.size());
+			for (CachedCommands &cached : workspace_cache)
+			{
+				if (cached.command_buffer != VK_NULL_HANDLE)
+					continue;
+
+				VkCommandBufferAllocateInfo alloc_info{
+					.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+					.commandPool = command_pool,
+					.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+					.commandBufferCount = 1};
+				VK(vkAllocateCommandBuffers(rtg.device, &alloc_info, &cached.command_buffer));
+			}
 		}
-		else  // pillarbox
+
+		// meshes mesh_pool moved (growing or compacting) are copied into its new buffer by a one-time command buffer
+		//  submitted ahead of the cached one -- a copy recorded into the cached commands would be re-submitted from the old
+		//  buffer long after it was destroyed:
+		if (mesh_pool.has_moves())
 		{
-			new_height = rtg.swapchain_extent.width / camera_aspect;
-			offset_y = (float(rtg.swapchain_extent.height) - new_height) / 2.f;
+			moves_command_buffer = workspace.command_buffer;
+			VK(vkResetCommandBuffer(moves_command_buffer, 0));
+			VkCommandBufferBeginInfo begin_info{
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+				.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			};
+			VK(vkBeginCommandBuffer(moves_command_buffer, &begin_info));
+			mesh_pool.record_moves(moves_command_buffer);
+			VK(vkEndCommandBuffer(moves_command_buffer));
 		}
 
-		{ // configure scissor rectangle
-			VkRect2D scissor{
-				.offset = {.x = 0, .y = 0},
-				.extent = {.width = static_cast<uint32_t>(new_width), .height = static_cast<uint32_t>(new_height)}
+		CachedCommands &cached = workspace_cache[render_params.image_index];
+		std::array<VkDeviceSize, 5> ring_layout{transforms_offset, instances_offset, commands_offset, lines_offset, workspace.upload_ring.head};
+		std::array<float, 4> cached_viewport{viewport.x, viewport.y, viewport.width, viewport.height};
+		std::array<int32_t, 4> cached_scissor{scissor.offset.x, scissor.offset.y, int32_t(scissor.extent.width), int32_t(scissor.extent.height)};
+
+		bool reuse = cached.valid && cached.ring_layout == ring_layout && cached.viewport == cached_viewport && cached.scissor == cached_scissor && cached.draw_groups == draw_groups;
+		if (reuse != cached_commands_reused)
+		{
+			cached_commands_reused = reuse;
+			std::cout << "[Wanderer] (Command Cache) " << (reuse ? "draws unchanged; re-submitting recorded commands." : "draws changed; recording again.") << std::endl;
+		}
+
+		if (reuse)
+		{
+			// (this frame's transforms and instance list are already in the ring, right where they were, and camera and world
+			//  are in this workspace's uniform copies)
+			submit(cached.command_buffer);
+			return;
+		}
+
+		cached.valid = true;
+		cached.ring_layout = ring_layout;
+		cached.viewport = cached_viewport;
+		cached.scissor = cached_scissor;
+		cached.draw_groups = draw_groups;
+
+		command_buffer = cached.command_buffer;
+		one_time_submit = false;
+	}
+
+	// reset the command buffer
+	VK(vkResetCommandBuffer(command_buffer, 0));
+
+	{ // begin recording: command_buffer
+		VkCommandBufferBeginInfo begin_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			//.pNext = nullptr,
+			.flags = one_time_submit ? VkCommandBufferUsageFlags(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT) : 0, // record again every submit (unless cached)
+		};
+		VK(vkBeginCommandBuffer(command_buffer, &begin_info));
+	}
+
+	// meshes mesh_pool moved (growing or compacting) are copied into its new buffer before anything draws from it
+	//  (already recorded ahead of the frame when its commands are cached):
+	mesh_pool.record_moves(command_buffer);
+
+	// GPU-driven culling: upload per-instance bounds for the cull pipeline
+	//  (one bucket of draw commands per texture, so each bucket can be drawn with its texture bound; a single bucket when bindless)
+	bool gpu_culling = (rtg.configuration.culling_mode & RTG::Configuration::Culling_Mode::GPU_FRUSTUM) && !object_instances.empty();
+	bool gpu_occlusion = gpu_culling && (rtg.configuration.culling_mode & RTG::Configuration::Culling_Mode::GPU_OCCLUSION);
+	std::vector<uint32_t> bucket_first; // first draw command of each bucket
+	std::vector<uint32_t> bucket_size;	// max draw commands of each bucket
+	bool bindless = rtg.configuration.bindless;
+	auto bucket_of = [&](ObjectInstance const &inst) -> uint32_t
+	{
+		return bindless ? 0 : inst.texture; // (bindless draws don't depend on the texture)
+	};
+	if (gpu_culling)
+	{
+		bucket_size.assign(bindless ? 1 : textures.size(), 0);
+		for (ObjectInstance const &inst : object_instances)
+		{
+			assert(inst.texture < textures.size());
+			++bucket_size[bucket_of(inst)];
+		}
+		bucket_first.assign(bucket_size.size(), 0);
+		for (size_t b = 1; b < bucket_first.size(); ++b)
+		{
+			bucket_first[b] = bucket_first[b - 1] + bucket_size[b - 1];
+		}
+
+		size_t needed_bytes = object_instances.size() * sizeof(CullPipeline::Instance);
+
+		// check if we need to re-allocate the buffers:
+		if (workspace.CullInstances.handle == VK_NULL_HANDLE || workspace.CullInstances.size < needed_bytes)
+		{
+			size_t new_bytes = ((needed_bytes + 4096) / 4096) * 4096; // round up to nearest 4k to avoid re-allocating continuously
+			size_t new_count = new_bytes / sizeof(CullPipeline::Instance);
+
+			if (workspace.CullInstances.handle)
+			{
+				rtg.helpers.destroy_buffer(std::move(workspace.CullInstances));
+			}
+			if (workspace.DrawCommands.handle)
+			{
+				rtg.helpers.destroy_buffer(std::move(workspace.DrawCommands));
+			}
+			if (workspace.DrawCounts.handle)
+			{
+				rtg.helpers.destroy_buffer(std::move(workspace.DrawCounts));
+			}
+			if (workspace.Occluded.handle)
+			{
+				rtg.helpers.destroy_buffer(std::move(workspace.Occluded));
+			}
+
+			workspace.CullInstances = rtg.helpers.create_buffer(
+				new_bytes,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // read by the cull pipeline, and a target of a memory copy
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,								   // on GPU, not host visible
+				Helpers::Unmapped,
+				Helpers::Workspace);
+			workspace.DrawCommands = rtg.helpers.create_buffer(
+				2 * new_count * sizeof(VkDrawIndirectCommand),							  // one region per phase
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, // written by the cull pipeline, read by indirect draws
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				Helpers::Unmapped,
+				Helpers::Workspace);
+			workspace.DrawCounts = rtg.helpers.create_buffer(
+				(2 * textures.size() + CullPipeline::StatCount) * sizeof(uint32_t),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, // also cleared with a fill, and stats copied back
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				Helpers::Unmapped,
+				Helpers::Workspace);
+			workspace.Occluded = rtg.helpers.create_buffer(
+				new_count * sizeof(uint32_t),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, // only used by the cull pipeline
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				Helpers::Unmapped,
+				Helpers::Workspace);
+
+			// update the descriptor set:
+			std::array<VkDescriptorBufferInfo, 3> Cull_infos{
+				VkDescriptorBufferInfo{
+					.buffer = workspace.CullInstances.handle,
+					.offset = 0,
+					.range = workspace.CullInstances.size},
+				VkDescriptorBufferInfo{
+					.buffer = workspace.DrawCommands.handle,
+					.offset = 0,
+					.range = workspace.DrawCommands.size},
+				VkDescriptorBufferInfo{
+					.buffer = workspace.DrawCounts.handle,
+					.offset = 0,
+					.range = workspace.DrawCounts.size},
 			};
-			vkCmdSetScissor(workspace.command_buffer, 0, 1, &scissor); //(xxx, index of first scissor, \
-																		//count of scissor affected, address of scissor)
+
+			VkDescriptorBufferInfo CullParams_info{
+				.buffer = workspace.CullParams.handle,
+				.offset = 0,
+				.range = workspace.CullParams.size};
+
+			VkDescriptorBufferInfo Occluded_info{
+				.buffer = workspace.Occluded.handle,
+				.offset = 0,
+				.range = workspace.Occluded.size};
+
+			std::array<VkWriteDescriptorSet, 3> writes{
+				VkWriteDescriptorSet{
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.dstSet = workspace.Cull_descriptors,
+					.dstBinding = 0,
+					.dstArrayElement = 0,
+					.descriptorCount = uint32_t(Cull_infos.size()), // bindings 0, 1, 2 (consecutive bindings of the same type)
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+					.pBufferInfo = Cull_infos.data()},
+				VkWriteDescriptorSet{
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.dstSet = workspace.Cull_descriptors,
+					.dstBinding = 3,
+					.dstArrayElement = 0,
+					.descriptorCount = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+					.pBufferInfo = &CullParams_info},
+				VkWriteDescriptorSet{
+					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+					.dstSet = workspace.Cull_descriptors,
+					.dstBinding = 4,
+					.dstArrayElement = 0,
+					.descriptorCount = 1,
+					.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+					.pBufferInfo = &Occluded_info}};
+
+			vkUpdateDescriptorSets(
+				rtg.device,
+				uint32_t(writes.size()), writes.data(), // descriptorWrites count, data
+				0, nullptr								// descriptorCopies count, data
+			);
+
+			std::cout << "Re-allocating Cull buffers to " << new_bytes << " bytes." << std::endl;
+		}
+
+		assert(workspace.CullInstances.size >= needed_bytes);
+
+		// this frame's instances, then params, are staged in one pooled buffer:
+		StagingPool::Buffer &staging = workspace.staging.emplace_back(rtg.helpers.staging.acquire(needed_bytes + sizeof(CullPipeline::Params)));
+
+		{ // copy instances into staging:
+			CullPipeline::Instance *out = reinterpret_cast<CullPipeline::Instance *>(staging.data());
+
+			assert(object_bboxes.size() == object_instances.size());
+			for (size_t i = 0; i < object_instances.size(); ++i)
+			{
+				ObjectInstance const &inst = object_instances[i];
+				BBox const &bbox = object_bboxes[i];
+				*out = CullPipeline::Instance{
+					.BBOX_MIN{bbox.min.x, bbox.min.y, bbox.min.z},
+					.FIRST_VERTEX = inst.vertices.first,
+					.BBOX_MAX{bbox.max.x, bbox.max.y, bbox.max.z},
+					.VERTEX_COUNT = inst.vertices.count,
+					.BUCKET = bucket_of(inst),
+					.COMMAND_BASE = bucket_first[bucket_of(inst)],
+				};
+				++out;
+			}
+
+			// device-side copy from staging -> CullInstances:
+			VkBufferCopy copy_region{
+				.srcOffset = 0,
+				.dstOffset = 0,
+				.size = needed_bytes};
+
+			vkCmdCopyBuffer(command_buffer, staging.handle, workspace.CullInstances.handle, 1, &copy_region);
+		}
+
+		{ // upload cull params:
+			CullPipeline::Params params{};
+			calculate_frustum_planes(calculate_culling_clip_from_world(), params.FRUSTUM_PLANES);
+
+			// occlusion is tested against depth as it was rendered (CLIP_FROM_WORLD, not the culling camera):
+			params.HIZ_VIEWS[0].CLIP_FROM_WORLD = hiz_CLIP_FROM_WORLD;
+			std::copy(hiz_viewport.begin(), hiz_viewport.end(), params.HIZ_VIEWS[0].VIEWPORT);
+			params.HIZ_VIEWS[1].CLIP_FROM_WORLD = CLIP_FROM_WORLD;
+			params.HIZ_VIEWS[1].VIEWPORT[0] = viewport.x;
+			params.HIZ_VIEWS[1].VIEWPORT[1] = viewport.y;
+			params.HIZ_VIEWS[1].VIEWPORT[2] = viewport.width;
+			params.HIZ_VIEWS[1].VIEWPORT[3] = viewport.height;
+			params.HIZ_SIZE[0] = hiz_image.extent.width;
+			params.HIZ_SIZE[1] = hiz_image.extent.height;
+			params.DEPTH_SIZE[0] = rtg.swapchain_extent.width;
+			params.DEPTH_SIZE[1] = rtg.swapchain_extent.height;
+			params.HIZ_LEVELS = hiz_levels;
+			params.HIZ_READY = (gpu_occlusion && hiz_ready) ? 1 : 0;
+
+			std::memcpy(reinterpret_cast<char *>(staging.data()) + needed_bytes, &params, sizeof(params));
+
+			assert(workspace.CullParams.size == sizeof(params));
+			VkBufferCopy copy_region{
+				.srcOffset = needed_bytes,
+				.dstOffset = 0,
+				.size = sizeof(params)};
+			vkCmdCopyBuffer(command_buffer, staging.handle, workspace.CullParams.handle, 1, &copy_region);
+		}
+
+		// reset the per-bucket draw counts and the stats:
+		vkCmdFillBuffer(command_buffer, workspace.DrawCounts.handle, 0, VK_WHOLE_SIZE, 0);
+	}
+
+	// this frame's uploads are made visible with one batch of barriers, each scoped to its resource and its readers:
+	BarrierBatch upload_barriers{.synchronization2 = rtg.device_features_13.synchronization2 == VK_TRUE};
+
+	// the streamed data goes to the render passes in a single copy (or not at all when read in place):
+	workspace.upload_ring.record_flush(
+		command_buffer, upload_barriers,
+		{
+			{transforms_offset, workspace.Transforms_range, VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT},
+			{instances_offset, workspace.Instances_range, VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT},
+			{commands_offset, rtg.configuration.draw_indirect ? draw_groups.size() * sizeof(VkDrawIndirectCommand) : 0, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT},
+			{lines_offset, lines_vertices.size() * sizeof(lines_vertices[0]), VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT},
+		});
+
+	// records a dispatch of the cull pipeline over every instance:
+	auto dispatch_cull = [&](CullPipeline::Phase phase)
+	{
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gpu_occlusion ? cull_pipeline.hiz_handle : cull_pipeline.handle);
+
+		std::array<VkDescriptorSet, 2> descriptor_sets{
+			workspace.Cull_descriptors, // set0: instances, draws, params
+			hiz_cull_descriptors,		// set1: Hi-Z pyramid (Hi-Z variant only)
 		};
-		{ // configure viewport transform
-			VkViewport viewport{
-				.x = offset_x,
-				.y = offset_y,
-				.width = new_width,
-				.height = new_height,
-				.minDepth = 0.0f,
-				.maxDepth = 1.0f,
+		vkCmdBindDescriptorSets(
+			command_buffer,							  // command buffer
+			VK_PIPELINE_BIND_POINT_COMPUTE,						  // pipeline bind point
+			cull_pipeline.layout,								  // pipeline layout
+			0,													  // first set
+			gpu_occlusion ? 2 : 1, descriptor_sets.data(),		  // descriptor sets count, ptr
+			0, nullptr											  // dynamic offsets count, ptr
+		);
+
+		CullPipeline::Push push{
+			.INSTANCE_COUNT = uint32_t(object_instances.size()),
+			.BUCKET_COUNT = uint32_t(bucket_size.size()),
+			.PHASE = phase};
+		vkCmdPushConstants(command_buffer, cull_pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+
+		uint32_t group_count = (uint32_t(object_instances.size()) + CullPipeline::WorkgroupSize - 1) / CullPipeline::WorkgroupSize;
+		vkCmdDispatch(command_buffer, group_count, 1, 1);
+
+		VkMemoryBarrier cull_barrier{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT};
+		vkCmdPipelineBarrier(
+			command_buffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, // src stage mask
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,  // dst stage mask
+			0,									  // dependency flags
+			1, &cull_barrier,					  // memory barriers (count, data)
+			0, nullptr,							  // buffer memory barriers (count, data)
+			0, nullptr							  // image memory barriers (count, data)
+		);
+	};
+
+	if (gpu_culling)
+	{ // the cull pipeline reads this frame's instances and params and counts into the freshly cleared DrawCounts:
+		upload_barriers.buffer(workspace.CullInstances.handle, 0, object_instances.size() * sizeof(CullPipeline::Instance),
+							   VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+							   VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+		upload_barriers.buffer(workspace.CullParams.handle, 0, workspace.CullParams.size,
+							   VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+							   VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_UNIFORM_READ_BIT);
+		upload_barriers.buffer(workspace.DrawCounts.handle, 0, VK_WHOLE_SIZE,
+							   VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+							   VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+		// last frame's pyramid build and late culling (which share Occluded and the pyramid) come before this frame's culling:
+		upload_barriers.memory(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+							   VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+
+		// a freshly created pyramid has no layout yet (it is never read before it is built, since HIZ_READY is 0):
+		if (gpu_occlusion && !hiz_ready)
+		{
+			upload_barriers.image(hiz_image.handle,
+								  VkImageSubresourceRange{
+									  .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+									  .baseMipLevel = 0,
+									  .levelCount = hiz_levels,
+									  .baseArrayLayer = 0,
+									  .layerCount = 1},
+								  VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+								  VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE,
+								  VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+		}
+	}
+
+	// (one vkCmdPipelineBarrier2 for the ring's pieces and the cull buffers together)
+	upload_barriers.record(command_buffer);
+
+	if (gpu_culling)
+	{ // cull instances on the GPU, writing the indirect draws used in the (early) render pass:
+		// with occlusion culling, the early phase also rejects what last frame's pyramid hides:
+		dispatch_cull(gpu_occlusion ? CullPipeline::Early : CullPipeline::FrustumOnly);
+	}
+
+	// records the objects pipeline draws into command_buffer
+	//  (with GPU culling, the draws written in the `region` of the given phase; otherwise draw groups [group_begin, group_end)):
+	auto draw_objects = [&](VkCommandBuffer command_buffer, uint32_t region, uint32_t group_begin, uint32_t group_end)
+	{
+		if (object_instances.empty())
+			return;
+
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, objects_pipeline.handle);
+
+		{ // use mesh_pool (offset 0) as vertex buffer binding 0:
+			std::array<VkBuffer, 1> vertex_buffers{mesh_pool.buffer.handle};
+			std::array<VkDeviceSize, 1> offsets{0};
+			vkCmdBindVertexBuffers(command_buffer, 0, uint32_t(vertex_buffers.size()), vertex_buffers.data(), offsets.data());
+		}
+
+		{ // bind Transforms descriptor set:
+			std::array<VkDescriptorSet, 2> descriptor_sets{
+				workspace.World_descriptors,	 // set0: World descriptor set
+				workspace.Transform_descriptors, // set1: Transforms descriptor set
+			};
+			std::array<uint32_t, 2> dynamic_offsets{
+				uint32_t(transforms_offset), // where this frame's transforms are in the upload ring
+				uint32_t(instances_offset),	 // where this frame's instance list is in the upload ring
 			};
-			vkCmdSetViewport(workspace.command_buffer, 0, 1, &viewport);
+
+			vkCmdBindDescriptorSets(
+				command_buffer,											  // command buffer
+				VK_PIPELINE_BIND_POINT_GRAPHICS,						  // pipeline bind point
+				objects_pipeline.layout,								  // pipeline layout
+				0,														  // first set
+				uint32_t(descriptor_sets.size()), descriptor_sets.data(), // descriptor sets count, ptr
+				uint32_t(dynamic_offsets.size()), dynamic_offsets.data()  // dynamic offsets count, ptr
+			);
+		}
+
+		// selects a texture for the following draws: binds it as set2, or, with push constants, pushes its index into the
+		//  texture array bound below (nothing to do bindless, where every instance finds its own texture):
+		auto bind_texture = [&](uint32_t texture)
+		{
+			if (bindless)
+				return;
+
+			if (rtg.configuration.push_constants)
+			{
+				ObjectsPipeline::Push push{
+					.MATERIAL = texture,
+					.TEXTURE = texture,
+					.FLAGS = 0,
+				};
+				vkCmdPushConstants(command_buffer, objects_pipeline.layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push), &push);
+				return;
+			}
+
+			vkCmdBindDescriptorSets(
+				command_buffer,					   // command_buffer
+				VK_PIPELINE_BIND_POINT_GRAPHICS,   // pipeline bind point
+				objects_pipeline.layout,		   // pipeline layout
+				2,								   // second set
+				1, &texture_descriptors[texture], // descriptor sets count, ptr
+				0, nullptr						   // dynamic offsets count, ptr
+			);
+		};
+
+		if (bindless)
+		{ // bind the materials and every texture:
+			vkCmdBindDescriptorSets(
+				command_buffer,					 // command_buffer
+				VK_PIPELINE_BIND_POINT_GRAPHICS, // pipeline bind point
+				objects_pipeline.layout,		 // pipeline layout
+				2,								 // second set
+				1, &bindless_descriptors,		 // descriptor sets count, ptr
+				0, nullptr						 // dynamic offsets count, ptr
+			);
+		}
+		else if (rtg.configuration.push_constants)
+		{ // bind every texture (draws pick theirs with push constants):
+			vkCmdBindDescriptorSets(
+				command_buffer,					 // command_buffer
+				VK_PIPELINE_BIND_POINT_GRAPHICS, // pipeline bind point
+				objects_pipeline.layout,		 // pipeline layout
+				2,								 // second set
+				1, &texture_array_descriptors,	 // descriptor sets count, ptr
+				0, nullptr						 // dynamic offsets count, ptr
+			);
+		}
+
+		if (gpu_culling)
+		{
+			// draw whatever survived the cull pipeline, one indirect count draw per texture bucket:
+			uint32_t command_base = region * uint32_t(object_instances.size());
+			uint32_t count_base = region * uint32_t(bucket_size.size());
+			for (uint32_t b = 0; b < uint32_t(bucket_size.size()); ++b)
+			{
+				if (bucket_size[b] == 0)
+					continue;
+
+				bind_texture(b);
+
+				vkCmdDrawIndirectCount(
+					command_buffer,
+					workspace.DrawCommands.handle, (command_base + bucket_first[b]) * sizeof(VkDrawIndirectCommand), // draw commands buffer, offset
+					workspace.DrawCounts.handle, (count_base + b) * sizeof(uint32_t),								 // count buffer, offset
+					bucket_size[b],																					 // max draw count
+					sizeof(VkDrawIndirectCommand)																	 // stride
+				);
+			}
+		}
+		else if (rtg.configuration.draw_indirect)
+		{
+			// one multi-draw per texture bucket (the groups are sorted by texture, so each bucket is a run of draw commands):
+			for (uint32_t begin = group_begin, end = group_begin; begin < group_end; begin = end)
+			{
+				uint32_t texture = draw_groups[begin].texture;
+				for (end = begin + 1; end < group_end && draw_groups[end].texture == texture; ++end)
+					;
+
+				bind_texture(texture);
+
+				vkCmdDrawIndirect(
+					command_buffer,
+					workspace.upload_ring.buffer(), commands_offset + begin * sizeof(VkDrawIndirectCommand), // draw commands buffer, offset
+					end - begin,																			  // draw count
+					sizeof(VkDrawIndirectCommand)															  // stride
+				);
+			}
+		}
+		else
+		{
+			// one instanced draw per mesh and texture (the groups are sorted by texture, so it is only re-bound when it changes):
+			uint32_t bound_texture = UINT32_MAX;
+			for (uint32_t g = group_begin; g < group_end; ++g)
+			{
+				DrawGroup const &group = draw_groups[g];
+				if (group.texture != bound_texture)
+				{
+					bind_texture(group.texture);
+					bound_texture = group.texture;
+				}
+
+				// instances [first_instance, first_instance + instance_count) of the instance list pick the Transforms:
+				vkCmdDraw(command_buffer, group.vertices.count, group.instance_count, group.vertices.first, group.first_instance);
+			}
+		}
+	};
+
+	// with `--parallel-recording`, the CPU-driven draws are split across the worker threads:
+	//  (not into cached command buffers: the recorders' secondaries are re-recorded for whichever image comes next)
+	bool parallel_recording = !workspace.recorders.empty() && !gpu_culling && !draw_groups.empty() && !cache_commands;
+
+	// GPU commands here
+	 // render pass：describes layout, "input from", "output to" of attachments
+
+		// set clear value (black)
+		[[maybe_unused]] std::array<VkClearValue, 2> clear_values{
+			VkClearValue{.color{.float32{0.6f, 0.6f, 0.6f, 1.0f}}},
+			VkClearValue{.depthStencil{.depth = 1.0f, .stencil = 0}},
+		};
+
+		// set render pass begin info
+		//	(with occlusion culling this is the early pass; the late pass follows once the pyramid is built)
+		VkRenderPassBeginInfo begin_info{
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+			//.pNext = nullptr,
+			.renderPass = gpu_occlusion ? render_pass_early : render_pass,
+			.framebuffer = framebuffer, // provide references to specific attachments
+			.renderArea{
+				.offset = {.x = 0, .y = 0},		// starting point of render area within framebuffer
+				.extent = rtg.swapchain_extent, // size of render area
+			},
+
+			.clearValueCount = uint32_t(clear_values.size()),
+			.pClearValues = clear_values.data(),
 		};
 
+		// begin render pass
+		//	(with parallel recording, its contents all come from the recorders' secondary command buffers)
+		vkCmdBeginRenderPass(command_buffer, &begin_info, parallel_recording ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+
+		// Run pipelines here ==================================================================================================
+
+		if (!parallel_recording)
+		{
+			vkCmdSetScissor(command_buffer, 0, 1, &scissor); //(xxx, index of first scissor, \
+																		//count of scissor affected, address of scissor)
+			vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+		}
+
 		// { // draw with the background pipeline
-		// 	vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, background_pipeline.handle);
+		// 	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, background_pipeline.handle);
 
 		// 	{ // push time:
 		// 		BackgroundPipeline::Push push{
 		// 			.time = float(time)};
-		// 		vkCmdPushConstants(workspace.command_buffer, background_pipeline.layout,
+		// 		vkCmdPushConstants(command_buffer, background_pipeline.layout,
 		// 						   VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push), &push);
 		// 	};
 
-		// 	vkCmdDraw(workspace.command_buffer, 3, 1, 0, 0);
+		// 	vkCmdDraw(command_buffer, 3, 1, 0, 0);
 		// };
 
 		// { // draw with the lines pipeline
-		// 	vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lines_pipeline.handle);
+		// 	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lines_pipeline.handle);
 
-		// 	{ // use lines_vertices (offset 0) as vertex buffer binding 0:
-		// 		std::array<VkBuffer, 1> vertex_buffers{workspace.lines_vertices.handle};
-		// 		std::array<VkDeviceSize, 1> offsets{0};
-		// 		vkCmdBindVertexBuffers(workspace.command_buffer, 0, uint32_t(vertex_buffers.size()), vertex_buffers.data(), offsets.data());
+		// 	{ // use lines vertices (in the upload ring) as vertex buffer binding 0:
+		// 		std::array<VkBuffer, 1> vertex_buffers{workspace.upload_ring.buffer()};
+		// 		std::array<VkDeviceSize, 1> offsets{lines_offset};
+		// 		vkCmdBindVertexBuffers(command_buffer, 0, uint32_t(vertex_buffers.size()), vertex_buffers.data(), offsets.data());
 		// 	};
 
 		// 	{ // bind Camera descriptor set:
@@ -601,7 +1547,7 @@ void Wanderer::render(RTG &rtg_, RTG::RenderParams const &render_params)
 		// 			workspace.Camera_descriptors, // set0: Camera descriptor set
 		// 		};
 		// 		vkCmdBindDescriptorSets(
-		// 			workspace.command_buffer,
+		// 			command_buffer,
 		// 			VK_PIPELINE_BIND_POINT_GRAPHICS,						  // pipeline bind point
 		// 			lines_pipeline.layout,									  // pipeline layout
 		// 			0,														  // the set number of the first descriptor set to be bound
@@ -611,87 +1557,204 @@ void Wanderer::render(RTG &rtg_, RTG::RenderParams const &render_params)
 		// 	};
 
 		// 	// draw lines vertices:
-		// 	vkCmdDraw(workspace.command_buffer, uint32_t(lines_vertices.size()), 1, 0, 0);
+		// 	vkCmdDraw(command_buffer, uint32_t(lines_vertices.size()), 1, 0, 0);
 		// };
 
-		{ // draw with the objects pipeline
-			if (!object_instances.empty())
-			{
-				vkCmdBindPipeline(workspace.command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, objects_pipeline.handle);
+		// draw with the objects pipeline
+		std::chrono::high_resolution_clock::time_point record_before = std::chrono::high_resolution_clock::now();
+		if (parallel_recording)
+		{
+			// split the draw groups evenly between the recorders (ones left without draws aren't executed):
+			uint32_t group_count = uint32_t(draw_groups.size());
+			uint32_t recorder_count = std::min(uint32_t(workspace.recorders.size()), group_count);
 
-				{ // use object_vertices (offset 0) as vertex buffer binding 0:
-					std::array<VkBuffer, 1> vertex_buffers{object_vertices.handle};
-					std::array<VkDeviceSize, 1> offsets{0};
-					vkCmdBindVertexBuffers(workspace.command_buffer, 0, uint32_t(vertex_buffers.size()), vertex_buffers.data(), offsets.data());
-				}
+			worker_pool.parallel_for(recorder_count, [&](uint32_t r)
+			{
+				Workspace::Recorder &recorder = workspace.recorders[r];
+				VK(vkResetCommandPool(rtg.device, recorder.command_pool, 0));
+
+				VkCommandBufferInheritanceInfo inheritance_info{
+					.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+					.renderPass = render_pass,
+					.subpass = 0,
+					.framebuffer = framebuffer,
+				};
+				VkCommandBufferBeginInfo begin_info{
+					.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+					.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, // entirely inside the render pass
+					.pInheritanceInfo = &inheritance_info,
+				};
+				VK(vkBeginCommandBuffer(recorder.command_buffer, &begin_info));
+
+				// (dynamic state isn't inherited from the primary command buffer)
+				vkCmdSetScissor(recorder.command_buffer, 0, 1, &scissor);
+				vkCmdSetViewport(recorder.command_buffer, 0, 1, &viewport);
+
+				draw_objects(recorder.command_buffer, 0, group_count * r / recorder_count, group_count * (r + 1) / recorder_count);
+
+				VK(vkEndCommandBuffer(recorder.command_buffer));
+			});
 
-				// Camera descriptor set is already bound from the lines pipeline
-
-				{ // bind Transforms descriptor set:
-					std::array<VkDescriptorSet, 2> descriptor_sets{
-						workspace.World_descriptors,	 // set0: World descriptor set
-						workspace.Transform_descriptors, // set1: Transforms descriptor set
-					};
-
-					vkCmdBindDescriptorSets(
-						workspace.command_buffer,								  // command buffer
-						VK_PIPELINE_BIND_POINT_GRAPHICS,						  // pipeline bind point
-						objects_pipeline.layout,								  // pipeline layout
-						0,														  // first set
-						uint32_t(descriptor_sets.size()), descriptor_sets.data(), // descriptor sets count, ptr
-						0, nullptr												  // dynamic offsets count, ptr
-					);
-				}
+			std::vector<VkCommandBuffer> secondaries;
+			for (uint32_t r = 0; r < recorder_count; ++r)
+				secondaries.emplace_back(workspace.recorders[r].command_buffer);
+			vkCmdExecuteCommands(command_buffer, uint32_t(secondaries.size()), secondaries.data());
+		}
+		else
+		{
+			draw_objects(command_buffer, 0, 0, uint32_t(draw_groups.size()));
+		}
 
-				// draw all vertices:
-				for (ObjectInstance const &inst : object_instances)
-				{
-					uint32_t index = uint32_t(&inst - &object_instances[0]);
-
-					// bind texture descriptor set:
-					vkCmdBindDescriptorSets(
-						workspace.command_buffer,			   // command_buffer
-						VK_PIPELINE_BIND_POINT_GRAPHICS,	   // pipeline bind point
-						objects_pipeline.layout,			   // pipeline layout
-						2,									   // second set
-						1, &texture_descriptors[inst.texture], // descriptor sets count, ptr
-						0, nullptr							   // dynamic offsets count, ptr
-					);
-
-					vkCmdDraw(workspace.command_buffer, inst.vertices.count, 1, inst.vertices.first, index);
-				}
+		if (rtg.configuration.debug)
+		{ // accumulate (and periodically report) the recording time:
+			std::chrono::high_resolution_clock::time_point record_after = std::chrono::high_resolution_clock::now();
+			recording_seconds += std::chrono::duration<double>(record_after - record_before).count();
+			recording_draws += gpu_culling ? bucket_size.size() : draw_groups.size();
+			if (++recording_frames == RecordingReportFrames)
+			{
+				char const *textures_by = bindless ? "bindless array" : rtg.configuration.push_constants ? "push constants" : "descriptor binds";
+				std::cout << "[Wanderer] (Recording) objects: " << (recording_seconds * 1e6 / recording_frames) << " us per frame over the last " << recording_frames << " frames ("
+						  << (recording_draws / recording_frames) << " draws per frame; textures by " << textures_by << "; "
+						  << (parallel_recording ? std::to_string(workspace.recorders.size()) + " recording threads" : std::string("recorded inline")) << ")." << std::endl;
+				recording_seconds = 0.0;
+				recording_draws = 0;
+				recording_frames = 0;
 			}
 		}
 
-		vkCmdEndRenderPass(workspace.command_buffer);
+		vkCmdEndRenderPass(command_buffer);
 	;
 
-	// end recording command_buffer
-	VK(vkEndCommandBuffer(workspace.command_buffer));
+	if (gpu_occlusion)
+	{ // build this frame's Hi-Z pyramid from the early pass depth, then draw what it no longer hides:
+		auto compute_barrier = [&]()
+		{
+			VkMemoryBarrier barrier{
+				.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT};
+			vkCmdPipelineBarrier(
+				command_buffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, // src stage mask
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, // dst stage mask
+				0,									  // dependency flags
+				1, &barrier,						  // memory barriers (count, data)
+				0, nullptr,							  // buffer memory barriers (count, data)
+				0, nullptr							  // image memory barriers (count, data)
+			);
+		};
 
-	// submit `workspace.command buffer` for the GPU to run:
-	{
-		std::array<VkSemaphore, 1> wait_semaphores{
-			render_params.image_available};
-		std::array<VkPipelineStageFlags, 1> wait_stages{
-			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-		static_assert(wait_semaphores.size() == wait_stages.size(), "every semaphore needs a stage");
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, hiz_pipeline.handle);
 
-		std::array<VkSemaphore, 1> signal_semaphores{
-			render_params.image_done};
-		VkSubmitInfo submit_info{
-			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-			.waitSemaphoreCount = uint32_t(wait_semaphores.size()), // whcih semaphore the GPU should wait for before executing this task
-			.pWaitSemaphores = wait_semaphores.data(),
-			.pWaitDstStageMask = wait_stages.data(),
-			.commandBufferCount = 1,
-			.pCommandBuffers = &workspace.command_buffer,
-			.signalSemaphoreCount = uint32_t(signal_semaphores.size()), // signaled when GPU has finished rendering into this swapchain image
-			.pSignalSemaphores = signal_semaphores.data()};
+		// (the early pass' outgoing dependency already makes its depth visible to compute reads)
+		int32_t src_width = int32_t(rtg.swapchain_extent.width);
+		int32_t src_height = int32_t(rtg.swapchain_extent.height);
+		for (uint32_t level = 0; level < hiz_levels; ++level)
+		{
+			int32_t dst_width = std::max(1, int32_t(hiz_image.extent.width) >> level);
+			int32_t dst_height = std::max(1, int32_t(hiz_image.extent.height) >> level);
+
+			vkCmdBindDescriptorSets(
+				command_buffer,		   // command buffer
+				VK_PIPELINE_BIND_POINT_COMPUTE,	   // pipeline bind point
+				hiz_pipeline.layout,			   // pipeline layout
+				0,								   // first set
+				1, &hiz_level_descriptors[level], // descriptor sets count, ptr
+				0, nullptr						   // dynamic offsets count, ptr
+			);
+
+			HiZPipeline::Push push{
+				.SRC_SIZE{src_width, src_height},
+				.DST_SIZE{dst_width, dst_height}};
+			vkCmdPushConstants(command_buffer, hiz_pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+
+			vkCmdDispatch(command_buffer,
+						  (uint32_t(dst_width) + HiZPipeline::WorkgroupSize - 1) / HiZPipeline::WorkgroupSize,
+						  (uint32_t(dst_height) + HiZPipeline::WorkgroupSize - 1) / HiZPipeline::WorkgroupSize,
+						  1);
+
+			// the next level (or the late cull) reads this one:
+			compute_barrier();
+
+			src_width = dst_width;
+			src_height = dst_height;
+		}
+
+		// re-test the early phase rejects against this frame's pyramid:
+		dispatch_cull(CullPipeline::Late);
+
+		VkRenderPassBeginInfo late_begin_info{
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+			.renderPass = render_pass_late,
+			.framebuffer = framebuffer,
+			.renderArea{
+				.offset = {.x = 0, .y = 0},
+				.extent = rtg.swapchain_extent,
+			},
+			.clearValueCount = 0, // everything is loaded
+			.pClearValues = nullptr,
+		};
+
+		vkCmdBeginRenderPass(command_buffer, &late_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+
+		vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+		vkCmdSetViewport(command_buffer, 0, 1, &viewport);
 
-		VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, render_params.workspace_available));
+		draw_objects(command_buffer, 1, 0, uint32_t(draw_groups.size()));
+
+		vkCmdEndRenderPass(command_buffer);
+
+		// the next frame's early phase tests against this pyramid, seen the way it was rendered:
+		hiz_CLIP_FROM_WORLD = CLIP_FROM_WORLD;
+		hiz_viewport = {viewport.x, viewport.y, viewport.width, viewport.height};
+		hiz_ready = true;
+	}
+
+	if (gpu_culling)
+	{ // copy the culling stats back, to be reported once this workspace is available again:
+		VkMemoryBarrier stats_barrier{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT};
+		vkCmdPipelineBarrier(
+			command_buffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, // src stage mask
+			VK_PIPELINE_STAGE_TRANSFER_BIT,		  // dst stage mask
+			0,									  // dependency flags
+			1, &stats_barrier,					  // memory barriers (count, data)
+			0, nullptr,							  // buffer memory barriers (count, data)
+			0, nullptr							  // image memory barriers (count, data)
+		);
+
+		VkBufferCopy copy_region{
+			.srcOffset = 2 * bucket_size.size() * sizeof(uint32_t),
+			.dstOffset = 0,
+			.size = workspace.CullStats.size};
+		vkCmdCopyBuffer(command_buffer, workspace.DrawCounts.handle, workspace.CullStats.handle, 1, &copy_region);
+
+		VkMemoryBarrier host_barrier{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_HOST_READ_BIT};
+		vkCmdPipelineBarrier(
+			command_buffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, // src stage mask
+			VK_PIPELINE_STAGE_HOST_BIT,		// dst stage mask
+			0,								// dependency flags
+			1, &host_barrier,				// memory barriers (count, data)
+			0, nullptr,						// buffer memory barriers (count, data)
+			0, nullptr						// image memory barriers (count, data)
+		);
+
+		workspace.CullStats_pending = true;
 	}
 
+	// end recording command_buffer
+	VK(vkEndCommandBuffer(command_buffer));
+
+	// submit the command buffer for the GPU to run:
+	submit(command_buffer);
+
 }
 
 void Wanderer::update(float dt)
@@ -842,26 +1905,6 @@ void Wanderer::update(float dt)
 		}
 	};
 
-	// ===============================================
-	// set world data (sun and sky)
-	{ 
-		world.SKY_DIRECTION.x = 0.0f;
-		world.SKY_DIRECTION.y = 0.0f;
-		world.SKY_DIRECTION.z = 1.0f;
-
-		world.SKY_ENERGY.r = 0.1f;
-		world.SKY_ENERGY.g = 0.1f;
-		world.SKY_ENERGY.b = 0.2f;
-
-		world.SUN_DIRECTION.x = 6.0f / 23.0f;
-		world.SUN_DIRECTION.y = 13.0f / 23.0f;
-		world.SUN_DIRECTION.z = 18.0f / 23.0f;
-
-		world.SUN_ENERGY.r = 1.0f;
-		world.SUN_ENERGY.g = 1.0f;
-		world.SUN_ENERGY.b = 0.9f;
-	};
-
 	// ===============================================
 	// apply drivers to nodes to animate the scene
 	if (!animation_timer.paused) 
@@ -877,13 +1920,11 @@ void Wanderer::update(float dt)
 	};
 
 	// ===============================================
-	// set objects transformation
-	{ 
-		object_instances.clear();
+	// set world data from this frame's node matrices (sun and sky; only a change bumps its version, so unchanged frames
+	//  upload nothing)
+	world_uniform.set(make_world(rtg.configuration.sceneMgr));
 
-		// instances for all scene graph nodes
-		construct_scene_graph_vertices_with_culling(object_instances, rtg.configuration.sceneMgr, CLIP_FROM_WORLD); 
-	};
+	// (object instances are built in render, once the workspace their transforms are written into is available)
 }
 
 void Wanderer::on_input(InputEvent const &event)
@@ -1174,10 +2215,15 @@ void Wanderer::on_input(InputEvent const &event)
 void Wanderer::init_depth_format()
 {
 	// select the depth format ==================================================================
+	//	(the Hi-Z pyramid is built by sampling the depth buffer, so gpu-occlusion also needs a sampleable format)
+	VkFormatFeatureFlags depth_features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	if (rtg.configuration.culling_mode & RTG::Configuration::Culling_Mode::GPU_OCCLUSION)
+		depth_features |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+
 	depth_format = rtg.helpers.find_image_format(
 		{VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32}, // depth format on current GPU; at least 1 is supported; the former is preferred
 		VK_IMAGE_TILING_OPTIMAL,
-		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+		depth_features);
 
 	std::cout << "[Wanderer] (Depth Format) " << string_VkFormat(depth_format) << std::endl;
 }
@@ -1255,8 +2301,72 @@ void Wanderer::create_render_pass()
 		.dependencyCount = uint32_t(dependencies.size()),
 		.pDependencies = dependencies.data()};
 
-	// create render pass =======================================================================
-	VK(vkCreateRenderPass(rtg.device, &create_info, nullptr, &render_pass));
+	// create render pass =======================================================================
+	VK(vkCreateRenderPass(rtg.device, &create_info, nullptr, &render_pass));
+
+	if (!(rtg.configuration.culling_mode & RTG::Configuration::Culling_Mode::GPU_OCCLUSION))
+		return;
+
+	// two-phase occlusion culling render passes ================================================
+	//	(same attachment formats and samples as render_pass, so they are compatible with its framebuffers and pipelines)
+
+	{ // early: clears and draws what was visible last frame, keeps color and leaves depth readable for the Hi-Z pyramid
+		std::array<VkAttachmentDescription, 2> early_attachments = attachments;
+		early_attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // the late pass continues drawing into it
+		early_attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		early_attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+		std::array<VkSubpassDependency, 3> early_dependencies{
+			dependencies[0],
+			VkSubpassDependency{
+				.srcSubpass = VK_SUBPASS_EXTERNAL,
+				.dstSubpass = 0,
+				.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, // last frame's late pass and pyramid build
+				.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+				.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			},
+			VkSubpassDependency{
+				.srcSubpass = 0,
+				.dstSubpass = VK_SUBPASS_EXTERNAL,
+				.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, // depth is written
+				.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,	   // before the pyramid is built from it
+				.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+			}};
+
+		VkRenderPassCreateInfo early_create_info = create_info;
+		early_create_info.pAttachments = early_attachments.data();
+		early_create_info.dependencyCount = uint32_t(early_dependencies.size());
+		early_create_info.pDependencies = early_dependencies.data();
+
+		VK(vkCreateRenderPass(rtg.device, &early_create_info, nullptr, &render_pass_early));
+	};
+
+	{ // late: loads both and draws the disocclusions found with this frame's pyramid
+		std::array<VkAttachmentDescription, 2> late_attachments = attachments;
+		late_attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		late_attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		late_attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		late_attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+		std::array<VkSubpassDependency, 1> late_dependencies{
+			VkSubpassDependency{
+				.srcSubpass = VK_SUBPASS_EXTERNAL,
+				.dstSubpass = 0,
+				.srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, // pyramid reads, early pass color writes
+				.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			}};
+
+		VkRenderPassCreateInfo late_create_info = create_info;
+		late_create_info.pAttachments = late_attachments.data();
+		late_create_info.dependencyCount = uint32_t(late_dependencies.size());
+		late_create_info.pDependencies = late_dependencies.data();
+
+		VK(vkCreateRenderPass(rtg.device, &late_create_info, nullptr, &render_pass_late));
+	};
 }
 
 void Wanderer::create_command_pool()
@@ -1274,33 +2384,40 @@ void Wanderer::create_command_pool()
 void Wanderer::create_pipelines()
 {
 	// create pipelines ========================================================================
-	//  1: background, 2: lines, 3: objects (impl in Source/Pipelines/Wanderer/*)
+	//  1: background, 2: lines, 3: objects, 4: cull (compute), 5: hi-z (compute) (impl in Source/Pipelines/Wanderer/*)
 	background_pipeline.create(rtg, render_pass, 0);
 	lines_pipeline.create(rtg, render_pass, 0);
 	objects_pipeline.create(rtg, render_pass, 0);
+	cull_pipeline.create(rtg);
+	hiz_pipeline.create(rtg);
 }
 
 void Wanderer::create_description_pool()
 {
 	uint32_t per_workspace = uint32_t(rtg.workspaces.size()); // for easier-to-read counting
 
-	std::array<VkDescriptorPoolSize, 2> pool_sizes{
+	std::array<VkDescriptorPoolSize, 3> pool_sizes{
 		VkDescriptorPoolSize{
-			// for camera
+			// for camera, world and cull params
 			.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-			.descriptorCount = 2 * per_workspace // 1 descriptor per set, 2 set per workspace
+			.descriptorCount = 3 * per_workspace // 3 descriptors per workspace
+		},
+		VkDescriptorPoolSize{
+			// for transforms and the instance list (in the upload ring)
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+			.descriptorCount = 2 * per_workspace // 2 descriptors per workspace
 		},
 		VkDescriptorPoolSize{
-			// for transform
+			// for cull (4 storage descriptors per set)
 			.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-			.descriptorCount = 1 * per_workspace // 1 descriptor per set, 1 set per workspace
+			.descriptorCount = 4 * per_workspace // 4 descriptors per workspace
 		},
 	};
 
 	VkDescriptorPoolCreateInfo create_info{
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
 		.flags = 0,					  // because CREATE_FREE_DESCRIPTOR_SET_BIT isn't included, can't free individual descriptors allocated from this pool
-		.maxSets = 3 * per_workspace, // one set per workspace
+		.maxSets = 4 * per_workspace, // camera, world, transforms, cull sets per workspace
 		.poolSizeCount = uint32_t(pool_sizes.size()),
 		.pPoolSizes = pool_sizes.data()};
 
@@ -1311,6 +2428,13 @@ void Wanderer::create_description_pool()
 void Wanderer::setup_workspaces()
 {
 	workspaces.resize(rtg.workspaces.size());
+	cached_commands.resize(workspaces.size()); // (command buffers are allocated once the swapchain image count is known)
+
+	// one copy of each change-tracked uniform per workspace:
+	camera_uniform.create(rtg.helpers, uint32_t(workspaces.size()));
+	world_uniform.create(rtg.helpers, uint32_t(workspaces.size()));
+
+	uint32_t workspace_index = 0;
 	for (Workspace &workspace : workspaces)
 	{
 		// allocate command buffer ==============================================================
@@ -1323,26 +2447,30 @@ void Wanderer::setup_workspaces()
 			VK(vkAllocateCommandBuffers(rtg.device, &alloc_info, &workspace.command_buffer));
 		}
 
-		// allocate Camera and World descriptor sets =============================================
+		// create a command pool and a secondary command buffer per recording job ===============
+		if (rtg.configuration.parallel_recording)
 		{
-			// lines_pipeline.set0_Camera --------------------------------------------------------
-
-			// create buffers for sources
-			workspace.Camera_src = rtg.helpers.create_buffer(
-				sizeof(LinesPipeline::Camera),
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host visible memory, coherent (no special sync needed)
-				Helpers::Mapped																// put it somewhere in the CPU address space
-			);
-
-			// create buffers for destinations
-			workspace.Camera = rtg.helpers.create_buffer(
-				sizeof(LinesPipeline::Camera),
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // use as a uniform buffer, and a target of a memory copy
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,								   // on GPU, not host visible
-				Helpers::Unmapped);
+			workspace.recorders.resize(worker_pool.thread_count());
+			for (Workspace::Recorder &recorder : workspace.recorders)
+			{
+				VkCommandPoolCreateInfo pool_create_info{
+					.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+					.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, // re-recorded every frame
+					.queueFamilyIndex = rtg.graphics_queue_family.value()};
+				VK(vkCreateCommandPool(rtg.device, &pool_create_info, nullptr, &recorder.command_pool));
+
+				VkCommandBufferAllocateInfo alloc_info{
+					.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+					.commandPool = recorder.command_pool,
+					.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+					.commandBufferCount = 1};
+				VK(vkAllocateCommandBuffers(rtg.device, &alloc_info, &recorder.command_buffer));
+			}
+		}
 
-			// allocate descriptor set
+		// allocate and write Camera and World descriptor sets ===================================
+		{
+			// lines_pipeline.set0_Camera --------------------------------------------------------
 			VkDescriptorSetAllocateInfo camera_set_alloc_info{
 				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
 				.descriptorPool = descriptor_pool,
@@ -1352,23 +2480,6 @@ void Wanderer::setup_workspaces()
 			VK(vkAllocateDescriptorSets(rtg.device, &camera_set_alloc_info, &workspace.Camera_descriptors));
 
 			// objects_pipeline.set0_World --------------------------------------------------------
-
-			// create buffers for sources
-			workspace.World_src = rtg.helpers.create_buffer(
-				sizeof(ObjectsPipeline::World),
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host visible memory, coherent (no special sync needed)
-				Helpers::Mapped																// put it somewhere in the CPU address space
-			);
-
-			// create buffers for destinations
-			workspace.World = rtg.helpers.create_buffer(
-				sizeof(ObjectsPipeline::World),
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // use as a uniform buffer, and a target of a memory copy
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,								   // on GPU, not host visible
-				Helpers::Unmapped);
-
-			// allocate descriptor set
 			VkDescriptorSetAllocateInfo world_set_alloc_info{
 				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
 				.descriptorPool = descriptor_pool,
@@ -1376,19 +2487,17 @@ void Wanderer::setup_workspaces()
 				.pSetLayouts = &objects_pipeline.set0_World};
 
 			VK(vkAllocateDescriptorSets(rtg.device, &world_set_alloc_info, &workspace.World_descriptors));
-		};
 
-		// bind Camera and World descriptor set to buffer =======================================
-		{
+			// (the copies never move, so these are written once)
 			VkDescriptorBufferInfo Camera_info{
-				.buffer = workspace.Camera.handle,
+				.buffer = camera_uniform.buffer(workspace_index),
 				.offset = 0,
-				.range = workspace.Camera.size};
+				.range = sizeof(LinesPipeline::Camera)};
 
 			VkDescriptorBufferInfo World_info{
-				.buffer = workspace.World.handle,
+				.buffer = world_uniform.buffer(workspace_index),
 				.offset = 0,
-				.range = workspace.World.size};
+				.range = sizeof(ObjectsPipeline::World)};
 
 			std::array<VkWriteDescriptorSet, 2> writes{
 				VkWriteDescriptorSet{
@@ -1399,7 +2508,6 @@ void Wanderer::setup_workspaces()
 					.descriptorCount = 1,
 					.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 					.pBufferInfo = &Camera_info},
-
 				VkWriteDescriptorSet{
 					.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
 					.dstSet = workspace.World_descriptors,
@@ -1407,14 +2515,13 @@ void Wanderer::setup_workspaces()
 					.dstArrayElement = 0,
 					.descriptorCount = 1,
 					.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-					.pBufferInfo = &World_info}};
+					.pBufferInfo = &World_info},
+			};
 
 			vkUpdateDescriptorSets(
 				rtg.device,
-				uint32_t(writes.size()), // descriptor write count
-				writes.data(),			 // descriptor writes
-				0,						 // descriptor copy count
-				nullptr					 // descriptor copies
+				uint32_t(writes.size()), writes.data(), // descriptorWrites count, data
+				0, nullptr								// descriptorCopies count, data
 			);
 		};
 
@@ -1429,7 +2536,34 @@ void Wanderer::setup_workspaces()
 			VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, &workspace.Transform_descriptors));
 		};
 
-		// bind Transform descriptor set to buffer is done in the render loop
+		// allocate descriptor set for the cull pipeline ========================================
+		{
+			VkDescriptorSetAllocateInfo alloc_info{
+				.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+				.descriptorPool = descriptor_pool,
+				.descriptorSetCount = 1,
+				.pSetLayouts = &cull_pipeline.set0_Cull};
+
+			VK(vkAllocateDescriptorSets(rtg.device, &alloc_info, &workspace.Cull_descriptors));
+
+			// fixed-size buffers of the cull pipeline (the per-instance ones grow in the render loop):
+			workspace.CullParams = rtg.helpers.create_buffer(
+				sizeof(CullPipeline::Params),
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // use as a uniform buffer, and a target of a memory copy
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,								   // on GPU, not host visible
+				Helpers::Unmapped,
+				Helpers::Workspace);
+			workspace.CullStats = rtg.helpers.create_buffer(
+				CullPipeline::StatCount * sizeof(uint32_t),
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,											// stats are copied back into it at the end of the frame
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // read on the CPU once the frame timeline reaches the workspace's frame
+				Helpers::Mapped,
+				Helpers::Workspace);
+		};
+
+		// bind Transform (and Cull) descriptor sets to buffers is done in the render loop
+
+		++workspace_index;
 	}
 }
 
@@ -1513,19 +2647,14 @@ void Wanderer::load_objects_vertices()
 
 	sea_vertices.count = uint32_t(tmp_object_vertices.size()) - sea_vertices.first;
 
-	// create buffer for object vertices -------------------------------------------------------
+	// create pool for object vertices --------------------------------------------------------
 
-	size_t bytes = tmp_object_vertices.size() * sizeof(tmp_object_vertices[0]);
-
-	object_vertices = rtg.helpers.create_buffer(
-		bytes,
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // use as a vertex buffer, and a target of a memory copy
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		Helpers::Unmapped);
+	mesh_pool.create(rtg.helpers, sizeof(tmp_object_vertices[0]), uint32_t(tmp_object_vertices.size()));
 
-	// copy data to buffer ----------------------------------------------------------------------
+	// copy data to pool (as one mesh, so boat and sea keep their offsets) ----------------------
 
-	rtg.helpers.transfer_to_buffer(tmp_object_vertices.data(), bytes, object_vertices);
+	[[maybe_unused]] MeshPool::Mesh objects = mesh_pool.add_mesh(rtg.helpers, tmp_object_vertices.data(), uint32_t(tmp_object_vertices.size()));
+	assert(objects != MeshPool::NoMesh && mesh_pool.range(objects).first == 0);
 }
 
 void Wanderer::load_scene_objects_vertices()
@@ -1548,8 +2677,8 @@ void Wanderer::load_scene_objects_vertices()
 		nodeQueue.push(findNodeResult->second);
 	}
 
-	std::vector<ObjectsPipeline::Vertex> tmp_object_vertices;
-	tmp_object_vertices.reserve(sceneMgr.sceneObject->rootName.size() + sceneMgr.nodeObjectMap.size());
+	std::vector<std::vector<ObjectsPipeline::Vertex>> loaded_vertices; // per mesh
+	loaded_vertices.reserve(sceneMgr.meshObjectMap.size());
 
 	while (!nodeQueue.empty())
 	{
@@ -1565,7 +2694,7 @@ void Wanderer::load_scene_objects_vertices()
 			auto findMeshResult = sceneMgr.meshObjectMap.find(node->refMeshName);
 			if (findMeshResult != sceneMgr.meshObjectMap.end())
 			{
-				load_mesh_object_vertices(findMeshResult->second, tmp_object_vertices);
+				load_mesh_object_vertices(findMeshResult->second, loaded_vertices);
 
 				// std::cout << "Mesh vertices " << sceneMgr.meshVerticesIndexMap.find(node->refMeshName)->first << " newly built." << std::endl; // [PASS]
 			}
@@ -1575,6 +2704,10 @@ void Wanderer::load_scene_objects_vertices()
 		// 	std::cout << "Mesh vertices " << sceneMgr.meshVerticesIndexMap.find(node->refMeshName)->first << " already built." << std::endl; // [PASS]
 		// }
 
+		// every visit of a node with a mesh is an instance (nodes can be reached through more than one parent)
+		if (sceneMgr.meshVerticesIndexMap.find(node->refMeshName) != sceneMgr.meshVerticesIndexMap.end())
+			++scene_instance_count;
+
 		// push children to queue
 		for (std::string &nodeName : node->childName)
 		{
@@ -1586,21 +2719,53 @@ void Wanderer::load_scene_objects_vertices()
 		}
 	}
 
-	// transfer attributes data to buffer
-	size_t bytes = tmp_object_vertices.size() * sizeof(tmp_object_vertices[0]);
+	// make the pool: big enough for every mesh, or just the budget's worth (the rest is streamed in when visible)
+	uint64_t total_vertices = 0;
+	for (MeshResidency const &residency : mesh_residency)
+	{
+		total_vertices += residency.vertex_count;
+	}
 
-	object_vertices = rtg.helpers.create_buffer(
-		bytes,
-		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // use as a vertex buffer, and a target of a memory copy
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-		Helpers::Unmapped);
+	uint64_t capacity = total_vertices;
+	uint64_t max_capacity = std::numeric_limits<uint32_t>::max();
+	bool budgeted = rtg.configuration.mesh_budget > 0.0f;
+	if (budgeted)
+	{
+		uint64_t budget_vertices = uint64_t(double(rtg.configuration.mesh_budget) * 1024.0 * 1024.0) / sizeof(ObjectsPipeline::Vertex);
+		capacity = std::min(capacity, budget_vertices);
+		max_capacity = std::min(max_capacity, budget_vertices);
+	}
+	if (capacity > std::numeric_limits<uint32_t>::max())
+		throw std::runtime_error("Scene has more mesh vertices than fit in one vertex pool; try --mesh-budget.");
+
+	mesh_pool.create(rtg.helpers, sizeof(ObjectsPipeline::Vertex), uint32_t(capacity));
+	mesh_pool.max_capacity = uint32_t(max_capacity); // (meshes added later grow the pool up to the budget)
+	mesh_pool_generation = mesh_pool.generation;
 
-	// copy data to buffer ----------------------------------------------------------------------
+	// transfer attributes data to the pool (in load order, until the budget is spent):
+	uint32_t placed = 0;
+	for (uint32_t mesh = 0; mesh < uint32_t(loaded_vertices.size()); ++mesh)
+	{
+		if (place_mesh(mesh, loaded_vertices[mesh]))
+		{
+			// (submitted by RTG::run before the first frame is rendered)
+			mesh_residency[mesh].state = MeshResidency::Resident;
+			scene_nodes_vertices[mesh] = pool_vertices(mesh);
+			++placed;
+		}
+		if (budgeted)
+			cache_mesh_vertices(mesh, std::move(loaded_vertices[mesh]));
+	}
 
-	rtg.helpers.transfer_to_buffer(tmp_object_vertices.data(), bytes, object_vertices);
+	if (budgeted)
+	{
+		std::cout << "[Wanderer] (Mesh Residency) " << placed << " of " << mesh_residency.size() << " meshes fit the "
+				  << rtg.configuration.mesh_budget << " MiB budget; " << (total_vertices * sizeof(ObjectsPipeline::Vertex)) / (1024 * 1024)
+				  << " MiB in all, " << mesh_cache_used / (1024 * 1024) << " MiB cached on the CPU." << std::endl;
+	}
 }
 
-void Wanderer::load_mesh_object_vertices(SceneMgr::MeshObject *meshObject, std::vector<ObjectsPipeline::Vertex> &tmp_object_vertices)
+void Wanderer::load_mesh_object_vertices(SceneMgr::MeshObject *meshObject, std::vector<std::vector<ObjectsPipeline::Vertex>> &loaded_vertices)
 {
 	SceneMgr &sceneMgr = rtg.configuration.sceneMgr;
 	
@@ -1626,9 +2791,6 @@ void Wanderer::load_mesh_object_vertices(SceneMgr::MeshObject *meshObject, std::
 	assert(refMesh->positionList.size() == refMesh->normalList.size() && refMesh->normalList.size() == refMesh->tangentList.size() && refMesh->tangentList.size() == refMesh->texcoordList.size());
 
 
-	ObjectVertices mesh_vertices;
-	mesh_vertices.first = uint32_t(tmp_object_vertices.size());
-
 	uint32_t vertexCount = refMesh->positionList.size();
 
 	// calculate BBox for the mesh object
@@ -1638,34 +2800,276 @@ void Wanderer::load_mesh_object_vertices(SceneMgr::MeshObject *meshObject, std::
 		refMesh->bbox.enclose(refMesh->positionList[i]);
 	}
 
-	// assembly attributes into scene object vertex
+	// assembly attributes into scene object vertices
+
+	loaded_vertices.emplace_back(interleave_mesh_vertices(refMesh->positionList, refMesh->normalList, refMesh->tangentList, refMesh->texcoordList));
+
+	if (rtg.configuration.mesh_budget > 0.0f)
+	{ // (only positions are needed on the CPU from now on, for bboxes and occluders; re-streaming reads the rest again)
+		std::vector<glm::vec3>().swap(refMesh->normalList);
+		std::vector<glm::vec4>().swap(refMesh->tangentList);
+		std::vector<glm::vec2>().swap(refMesh->texcoordList);
+	}
+
+	sceneMgr.meshVerticesIndexMap[meshObject->name] = scene_nodes_vertices.size();
+	scene_nodes_vertices.emplace_back(); // (set once the mesh is in mesh_pool)
+	mesh_residency.emplace_back(MeshResidency{
+		.mesh = refMesh,
+		.vertex_count = vertexCount,
+	});
+}
+
+std::vector<Wanderer::ObjectsPipeline::Vertex> Wanderer::interleave_mesh_vertices(std::vector<glm::vec3> const &positions, std::vector<glm::vec3> const &normals, std::vector<glm::vec4> const &tangents, std::vector<glm::vec2> const &texcoords)
+{
+	assert(positions.size() == normals.size() && normals.size() == tangents.size() && tangents.size() == texcoords.size());
 
-	for (uint32_t i = 0; i < vertexCount; ++i)
+	std::vector<ObjectsPipeline::Vertex> vertices;
+	vertices.reserve(positions.size());
+	for (size_t i = 0; i < positions.size(); ++i)
 	{
 		ObjectsPipeline::Vertex node_vertex;
-		node_vertex.Position.x = refMesh->positionList[i].x;
-		node_vertex.Position.y = refMesh->positionList[i].y;
-		node_vertex.Position.z = refMesh->positionList[i].z;
+		node_vertex.Position.x = positions[i].x;
+		node_vertex.Position.y = positions[i].y;
+		node_vertex.Position.z = positions[i].z;
 
-		node_vertex.Normal.x = refMesh->normalList[i].x;
-		node_vertex.Normal.y = refMesh->normalList[i].y;
-		node_vertex.Normal.z = refMesh->normalList[i].z;
+		node_vertex.Normal.x = normals[i].x;
+		node_vertex.Normal.y = normals[i].y;
+		node_vertex.Normal.z = normals[i].z;
 
-		node_vertex.Tangent.x = refMesh->tangentList[i].x;
-		node_vertex.Tangent.y = refMesh->tangentList[i].y;
-		node_vertex.Tangent.z = refMesh->tangentList[i].z;
-		node_vertex.Tangent.w = refMesh->tangentList[i].w;
+		node_vertex.Tangent.x = tangents[i].x;
+		node_vertex.Tangent.y = tangents[i].y;
+		node_vertex.Tangent.z = tangents[i].z;
+		node_vertex.Tangent.w = tangents[i].w;
 
-		node_vertex.TexCoord.s = refMesh->texcoordList[i].x;
-		node_vertex.TexCoord.t = refMesh->texcoordList[i].y;
+		node_vertex.TexCoord.s = texcoords[i].x;
+		node_vertex.TexCoord.t = texcoords[i].y;
 
-		tmp_object_vertices.push_back(node_vertex);
+		vertices.push_back(node_vertex);
 	}
+	return vertices;
+}
 
-	mesh_vertices.count = uint32_t(tmp_object_vertices.size()) - mesh_vertices.first;
+void Wanderer::update_mesh_residency(std::vector<ObjectInstance> &object_instances)
+{
+	++residency_frame;
 
-	sceneMgr.meshVerticesIndexMap[meshObject->name] = scene_nodes_vertices.size();
-	scene_nodes_vertices.push_back(mesh_vertices);
+	uint32_t streamed_in = 0;
+	uint32_t loaded = 0;
+	uint64_t evictions_before = mesh_evictions;
+
+	// uploads submitted by now (RTG::run flushes before every render) are seen by this frame's draws:
+	for (uint32_t mesh = 0; mesh < uint32_t(mesh_residency.size()); ++mesh)
+	{
+		MeshResidency &residency = mesh_residency[mesh];
+		if (residency.state == MeshResidency::Uploading && residency.ticket <= rtg.helpers.uploads.submitted())
+		{
+			residency.state = MeshResidency::Resident;
+			scene_nodes_vertices[mesh] = pool_vertices(mesh);
+			++streamed_in;
+		}
+	}
+
+	// note which meshes culling left visible, and which of those are missing:
+	std::vector<uint32_t> wanted;
+	for (ObjectInstance const &instance : object_instances)
+	{
+		uint32_t mesh = transform_meshes[instance.transform];
+		MeshResidency &residency = mesh_residency[mesh];
+		if (residency.last_visible != residency_frame)
+		{
+			residency.last_visible = residency_frame;
+			if (residency.state == MeshResidency::Evicted)
+				wanted.emplace_back(mesh);
+		}
+	}
+
+	// finished .b72 reads go to the pool (if they still fit; they were visible a moment ago) and the cache:
+	for (uint32_t mesh = 0; mesh < uint32_t(mesh_residency.size()); ++mesh)
+	{
+		MeshResidency &residency = mesh_residency[mesh];
+		if (residency.state != MeshResidency::Loading || residency.loading.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			continue;
+
+		std::vector<ObjectsPipeline::Vertex> vertices = residency.loading.get();
+		residency.state = MeshResidency::Evicted;
+		--mesh_loads;
+		++loaded;
+
+		if (vertices.size() != residency.vertex_count)
+		{
+			std::cerr << "[Wanderer] (Mesh Residency) Re-reading mesh '" << residency.mesh->name << "' gave " << vertices.size()
+					  << " vertices instead of " << residency.vertex_count << "; leaving it out." << std::endl;
+			residency.vertex_count = 0; // (never wanted again)
+			continue;
+		}
+
+		place_mesh(mesh, vertices);
+		cache_mesh_vertices(mesh, std::move(vertices));
+	}
+
+	// bring the missing meshes back, from the cache right away or from their .b72 files on a loader thread:
+	for (uint32_t mesh : wanted)
+	{
+		MeshResidency &residency = mesh_residency[mesh];
+		if (residency.vertex_count == 0)
+			continue;
+
+		if (!residency.cached.empty())
+		{
+			place_mesh(mesh, residency.cached); // (if it doesn't fit, it is wanted again next time it is seen)
+		}
+		else if (mesh_loads < MaxMeshLoads)
+		{
+			std::string folder = rtg.configuration.scene_graph_parent_folder;
+			std::array<SceneMgr::AttributeStream, 4> streams{residency.mesh->attrPosition, residency.mesh->attrNormal, residency.mesh->attrTangent, residency.mesh->attrTexcoord};
+
+			// (only reads the copies it was handed, so it can run alongside the frame)
+			residency.loading = std::async(std::launch::async, [folder, streams]() mutable
+										   {
+				std::vector<glm::vec3> positions, normals;
+				std::vector<glm::vec4> tangents;
+				std::vector<glm::vec2> texcoords;
+				LoadMgr::read_s72_mesh_attribute_to_list(positions, streams[0], folder);
+				LoadMgr::read_s72_mesh_attribute_to_list(normals, streams[1], folder);
+				LoadMgr::read_s72_mesh_attribute_to_list(tangents, streams[2], folder);
+				LoadMgr::read_s72_mesh_attribute_to_list(texcoords, streams[3], folder);
+				if (!(positions.size() == normals.size() && normals.size() == tangents.size() && tangents.size() == texcoords.size()))
+					return std::vector<ObjectsPipeline::Vertex>();
+				return interleave_mesh_vertices(positions, normals, tangents, texcoords); });
+			residency.state = MeshResidency::Loading;
+			++mesh_loads;
+		}
+	}
+
+	uint64_t evicted = mesh_evictions - evictions_before;
+	if (streamed_in != 0 || evicted != 0 || loaded != 0)
+	{
+		uint32_t resident = uint32_t(std::count_if(mesh_residency.begin(), mesh_residency.end(), [](MeshResidency const &r) { return r.state == MeshResidency::Resident; }));
+		std::cout << "[Wanderer] (Mesh Residency) " << streamed_in << " streamed in, " << evicted << " evicted, " << loaded << " read from .b72; "
+				  << resident << " of " << mesh_residency.size() << " meshes resident, " << (uint64_t(mesh_pool.used) * mesh_pool.vertex_size) / (1024 * 1024)
+				  << " of " << (uint64_t(mesh_pool.capacity) * mesh_pool.vertex_size) / (1024 * 1024) << " MiB of the pool in use, "
+				  << mesh_cache_used / (1024 * 1024) << " MiB cached, " << mesh_loads << " reads in flight." << std::endl;
+	}
+
+	// keep the instances of resident meshes (placing may have grown or compacted the pool, so ranges are read only now):
+	bool with_bboxes = object_bboxes.size() == object_instances.size();
+	size_t kept = 0;
+	for (size_t i = 0; i < object_instances.size(); ++i)
+	{
+		uint32_t mesh = transform_meshes[object_instances[i].transform];
+		if (mesh_residency[mesh].state != MeshResidency::Resident)
+			continue;
+
+		object_instances[i].vertices = pool_vertices(mesh); // (may have become resident, or moved, since the traversal)
+		if (kept != i)
+		{
+			object_instances[kept] = object_instances[i];
+			if (with_bboxes)
+				object_bboxes[kept] = object_bboxes[i];
+		}
+		++kept;
+	}
+	object_instances.resize(kept);
+	if (with_bboxes)
+		object_bboxes.resize(kept);
+}
+
+bool Wanderer::place_mesh(uint32_t mesh, std::vector<ObjectsPipeline::Vertex> const &vertices)
+{
+	MeshResidency &residency = mesh_residency[mesh];
+	assert(residency.state == MeshResidency::Evicted);
+	assert(vertices.size() == residency.vertex_count);
+
+	UploadBatcher::Ticket ticket = 0;
+	MeshPool::Mesh handle = mesh_pool.add_mesh(rtg.helpers, vertices.data(), residency.vertex_count, &ticket);
+	if (handle == MeshPool::NoMesh)
+	{
+		// evict the least recently visible meshes that no frame in flight draws (frames older than the workspace count
+		//  have finished: their workspaces were waited on) until a range is free:
+		std::vector<uint32_t> candidates;
+		for (uint32_t other = 0; other < uint32_t(mesh_residency.size()); ++other)
+		{
+			MeshResidency const &r = mesh_residency[other];
+			if (r.state == MeshResidency::Resident && r.vertex_count > 0 && r.last_visible + workspaces.size() <= residency_frame)
+				candidates.emplace_back(other);
+		}
+		std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b)
+				  { return mesh_residency[a].last_visible < mesh_residency[b].last_visible; });
+
+		for (uint32_t victim : candidates)
+		{
+			evict_mesh(victim);
+			handle = mesh_pool.add_mesh(rtg.helpers, vertices.data(), residency.vertex_count, &ticket);
+			if (handle != MeshPool::NoMesh)
+				break;
+		}
+		if (handle == MeshPool::NoMesh)
+			return false;
+	}
+
+	residency.handle = handle;
+	residency.ticket = ticket;
+	residency.state = MeshResidency::Uploading;
+	return true;
+}
+
+void Wanderer::evict_mesh(uint32_t mesh)
+{
+	MeshResidency &residency = mesh_residency[mesh];
+	assert(residency.state == MeshResidency::Resident);
+
+	mesh_pool.remove_mesh(residency.handle, false); // (only meshes no frame in flight draws are evicted)
+	residency.handle = MeshPool::NoMesh;
+	residency.state = MeshResidency::Evicted;
+	scene_nodes_vertices[mesh] = ObjectVertices{};
+	++mesh_evictions;
+}
+
+Wanderer::ObjectVertices Wanderer::pool_vertices(uint32_t mesh) const
+{
+	MeshPool::Range range = mesh_pool.range(mesh_residency[mesh].handle);
+	return ObjectVertices{.first = range.first, .count = range.count};
+}
+
+void Wanderer::sync_mesh_pool()
+{
+	if (mesh_pool.generation == mesh_pool_generation)
+		return;
+	mesh_pool_generation = mesh_pool.generation;
+
+	for (uint32_t mesh = 0; mesh < uint32_t(mesh_residency.size()); ++mesh)
+	{
+		if (mesh_residency[mesh].state == MeshResidency::Resident)
+			scene_nodes_vertices[mesh] = pool_vertices(mesh);
+	}
+
+	// (recorded commands bind the old buffer, and the new one still needs the moves recorded into it)
+	invalidate_cached_commands();
+}
+
+void Wanderer::cache_mesh_vertices(uint32_t mesh, std::vector<ObjectsPipeline::Vertex> &&vertices)
+{
+	MeshResidency &residency = mesh_residency[mesh];
+	VkDeviceSize bytes = vertices.size() * sizeof(ObjectsPipeline::Vertex);
+	if (!residency.cached.empty() || bytes == 0 || bytes > mesh_cache_bytes)
+		return;
+
+	// make room by dropping the copies of the least recently visible meshes:
+	while (mesh_cache_used + bytes > mesh_cache_bytes)
+	{
+		MeshResidency *oldest = nullptr;
+		for (MeshResidency &other : mesh_residency)
+		{
+			if (&other != &residency && !other.cached.empty() && (oldest == nullptr || other.last_visible < oldest->last_visible))
+				oldest = &other;
+		}
+		assert(oldest != nullptr);
+		mesh_cache_used -= oldest->cached.size() * sizeof(ObjectsPipeline::Vertex);
+		std::vector<ObjectsPipeline::Vertex>().swap(oldest->cached);
+	}
+
+	residency.cached = std::move(vertices);
+	mesh_cache_used += bytes;
 }
 
 void Wanderer::create_diy_textures()
@@ -1701,9 +3105,11 @@ void Wanderer::create_diy_textures()
 		VkExtent2D{.width = size, .height = size}, // size pf image
 		VK_FORMAT_R8G8B8A8_UNORM,				   // interpret image using SRGB-encoded 8-bit RGBA
 		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, // will sample and upload
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,						  // should be device-local
-		Helpers::Unmapped));
+		TextureUsage,						 // will sample and upload (and maybe move)
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, // should be device-local
+		Helpers::Unmapped,
+		1,
+		Helpers::Textures));
 
 	// transfer data
 	rtg.helpers.transfer_to_image(data.data(), sizeof(data[0]) * data.size(), textures.back());
@@ -1733,9 +3139,11 @@ void Wanderer::create_diy_textures()
 		VkExtent2D{.width = size, .height = size}, // size of image
 		VK_FORMAT_R8G8B8A8_SRGB,				   // interpret image using SRGB-encoded 8-bit RGBA
 		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, // will sample and upload
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,						  // should be device-local
-		Helpers::Unmapped));
+		TextureUsage,						 // will sample and upload (and maybe move)
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, // should be device-local
+		Helpers::Unmapped,
+		1,
+		Helpers::Textures));
 
 	// transfer data:
 	rtg.helpers.transfer_to_image(data.data(), sizeof(data[0]) * data.size(), textures.back());
@@ -1762,9 +3170,11 @@ void Wanderer::create_diy_textures()
 		VkExtent2D{.width = size, .height = size}, // size of image
 		VK_FORMAT_R8G8B8A8_UNORM,				   // interpret image using SRGB-encoded 8-bit RGBA
 		VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, // will sample and upload
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,						  // should be device-local
-		Helpers::Unmapped));
+		TextureUsage,						 // will sample and upload (and maybe move)
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, // should be device-local
+		Helpers::Unmapped,
+		1,
+		Helpers::Textures));
 
 	// transfer data:
 	rtg.helpers.transfer_to_image(data.data(), sizeof(data[0]) * data.size(), textures.back());
@@ -1777,25 +3187,7 @@ void Wanderer::create_textures_descriptor()
 	texture_views.reserve(textures.size());
 	for (Helpers::AllocatedImage const &image : textures)
 	{
-		VkImageViewCreateInfo image_view_create_info{
-			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-			.flags = 0,
-			.image = image.handle,
-			.viewType = VK_IMAGE_VIEW_TYPE_2D,
-			.format = image.format,
-
-			.subresourceRange{
-				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-				.baseMipLevel = 0,
-				.levelCount = 1,
-				.baseArrayLayer = 0,
-				.layerCount = 1},
-		};
-
-		VkImageView image_view = VK_NULL_HANDLE;
-		VK(vkCreateImageView(rtg.device, &image_view_create_info, nullptr, &image_view));
-
-		texture_views.emplace_back(image_view);
+		texture_views.emplace_back(create_texture_view(image));
 	}
 	assert(texture_views.size() == textures.size());
 
@@ -1820,76 +3212,332 @@ void Wanderer::create_textures_descriptor()
 		.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
 		.unnormalizedCoordinates = VK_FALSE};
 
-	VK(vkCreateSampler(rtg.device, &sampler_create_info, nullptr, &texture_sampler));
+	VK(vkCreateSampler(rtg.device, &sampler_create_info, nullptr, &texture_sampler));
+
+	// create the texture descriptor pool =======================================================
+
+	uint32_t per_texture = uint32_t(textures.size()); // for easier-to-read counting
+
+	std::array<VkDescriptorPoolSize, 1> pool_sizes{
+		VkDescriptorPoolSize{
+			.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1 * 1 * per_texture, // 1 descriptor per set, 1 set per texture
+		}};
+
+	VkDescriptorPoolCreateInfo desc_pool_create_info{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.flags = 0,					// because CREATE_FREE_DESCRIPTOR_SET_BIT isn't included, can't free individual descriptors allocated from this pool
+		.maxSets = 1 * per_texture, // one set per texture
+		.poolSizeCount = uint32_t(pool_sizes.size()),
+		.pPoolSizes = pool_sizes.data()};
+
+	VK(vkCreateDescriptorPool(rtg.device, &desc_pool_create_info, nullptr, &texture_descriptor_pool));
+
+	// allocate and write the texture descriptor sets ============================================
+
+	// allocate descriptor sets (different sets are using the same alloc_info) -------------------
+	VkDescriptorSetAllocateInfo desc_set_alloc_info{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = texture_descriptor_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &objects_pipeline.set2_TEXTURE};
+	texture_descriptors.assign(textures.size(), VK_NULL_HANDLE);
+
+	for (VkDescriptorSet &descriptor_set : texture_descriptors)
+	{
+		VK(vkAllocateDescriptorSets(rtg.device, &desc_set_alloc_info, &descriptor_set));
+	}
+
+	// write descriptors for textures -----------------------------------------------------------
+	std::vector<VkDescriptorImageInfo> infos(textures.size());
+	std::vector<VkWriteDescriptorSet> writes(textures.size());
+
+	for (Helpers::AllocatedImage const &image : textures)
+	{
+		size_t i = &image - &textures[0];
+
+		infos[i] = VkDescriptorImageInfo{
+			.sampler = texture_sampler,
+			.imageView = texture_views[i],
+			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		};
+		writes[i] = VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = texture_descriptors[i],
+			.dstBinding = 0,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo = &infos[i],
+		};
+	}
+
+	vkUpdateDescriptorSets(rtg.device, uint32_t(writes.size()), writes.data(), 0, nullptr);
+}
+
+VkImageView Wanderer::create_texture_view(Helpers::AllocatedImage const &image)
+{
+	VkImageViewCreateInfo image_view_create_info{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+		.flags = 0,
+		.image = image.handle,
+		.viewType = VK_IMAGE_VIEW_TYPE_2D,
+		.format = image.format,
+
+		.subresourceRange{
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.baseMipLevel = 0,
+			.levelCount = 1,
+			.baseArrayLayer = 0,
+			.layerCount = 1},
+	};
+
+	VkImageView image_view = VK_NULL_HANDLE;
+	VK(vkCreateImageView(rtg.device, &image_view_create_info, nullptr, &image_view));
+	return image_view;
+}
+
+void Wanderer::texture_moved(uint32_t texture)
+{
+	vkDestroyImageView(rtg.device, texture_views[texture], nullptr);
+	texture_views[texture] = create_texture_view(textures[texture]);
+
+	VkDescriptorImageInfo info{
+		.sampler = texture_sampler,
+		.imageView = texture_views[texture],
+		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	};
+	VkWriteDescriptorSet write{
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstBinding = 0,
+		.dstArrayElement = 0,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.pImageInfo = &info,
+	};
+
+	std::vector<VkWriteDescriptorSet> writes;
+	if (texture < texture_descriptors.size())
+	{
+		write.dstSet = texture_descriptors[texture];
+		writes.emplace_back(write);
+	}
+	if (bindless_descriptors != VK_NULL_HANDLE)
+	{
+		write.dstSet = bindless_descriptors;
+		write.dstBinding = 1;
+		write.dstArrayElement = texture;
+		writes.emplace_back(write);
+	}
+	if (texture_array_descriptors != VK_NULL_HANDLE)
+	{ // (slots past the last texture repeat texture 0)
+		write.dstSet = texture_array_descriptors;
+		write.dstBinding = 0;
+		for (uint32_t slot = 0; slot < ObjectsPipeline::MaxTextures; ++slot)
+		{
+			if ((slot < textures.size() ? slot : 0) != texture)
+				continue;
+			write.dstArrayElement = slot;
+			writes.emplace_back(write);
+		}
+	}
+	vkUpdateDescriptorSets(rtg.device, uint32_t(writes.size()), writes.data(), 0, nullptr);
+
+	invalidate_cached_commands();
+}
+
+void Wanderer::material_buffer_moved()
+{
+	VkDescriptorBufferInfo info{
+		.buffer = material_buffer.handle,
+		.offset = 0,
+		.range = material_buffer.size};
+	VkWriteDescriptorSet write{
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = bindless_descriptors,
+		.dstBinding = 0,
+		.dstArrayElement = 0,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.pBufferInfo = &info,
+	};
+	vkUpdateDescriptorSets(rtg.device, 1, &write, 0, nullptr);
+
+	invalidate_cached_commands();
+}
+
+void Wanderer::create_bindless_descriptor()
+{
+	assert(!texture_views.empty() && texture_views.size() <= ObjectsPipeline::MaxTextures);
+
+	// upload the materials ======================================================================
 
-	// create the texture descriptor pool =======================================================
+	std::vector<ObjectsPipeline::Material> materials(textures.size());
+	for (uint32_t i = 0; i < uint32_t(materials.size()); ++i)
+	{
+		materials[i].TEXTURE = i;
+	}
 
-	uint32_t per_texture = uint32_t(textures.size()); // for easier-to-read counting
+	size_t bytes = materials.size() * sizeof(materials[0]);
+	material_buffer = rtg.helpers.create_buffer(
+		bytes,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, // read by the fragment shader, and a target (and, when moved, source) of a memory copy
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		Helpers::Unmapped);
+	rtg.helpers.transfer_to_buffer(materials.data(), bytes, material_buffer);
 
-	std::array<VkDescriptorPoolSize, 1> pool_sizes{
+	// create the bindless descriptor pool =======================================================
+
+	std::array<VkDescriptorPoolSize, 2> pool_sizes{
+		VkDescriptorPoolSize{
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+		},
 		VkDescriptorPoolSize{
 			.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-			.descriptorCount = 1 * 1 * per_texture, // 1 descriptor per set, 1 set per texture
+			.descriptorCount = ObjectsPipeline::MaxTextures,
 		}};
 
 	VkDescriptorPoolCreateInfo desc_pool_create_info{
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-		.flags = 0,					// because CREATE_FREE_DESCRIPTOR_SET_BIT isn't included, can't free individual descriptors allocated from this pool
-		.maxSets = 1 * per_texture, // one set per texture
+		.flags = 0,
+		.maxSets = 1,
 		.poolSizeCount = uint32_t(pool_sizes.size()),
 		.pPoolSizes = pool_sizes.data()};
 
-	VK(vkCreateDescriptorPool(rtg.device, &desc_pool_create_info, nullptr, &texture_descriptor_pool));
+	VK(vkCreateDescriptorPool(rtg.device, &desc_pool_create_info, nullptr, &bindless_descriptor_pool));
 
-	// allocate and write the texture descriptor sets ============================================
+	// allocate and write the bindless descriptor set ============================================
 
-	// allocate descriptor sets (different sets are using the same alloc_info) -------------------
 	VkDescriptorSetAllocateInfo desc_set_alloc_info{
 		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-		.descriptorPool = texture_descriptor_pool,
+		.descriptorPool = bindless_descriptor_pool,
 		.descriptorSetCount = 1,
-		.pSetLayouts = &objects_pipeline.set2_TEXTURE};
-	texture_descriptors.assign(textures.size(), VK_NULL_HANDLE);
+		.pSetLayouts = &objects_pipeline.set2_Bindless};
 
-	for (VkDescriptorSet &descriptor_set : texture_descriptors)
-	{
-		VK(vkAllocateDescriptorSets(rtg.device, &desc_set_alloc_info, &descriptor_set));
-	}
+	VK(vkAllocateDescriptorSets(rtg.device, &desc_set_alloc_info, &bindless_descriptors));
 
-	// write descriptors for textures -----------------------------------------------------------
-	std::vector<VkDescriptorImageInfo> infos(textures.size());
-	std::vector<VkWriteDescriptorSet> writes(textures.size());
+	VkDescriptorBufferInfo material_info{
+		.buffer = material_buffer.handle,
+		.offset = 0,
+		.range = material_buffer.size};
 
-	for (Helpers::AllocatedImage const &image : textures)
+	std::vector<VkDescriptorImageInfo> texture_infos(texture_views.size());
+	for (size_t i = 0; i < texture_views.size(); ++i)
 	{
-		size_t i = &image - &textures[0];
-
-		infos[i] = VkDescriptorImageInfo{
+		texture_infos[i] = VkDescriptorImageInfo{
 			.sampler = texture_sampler,
 			.imageView = texture_views[i],
 			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 		};
-		writes[i] = VkWriteDescriptorSet{
+	}
+
+	std::array<VkWriteDescriptorSet, 2> writes{
+		VkWriteDescriptorSet{
 			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-			.dstSet = texture_descriptors[i],
+			.dstSet = bindless_descriptors,
 			.dstBinding = 0,
 			.dstArrayElement = 0,
 			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &material_info,
+		},
+		VkWriteDescriptorSet{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = bindless_descriptors,
+			.dstBinding = 1,
+			.dstArrayElement = 0,
+			.descriptorCount = uint32_t(texture_infos.size()), // the rest of the array stays unwritten (partially bound)
 			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-			.pImageInfo = &infos[i],
+			.pImageInfo = texture_infos.data(),
+		},
+	};
+
+	vkUpdateDescriptorSets(rtg.device, uint32_t(writes.size()), writes.data(), 0, nullptr);
+}
+
+void Wanderer::create_texture_array_descriptor()
+{
+	assert(!texture_views.empty() && texture_views.size() <= ObjectsPipeline::MaxTextures);
+
+	// create the texture array descriptor pool ==================================================
+
+	VkDescriptorPoolSize pool_size{
+		.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = ObjectsPipeline::MaxTextures,
+	};
+
+	VkDescriptorPoolCreateInfo desc_pool_create_info{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.flags = 0,
+		.maxSets = 1,
+		.poolSizeCount = 1,
+		.pPoolSizes = &pool_size};
+
+	VK(vkCreateDescriptorPool(rtg.device, &desc_pool_create_info, nullptr, &texture_array_descriptor_pool));
+
+	// allocate and write the texture array descriptor set =======================================
+
+	VkDescriptorSetAllocateInfo desc_set_alloc_info{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = texture_array_descriptor_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &objects_pipeline.set2_Textures};
+
+	VK(vkAllocateDescriptorSets(rtg.device, &desc_set_alloc_info, &texture_array_descriptors));
+
+	// (without partially bound descriptors every slot must be valid, so the unused ones repeat texture 0)
+	std::vector<VkDescriptorImageInfo> texture_infos(ObjectsPipeline::MaxTextures);
+	for (size_t i = 0; i < texture_infos.size(); ++i)
+	{
+		texture_infos[i] = VkDescriptorImageInfo{
+			.sampler = texture_sampler,
+			.imageView = texture_views[i < texture_views.size() ? i : 0],
+			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 		};
 	}
 
-	vkUpdateDescriptorSets(rtg.device, uint32_t(writes.size()), writes.data(), 0, nullptr);
+	VkWriteDescriptorSet write{
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = texture_array_descriptors,
+		.dstBinding = 0,
+		.dstArrayElement = 0,
+		.descriptorCount = uint32_t(texture_infos.size()),
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.pImageInfo = texture_infos.data(),
+	};
+
+	vkUpdateDescriptorSets(rtg.device, 1, &write, 0, nullptr);
 }
 
-void Wanderer::construct_scene_graph_vertices_with_culling(std::vector<ObjectInstance> &object_instances, SceneMgr &sceneMgr, const mat4 &CLIP_FROM_WORLD)
+void Wanderer::construct_scene_graph_vertices_with_culling(std::vector<ObjectInstance> &object_instances, ObjectsPipeline::Transform *transforms, SceneMgr &sceneMgr, const mat4 &CLIP_FROM_WORLD)
 {
 	typedef SceneMgr::NodeObject NodeObject;
 
 	if (sceneMgr.sceneObject == nullptr)
 		return;
 
+	uint32_t culling_mode = rtg.configuration.culling_mode;
+	bool temporal = culling_mode & RTG::Configuration::Culling_Mode::TEMPORAL; // frustum and contribution tests are left to apply_temporal_visibility_culling
+
+	Frustum camera_frustum;
+	if (culling_mode & RTG::Configuration::Culling_Mode::FRUSTUM)
+		camera_frustum = Frustum::createFrustumFromCamera(rtg.configuration.camera); // always use the main camera for culling
+
+	glm::mat4 culling_clip_from_world(1.0f);
+	VkViewport culling_viewport{};
+	uint32_t contribution_culled = 0;
+	if ((culling_mode & RTG::Configuration::Culling_Mode::CONTRIBUTION) && !temporal)
+	{
+		culling_clip_from_world = TypeHelper::convert_mat4_to_glm_mat4(calculate_culling_clip_from_world());
+		VkRect2D scissor{};
+		calculate_viewport_and_scissor(culling_viewport, scissor);
+	}
+
+	occlusion_candidates.clear();
+	temporal_candidates.clear();
+	uint32_t transform_count = 0;
+
 	std::queue<NodeObject *> nodeQueue;
 	for (std::string &nodeName : sceneMgr.sceneObject->rootName)
 	{
@@ -1924,10 +3572,20 @@ void Wanderer::construct_scene_graph_vertices_with_culling(std::vector<ObjectIns
 			SceneMgr::MeshObject *refMesh = nodeMeshIt->second;
 			
 
-			// frustum culling
-			if (rtg.configuration.culling_mode == RTG::Configuration::Culling_Mode::FRUSTUM)
+			// a cached bbox is still valid while the node keeps its transform
+			bool bounds_changed = true;
+			if (temporal)
+			{
+				auto findCacheResult = visibility_cache.find(node);
+				if (findCacheResult != visibility_cache.end() && findCacheResult->second.WORLD_FROM_LOCAL == WORLD_FROM_LOCAL_GLM)
+				{
+					node->bbox = findCacheResult->second.bbox;
+					bounds_changed = false;
+				}
+			}
+
+			if (culling_mode != RTG::Configuration::Culling_Mode::NONE && bounds_changed)
 			{
-				
 				// update node bbox 
 				node->bbox.reset();
 
@@ -1953,25 +3611,70 @@ void Wanderer::construct_scene_graph_vertices_with_culling(std::vector<ObjectIns
 				// 	glm::vec3 transformed_vertex_vec3 = glm::vec3(transformed_vertex_vec4.x, transformed_vertex_vec4.y, transformed_vertex_vec4.z);
 				// 	node->bbox.enclose(transformed_vertex_vec3);
 				// }
+			}
 
-				Frustum camera_frustum = Frustum::createFrustumFromCamera(rtg.configuration.camera); // always use the main camera for culling
-
+			// frustum culling
+			if ((culling_mode & RTG::Configuration::Culling_Mode::FRUSTUM) && !temporal)
+			{
 				if (!camera_frustum.isBBoxInFrustum(node->bbox)) {
 					// std::cout << "Culling node " << node->name << std::endl;
 					continue;
 				}
 			}
 
+			// contribution culling (objects too small on screen to be worth a draw)
+			if ((culling_mode & RTG::Configuration::Culling_Mode::CONTRIBUTION) && !temporal)
+			{
+				if (calculate_screen_size(node->bbox, culling_clip_from_world, culling_viewport) < rtg.configuration.contribution_threshold)
+				{
+					++contribution_culled;
+					continue;
+				}
+			}
+
+			// temporal visibility culling happens after the traversal, so its test budget can go to the riskiest nodes first
+			if (temporal)
+			{
+				temporal_candidates.emplace_back(TemporalCandidate{
+					.node = node,
+					.WORLD_FROM_LOCAL = WORLD_FROM_LOCAL_GLM,
+					.bounds_changed = bounds_changed,
+				});
+			}
+
+			// occlusion culling happens after the traversal, once every frustum survivor (and so every occluder) is known
+			if (culling_mode & RTG::Configuration::Culling_Mode::OCCLUSION)
+			{
+				occlusion_candidates.emplace_back(OcclusionCandidate{
+					.mesh = refMesh,
+					.WORLD_FROM_LOCAL = WORLD_FROM_LOCAL_GLM,
+				});
+			}
+
+			// (written once, straight into GPU-visible memory; later culling only drops the draw record)
+			assert(transform_count < scene_instance_count);
+			mat4 CLIP_FROM_LOCAL = CLIP_FROM_WORLD * WORLD_FROM_LOCAL;
+			transforms[transform_count] = ObjectsPipeline::Transform{
+				.CLIP_FROM_LOCAL = CLIP_FROM_LOCAL,
+				.WORLD_FROM_LOCAL = WORLD_FROM_LOCAL,
+				.WORLD_FROM_LOCAL_NORMAL = WORLD_FROM_LOCAL_NORMAL
+				// NOTE: the upper left 3x3 of WORLD_FROM_LOCAL_NORMAL should be the inverse transpose of the upper left 3x3
+			};
+
+			uint32_t texture = 0;
+			// (the clip w of the local origin is its view depth)
+			transform_draw_keys[transform_count] = draw_key(0, texture, findVertexIdxResult->second, CLIP_FROM_LOCAL[3 * 4 + 3]);
+			transform_meshes[transform_count] = findVertexIdxResult->second;
+
 			object_instances.emplace_back(ObjectInstance{
 				.vertices = scene_nodes_vertices[findVertexIdxResult->second],
-				.transform{
-					.CLIP_FROM_LOCAL = CLIP_FROM_WORLD * WORLD_FROM_LOCAL,
-					.WORLD_FROM_LOCAL = WORLD_FROM_LOCAL,
-					.WORLD_FROM_LOCAL_NORMAL = WORLD_FROM_LOCAL_NORMAL
-					// NOTE: the upper left 3x3 of WORLD_FROM_LOCAL_NORMAL should be the inverse transpose of the upper left 3x3
-				},
-				.texture = 0,
+				.transform = transform_count,
+				.texture = texture,
 			});
+			++transform_count;
+
+			if (culling_mode != RTG::Configuration::Culling_Mode::NONE)
+				object_bboxes.emplace_back(node->bbox);
 		}
 		// else
 		// {
@@ -1991,6 +3694,467 @@ void Wanderer::construct_scene_graph_vertices_with_culling(std::vector<ObjectIns
 			nodeQueue.push(findNodeResult->second);
 		}
 	}
+
+	if (temporal)
+		contribution_culled = apply_temporal_visibility_culling(object_instances);
+
+	if ((culling_mode & RTG::Configuration::Culling_Mode::CONTRIBUTION) && contribution_culled != contribution_culled_count)
+	{
+		contribution_culled_count = contribution_culled;
+		std::cout << "[Wanderer] (Contribution Culling) " << contribution_culled_count << " instances smaller than "
+				  << rtg.configuration.contribution_threshold << " pixels culled." << std::endl;
+	}
+
+	if (culling_mode & RTG::Configuration::Culling_Mode::OCCLUSION)
+		apply_occlusion_culling(object_instances);
+}
+
+void Wanderer::apply_occlusion_culling(std::vector<ObjectInstance> &object_instances)
+{
+	assert(occlusion_candidates.size() == object_instances.size());
+	assert(object_bboxes.size() == object_instances.size());
+
+	occlusion_culler.begin_frame(TypeHelper::convert_mat4_to_glm_mat4(calculate_culling_clip_from_world()));
+
+	// pick occluders: the largest boxes on screen first, until the triangle budget is spent
+	std::vector<std::pair<float, uint32_t>> occluders; // (screen coverage, candidate index)
+	for (uint32_t i = 0; i < occlusion_candidates.size(); ++i)
+	{
+		SceneMgr::MeshObject *mesh = occlusion_candidates[i].mesh;
+		if (mesh->topology != VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST || mesh->positionList.empty())
+			continue;
+
+		float coverage = occlusion_culler.screen_coverage(object_bboxes[i]);
+		if (coverage >= occluder_min_coverage)
+			occluders.emplace_back(coverage, i);
+	}
+	std::sort(occluders.begin(), occluders.end(), [](auto const &a, auto const &b) { return a.first > b.first; });
+
+	std::vector<bool> is_occluder(occlusion_candidates.size(), false);
+	uint32_t occluder_triangles = 0;
+	for (auto const &[coverage, i] : occluders)
+	{
+		OcclusionCandidate const &candidate = occlusion_candidates[i];
+		uint32_t triangles = uint32_t(candidate.mesh->positionList.size() / 3);
+		if (occluder_triangles + triangles > occluder_triangle_budget)
+			continue;
+
+		occlusion_culler.add_occluder(candidate.mesh->positionList, candidate.WORLD_FROM_LOCAL);
+		occluder_triangles += triangles;
+		is_occluder[i] = true;
+	}
+
+	occlusion_culler.rasterize_occluders(worker_pool);
+
+	// test everything else against the occluders and compact the survivors in place
+	size_t kept = 0;
+	for (size_t i = 0; i < object_instances.size(); ++i)
+	{
+		if (!is_occluder[i] && !occlusion_culler.is_bbox_visible(object_bboxes[i]))
+			continue;
+
+		if (kept != i)
+		{
+			object_instances[kept] = object_instances[i];
+			object_bboxes[kept] = object_bboxes[i];
+			occlusion_candidates[kept] = occlusion_candidates[i];
+		}
+		++kept;
+	}
+	object_instances.resize(kept);
+	object_bboxes.resize(kept);
+	occlusion_candidates.resize(kept);
+
+	if (occlusion_culler.stats.culled != occlusion_culled_count)
+	{
+		occlusion_culled_count = occlusion_culler.stats.culled;
+		std::cout << "[Wanderer] (Occlusion Culling) " << occlusion_culled_count << " of " << occlusion_culler.stats.tested << " tested instances culled by "
+				  << occlusion_culler.stats.occluders << " occluders (" << occlusion_culler.stats.triangles << " triangles)." << std::endl;
+	}
+}
+
+uint32_t Wanderer::apply_temporal_visibility_culling(std::vector<ObjectInstance> &object_instances)
+{
+	assert(temporal_candidates.size() == object_instances.size());
+	assert(object_bboxes.size() == object_instances.size());
+
+	uint32_t culling_mode = rtg.configuration.culling_mode;
+	bool frustum = culling_mode & RTG::Configuration::Culling_Mode::FRUSTUM;
+	bool contribution = culling_mode & RTG::Configuration::Culling_Mode::CONTRIBUTION;
+	Camera &camera = rtg.configuration.camera; // always use the main camera for culling
+	++temporal_frame;
+
+	Frustum camera_frustum = Frustum::createFrustumFromCamera(camera);
+	glm::mat4 culling_clip_from_world = TypeHelper::convert_mat4_to_glm_mat4(calculate_culling_clip_from_world());
+	VkViewport culling_viewport{};
+	VkRect2D scissor{};
+	calculate_viewport_and_scissor(culling_viewport, scissor);
+
+	{ // cached results only hold for the projection (and screen size) they were tested with:
+		Camera::Camera_Attributes const &attributes = camera.camera_attributes;
+		if (attributes.aspect != visibility_cache_attributes.aspect || attributes.vfov != visibility_cache_attributes.vfov ||
+			attributes.near != visibility_cache_attributes.near || attributes.far != visibility_cache_attributes.far ||
+			culling_viewport.width != visibility_cache_viewport[0] || culling_viewport.height != visibility_cache_viewport[1])
+		{
+			if (!visibility_cache.empty())
+				std::cout << "[Wanderer] (Temporal Culling) projection changed; dropping " << visibility_cache.size() << " cached results." << std::endl;
+			visibility_cache.clear();
+			visibility_cache_attributes = attributes;
+			visibility_cache_viewport[0] = culling_viewport.width;
+			visibility_cache_viewport[1] = culling_viewport.height;
+		}
+	}
+
+	// each frustum plane's distance to a point p is +-dot(p - position, axis) + constant, so since the test it changed by
+	//  at most |position - tested position| + |p - tested position| * |axis - tested axis|:
+	auto plane_drift = [&](VisibilityCacheEntry const &entry)
+	{
+		float moved = glm::length(camera.position - entry.camera_position);
+		float turned = std::max({glm::length(camera.front - entry.camera_front),
+								 glm::length(camera.right - entry.camera_right),
+								 glm::length(camera.up - entry.camera_up)});
+		return moved + entry.radius * turned;
+	};
+
+	auto test = [&](uint32_t i, VisibilityCacheEntry &entry)
+	{
+		BBox &bbox = object_bboxes[i];
+
+		entry.WORLD_FROM_LOCAL = temporal_candidates[i].WORLD_FROM_LOCAL;
+		entry.bbox = bbox;
+		entry.visible = !frustum || camera_frustum.isBBoxInFrustum(bbox);
+		entry.contribution_culled = entry.visible && contribution && calculate_screen_size(bbox, culling_clip_from_world, culling_viewport) < rtg.configuration.contribution_threshold;
+		entry.visible = entry.visible && !entry.contribution_culled;
+		entry.margin = frustum ? camera_frustum.distanceToBoundary(bbox) : std::numeric_limits<float>::infinity();
+		entry.radius = 0.0f;
+		for (glm::vec3 const &corner : bbox.get_corners())
+			entry.radius = std::max(entry.radius, glm::length(corner - camera.position));
+		entry.camera_position = camera.position;
+		entry.camera_front = camera.front;
+		entry.camera_right = camera.right;
+		entry.camera_up = camera.up;
+		entry.tested_frame = temporal_frame;
+	};
+
+	// sort out which cached results may be out of date; riskiest first: a wrongly culled node pops in late,
+	//  a wrongly kept one only costs a draw, and a node that can only have changed size is refreshed last
+	enum Priority : uint32_t
+	{
+		StaleCulled = 0,
+		StaleVisible = 1,
+		Refresh = 2,
+	};
+	std::vector<std::tuple<uint32_t, uint32_t, uint32_t>> stale; // (priority, tested frame (oldest first), index)
+	uint32_t tested = 0;
+	for (uint32_t i = 0; i < uint32_t(object_instances.size()); ++i)
+	{
+		auto [it, inserted] = visibility_cache.try_emplace(temporal_candidates[i].node);
+		VisibilityCacheEntry &entry = it->second;
+		if (inserted)
+		{
+			test(i, entry); // nothing to reuse
+			++tested;
+			continue;
+		}
+
+		float drift = plane_drift(entry);
+		if (temporal_candidates[i].bounds_changed || drift >= entry.margin || (entry.contribution_culled && drift > 0.0f))
+			stale.emplace_back(entry.visible ? StaleVisible : StaleCulled, entry.tested_frame, i);
+		else if (contribution && drift > 0.0f)
+			stale.emplace_back(Refresh, entry.tested_frame, i);
+	}
+
+	// spend the budget; whatever is left keeps its cached result and gets an earlier turn next frame:
+	size_t budget = std::min(stale.size(), size_t(temporal_test_budget));
+	std::partial_sort(stale.begin(), stale.begin() + budget, stale.end());
+	for (size_t s = 0; s < budget; ++s)
+	{
+		uint32_t i = std::get<2>(stale[s]);
+		test(i, visibility_cache.at(temporal_candidates[i].node));
+		++tested;
+	}
+
+	// compact the visible instances in place (keeping the parallel candidate lists in step)
+	size_t node_count = object_instances.size();
+	bool occlusion = culling_mode & RTG::Configuration::Culling_Mode::OCCLUSION;
+	uint32_t contribution_culled = 0;
+	size_t kept = 0;
+	for (size_t i = 0; i < object_instances.size(); ++i)
+	{
+		VisibilityCacheEntry const &entry = visibility_cache.at(temporal_candidates[i].node);
+		if (!entry.visible)
+		{
+			if (entry.contribution_culled)
+				++contribution_culled;
+			continue;
+		}
+
+		if (kept != i)
+		{
+			object_instances[kept] = object_instances[i];
+			object_bboxes[kept] = object_bboxes[i];
+			temporal_candidates[kept] = temporal_candidates[i];
+			if (occlusion)
+				occlusion_candidates[kept] = occlusion_candidates[i];
+		}
+		++kept;
+	}
+	object_instances.resize(kept);
+	object_bboxes.resize(kept);
+	temporal_candidates.resize(kept);
+	if (occlusion)
+		occlusion_candidates.resize(kept);
+
+	// (only logged when the budget starts or stops running out)
+	TemporalStats stats{
+		.tested = tested,
+		.deferred = uint32_t(stale.size() - budget),
+	};
+	if ((stats.deferred > 0) != (temporal_stats.deferred > 0))
+	{
+		std::cout << "[Wanderer] (Temporal Culling) " << stats.tested << " of " << node_count << " nodes re-tested, "
+				  << stats.deferred << " deferred to later frames." << std::endl;
+	}
+	temporal_stats = stats;
+
+	return contribution_culled;
+}
+
+void Wanderer::build_draw_groups(ObjectsPipeline::Instance *instances)
+{
+	draw_groups.clear();
+
+	auto instance_of = [](ObjectInstance const &inst)
+	{
+		return ObjectsPipeline::Instance{
+			.TRANSFORM = inst.transform,
+			.MATERIAL = inst.texture, // (one material per texture)
+		};
+	};
+
+	if (rtg.configuration.culling_mode & RTG::Configuration::Culling_Mode::GPU_FRUSTUM)
+	{
+		// the cull pipeline emits one draw per instance, with its index in object_instances as firstInstance:
+		for (uint32_t i = 0; i < uint32_t(object_instances.size()); ++i)
+			instances[i] = instance_of(object_instances[i]);
+		return;
+	}
+
+	// consecutive instances of the same mesh and texture share a draw
+	//  (bindless, the texture comes from the instance's material, so only the mesh matters):
+	bool bindless = rtg.configuration.bindless;
+	auto texture_of = [bindless](ObjectInstance const &inst) -> uint32_t
+	{
+		return bindless ? 0 : inst.texture;
+	};
+	auto same_draw = [&](ObjectInstance const &a, ObjectInstance const &b)
+	{
+		return texture_of(a) == texture_of(b) && a.vertices.first == b.vertices.first && a.vertices.count == b.vertices.count;
+	};
+
+	// state changes of recording the draws in a given order (only one pipeline draws objects for now):
+	auto count_state_changes = [&](auto &&instance_at, uint32_t *changes)
+	{
+		changes[0] = object_instances.empty() ? 0 : 1; // pipeline binds
+		changes[1] = bindless ? changes[0] : 0;		   // texture binds
+		changes[2] = 0;								   // draws
+		for (uint32_t n = 0; n < uint32_t(object_instances.size()); ++n)
+		{
+			ObjectInstance const &inst = instance_at(n);
+			if (n > 0 && same_draw(instance_at(n - 1), inst))
+				continue;
+			++changes[2];
+			if (!bindless && (n == 0 || texture_of(instance_at(n - 1)) != texture_of(inst)))
+				++changes[1];
+		}
+	};
+
+	std::array<uint32_t, 6> state_changes;
+	count_state_changes([&](uint32_t n) -> ObjectInstance const & { return object_instances[n]; }, &state_changes[0]);
+
+	// sort the draws by key (see draw_key):
+	draw_keys.resize(object_instances.size());
+	draw_order.resize(object_instances.size());
+	for (uint32_t i = 0; i < uint32_t(object_instances.size()); ++i)
+	{
+		draw_keys[i] = transform_draw_keys[object_instances[i].transform];
+		draw_order[i] = i;
+	}
+	RadixSort::sort(draw_keys, draw_order, draw_keys_scratch, draw_order_scratch);
+
+	for (uint32_t n = 0; n < uint32_t(draw_order.size()); ++n)
+	{
+		ObjectInstance const &inst = object_instances[draw_order[n]];
+		instances[n] = instance_of(inst);
+
+		if (!draw_groups.empty() && same_draw(object_instances[draw_order[n - 1]], inst))
+		{
+			++draw_groups.back().instance_count;
+			continue;
+		}
+		draw_groups.emplace_back(DrawGroup{
+			.vertices = inst.vertices,
+			.texture = texture_of(inst),
+			.first_instance = n,
+			.instance_count = 1,
+		});
+	}
+
+	count_state_changes([&](uint32_t n) -> ObjectInstance const & { return object_instances[draw_order[n]]; }, &state_changes[3]);
+	if (state_changes != draw_sort_state_changes)
+	{
+		draw_sort_state_changes = state_changes;
+		std::cout << "[Wanderer] (Draw Sort) state changes, scene order -> " << (rtg.configuration.front_to_back ? "front-to-back" : "sorted by state") << ": "
+				  << state_changes[0] << " -> " << state_changes[3] << " pipeline binds, "
+				  << state_changes[1] << " -> " << state_changes[4] << " texture binds, "
+				  << state_changes[2] << " -> " << state_changes[5] << " draws." << std::endl;
+	}
+
+	if (draw_groups.size() != instancing_draw_count)
+	{
+		instancing_draw_count = uint32_t(draw_groups.size());
+		std::cout << "[Wanderer] (Instancing) " << object_instances.size() << " instances drawn with " << instancing_draw_count << " draws." << std::endl;
+	}
+}
+
+uint64_t Wanderer::draw_key(uint32_t pipeline, uint32_t texture, uint32_t mesh, float depth) const
+{
+	assert(pipeline < (1u << 4) && texture < (1u << 12) && mesh < (1u << 24));
+
+	// positive floats order like their bits, so the top 24 bits (past the sign) are a depth quantized relative to its magnitude:
+	uint32_t depth_bits = 0;
+	if (depth > 0.0f)
+	{
+		std::memcpy(&depth_bits, &depth, sizeof(depth_bits));
+		depth_bits = std::min(depth_bits >> 7, (1u << 24) - 1);
+	}
+
+	// bindless draws don't bind textures, so the texture shouldn't separate them:
+	if (rtg.configuration.bindless)
+		texture = 0;
+
+	if (rtg.configuration.front_to_back)
+		return (uint64_t(pipeline) << 60) | (uint64_t(depth_bits) << 36) | (uint64_t(texture) << 24) | uint64_t(mesh);
+	else
+		return (uint64_t(pipeline) << 60) | (uint64_t(texture) << 48) | (uint64_t(mesh) << 24) | uint64_t(depth_bits);
+}
+
+void Wanderer::calculate_frustum_planes(mat4 const &CLIP_FROM_WORLD, float (&planes)[6][4])
+{
+	/* Gribb & Hartmann: each clip-space bound (-w <= x <= w, ...) is a plane made of rows of CLIP_FROM_WORLD */
+	auto row = [&](uint32_t r, uint32_t c) { return CLIP_FROM_WORLD[c * 4 + r]; }; // mat4 is column-major
+
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		planes[0][c] = row(3, c) + row(0, c); // left
+		planes[1][c] = row(3, c) - row(0, c); // right
+		planes[2][c] = row(3, c) + row(1, c); // bottom
+		planes[3][c] = row(3, c) - row(1, c); // top
+		planes[4][c] = row(3, c) + row(2, c); // near (-w <= z; loose but safe for 0 <= z projections too)
+		planes[5][c] = row(3, c) - row(2, c); // far
+	}
+}
+
+void Wanderer::report_gpu_culling_stats(Workspace &workspace)
+{
+	assert(workspace.CullStats.allocation.mapped);
+	uint32_t const *stats = reinterpret_cast<uint32_t const *>(workspace.CullStats.allocation.data());
+	workspace.CullStats_pending = false;
+
+	if (std::equal(gpu_culling_stats.begin(), gpu_culling_stats.end(), stats))
+		return;
+	std::copy(stats, stats + gpu_culling_stats.size(), gpu_culling_stats.begin());
+
+	std::cout << "[Wanderer] (GPU Culling) " << object_instances.size() << " instances: "
+			  << gpu_culling_stats[CullPipeline::FrustumCulled] << " frustum culled, "
+			  << gpu_culling_stats[CullPipeline::OcclusionCulled] << " occluded, "
+			  << gpu_culling_stats[CullPipeline::LateDrawn] << " drawn late (disoccluded)." << std::endl;
+}
+
+void Wanderer::calculate_viewport_and_scissor(VkViewport &viewport, VkRect2D &scissor)
+{
+	// correct the window height and width
+	float swapchain_aspect = rtg.swapchain_extent.width / rtg.swapchain_extent.height;
+	float &camera_aspect = rtg.configuration.camera.camera_attributes.aspect;
+
+	float new_height = rtg.swapchain_extent.height;
+	float new_width = rtg.swapchain_extent.width;
+	float offset_x = 0.f;
+	float offset_y = 0.f;
+
+	if (camera_aspect > swapchain_aspect) // letterbox
+	{
+		new_width = rtg.swapchain_extent.height * camera_aspect;
+		offset_x = (float(rtg.swapchain_extent.width) - new_width) / 2.f;
+	}
+	else  // pillarbox
+	{
+		new_height = rtg.swapchain_extent.width / camera_aspect;
+		offset_y = (float(rtg.swapchain_extent.height) - new_height) / 2.f;
+	}
+
+	// scissor rectangle
+	scissor = VkRect2D{
+		.offset = {.x = 0, .y = 0},
+		.extent = {.width = static_cast<uint32_t>(new_width), .height = static_cast<uint32_t>(new_height)}
+	};
+
+	// viewport transform
+	viewport = VkViewport{
+		.x = offset_x,
+		.y = offset_y,
+		.width = new_width,
+		.height = new_height,
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f,
+	};
+}
+
+mat4 Wanderer::calculate_culling_clip_from_world()
+{
+	Camera &camera = rtg.configuration.camera;
+
+	if (camera.current_camera_mode != Camera::Camera_Mode::DEBUG)
+		return CLIP_FROM_WORLD;
+
+	// in DEBUG mode CLIP_FROM_WORLD belongs to the debug camera, but culling is done for the main camera:
+	glm::vec3 target_direction = camera.position + camera.front;
+	return perspective(
+			   camera.camera_attributes.vfov,
+			   camera.camera_attributes.aspect,
+			   camera.camera_attributes.near,
+			   camera.camera_attributes.far) *
+		   look_at(
+			   camera.position[0], camera.position[1], camera.position[2],
+			   target_direction[0], target_direction[1], target_direction[2],
+			   camera.up[0], camera.up[1], camera.up[2]);
+}
+
+float Wanderer::calculate_screen_size(BBox const &world_bbox, glm::mat4 const &clip_from_world, VkViewport const &viewport)
+{
+	// screen rectangle of the projected corners (a box crossing the camera plane may cover anything, so it is never small):
+	glm::vec2 ndc_min(std::numeric_limits<float>::max());
+	glm::vec2 ndc_max(std::numeric_limits<float>::lowest());
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		glm::vec4 corner(
+			(i & 4) ? world_bbox.max.x : world_bbox.min.x,
+			(i & 2) ? world_bbox.max.y : world_bbox.min.y,
+			(i & 1) ? world_bbox.max.z : world_bbox.min.z,
+			1.0f);
+		glm::vec4 clip = clip_from_world * corner;
+		if (clip.w <= OcclusionCuller::NearW)
+			return std::numeric_limits<float>::infinity();
+
+		glm::vec2 ndc = glm::vec2(clip) / clip.w;
+		ndc_min = glm::min(ndc_min, ndc);
+		ndc_max = glm::max(ndc_max, ndc);
+	}
+
+	// ndc spans 2 units across the viewport:
+	float width = (ndc_max.x - ndc_min.x) * 0.5f * std::abs(viewport.width);
+	float height = (ndc_max.y - ndc_min.y) * 0.5f * std::abs(viewport.height);
+	return std::max(width, height);
 }
 
 mat4 Wanderer::calculate_normal_matrix(const glm::mat4 &worldFromLocal)
@@ -6,6 +6,11 @@
 #include "Source/DataType/Mat4.hpp"
 #include "Source/DataType/Frustum.hpp"
 #include "Source/Tools/Timer.hpp"
+#include "Source/Tools/ThreadPool.hpp"
+#include "Source/Culling/OcclusionCuller.hpp"
+#include "Source/VkMemory/MeshPool.hpp"
+#include "Source/VkMemory/UploadRing.hpp"
+#include "Source/VkMemory/VersionedUniform.hpp"
 
 #include "Source/Configuration/RTG.hpp"
 
@@ -16,6 +21,8 @@
 #include <cstring>
 #include <iostream>
 #include <fstream>
+#include <future>
+#include <unordered_map>
 
 struct Wanderer : RTG::Application
 {
@@ -34,6 +41,9 @@ struct Wanderer : RTG::Application
 	VkFormat depth_format{};
 	// Render passes describe how pipelines write to images:
 	VkRenderPass render_pass = VK_NULL_HANDLE;
+	// two-phase occlusion culling splits the frame into an early pass (keeps color, leaves depth readable) and a late pass (loads both):
+	VkRenderPass render_pass_early = VK_NULL_HANDLE;
+	VkRenderPass render_pass_late = VK_NULL_HANDLE;
 
 	// Pipelines:
 
@@ -88,6 +98,10 @@ struct Wanderer : RTG::Application
 		VkDescriptorSetLayout set0_World = VK_NULL_HANDLE;
 		VkDescriptorSetLayout set1_Transforms = VK_NULL_HANDLE;
 		VkDescriptorSetLayout set2_TEXTURE = VK_NULL_HANDLE;
+		VkDescriptorSetLayout set2_Textures = VK_NULL_HANDLE; // replaces set2_TEXTURE with `--push-constants`
+		VkDescriptorSetLayout set2_Bindless = VK_NULL_HANDLE; // replaces set2_TEXTURE with `--bindless`
+
+		static constexpr uint32_t MaxTextures = 128; // size of the texture arrays (also MAX_TEXTURES in objects.frag)
 
 		// types for descriptors:
 		//  using Camera = LinesPipeline::Camera;
@@ -121,7 +135,28 @@ struct Wanderer : RTG::Application
 		};
 		static_assert(sizeof(Transform) == (16 * 4) * 3, "Transform is the expected size.");
 
-		// push constants (none)
+		// per-instance entry of the instance list (gl_InstanceIndex picks it):
+		struct Instance
+		{
+			uint32_t TRANSFORM; // index into the transforms
+			uint32_t MATERIAL;	// index into the materials (bindless only)
+		};
+		static_assert(sizeof(Instance) == 4 * 2, "Instance is the expected size.");
+
+		struct Material
+		{
+			uint32_t TEXTURE; // index into the bindless texture array
+		};
+		static_assert(sizeof(Material) == 4, "Material is the expected size.");
+
+		// push constants (with `--push-constants`; set per draw instead of binding the draw's texture):
+		struct Push
+		{
+			uint32_t MATERIAL; // (materials map 1:1 onto textures for now)
+			uint32_t TEXTURE;  // index into the set2_Textures array
+			uint32_t FLAGS;	   // (none defined yet)
+		};
+		static_assert(sizeof(Push) == 3 * 4, "Push is the expected size.");
 
 		VkPipelineLayout layout = VK_NULL_HANDLE;
 
@@ -133,6 +168,100 @@ struct Wanderer : RTG::Application
 		void destroy(RTG &);
 	} objects_pipeline;
 
+	struct CullPipeline
+	{
+		// descriptor set layouts:
+		VkDescriptorSetLayout set0_Cull = VK_NULL_HANDLE;
+		VkDescriptorSetLayout set1_HiZ = VK_NULL_HANDLE; // only used by the Hi-Z variant
+
+		// types for descriptors:
+		struct Instance
+		{
+			float BBOX_MIN[3]; // world space
+			uint32_t FIRST_VERTEX;
+			float BBOX_MAX[3];
+			uint32_t VERTEX_COUNT;
+			uint32_t BUCKET;	   // index of the draw count this instance is counted in (one per texture)
+			uint32_t COMMAND_BASE; // index of the first draw command of that bucket
+			uint32_t _pad[2] = {0, 0};
+		};
+		static_assert(sizeof(Instance) == 4 * 4 + 4 * 4 + 4 * 4, "Instance is the expected size.");
+
+		struct Params
+		{
+			float FRUSTUM_PLANES[6][4]; // world space, dot(xyz, p) + w >= 0 inside
+			struct
+			{
+				mat4 CLIP_FROM_WORLD; // matrix the pyramid's depth was rendered with
+				float VIEWPORT[4];	  // x, y, width, height of the viewport it was rendered with
+			} HIZ_VIEWS[2];			  // [0]: previous frame's pyramid (early phase), [1]: this frame's pyramid (late phase)
+			uint32_t HIZ_SIZE[2];	  // size of pyramid level 0
+			uint32_t DEPTH_SIZE[2];
+			uint32_t HIZ_LEVELS;
+			uint32_t HIZ_READY; // 0 until the pyramid holds a frame's depth
+			uint32_t padding_[2];
+		};
+		static_assert(sizeof(Params) == 6 * 4 * 4 + 2 * (16 * 4 + 4 * 4) + 4 * 4 + 4 * 4, "Params is the expected size.");
+
+		// push constants
+		struct Push
+		{
+			uint32_t INSTANCE_COUNT;
+			uint32_t BUCKET_COUNT;
+			uint32_t PHASE;
+		};
+		static_assert(sizeof(Push) == 3 * 4, "Push is the expected size.");
+
+		enum Phase : uint32_t
+		{
+			FrustumOnly = 0,
+			Early = 1, // tested against the previous frame's pyramid
+			Late = 2,  // early rejects, tested again against this frame's pyramid
+		};
+
+		// counters after the two regions of per-bucket draw counts:
+		enum Stat : uint32_t
+		{
+			FrustumCulled = 0,
+			OcclusionCulled = 1,
+			LateDrawn = 2,
+			StatCount = 3,
+		};
+
+		static constexpr uint32_t WorkgroupSize = 64; // local_size_x in cull.comp
+
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+
+		VkPipeline handle = VK_NULL_HANDLE;		// frustum culling only
+		VkPipeline hiz_handle = VK_NULL_HANDLE; // frustum + Hi-Z occlusion culling
+
+		void create(RTG &);
+		void destroy(RTG &);
+	} cull_pipeline;
+
+	struct HiZPipeline
+	{
+		// descriptor set layouts:
+		VkDescriptorSetLayout set0_Levels = VK_NULL_HANDLE; // source level (sampled) and destination level (storage)
+
+		// push constants
+		struct Push
+		{
+			int32_t SRC_SIZE[2];
+			int32_t DST_SIZE[2];
+		};
+		static_assert(sizeof(Push) == 4 * 4, "Push is the expected size.");
+
+		static constexpr uint32_t WorkgroupSize = 8; // local_size_x and local_size_y in hiz.comp
+
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+
+		VkPipeline handle = VK_NULL_HANDLE;
+
+		void create(RTG &);
+		void destroy(RTG &);
+	} hiz_pipeline;
+
 	// pools from which per-workspace things are allocated:
 	VkCommandPool command_pool = VK_NULL_HANDLE;
 	// STEPX: Add descriptor pool here.
@@ -143,48 +272,75 @@ struct Wanderer : RTG::Application
 	{
 		VkCommandBuffer command_buffer = VK_NULL_HANDLE; // from the command pool above; reset at the start of every render.
 
-		// locations for lines data (streamed to GPU per-frame):
-		Helpers::AllocatedBuffer lines_vertices_src; // host coherent; mapped to cpu memory
-		Helpers::AllocatedBuffer lines_vertices;	 // device-local
-
-		// locations for LinesPipeline::Camera data (streamed to GPU per-frame):
-		Helpers::AllocatedBuffer Camera_src; // host coherent; mapped to cpu memory
-		Helpers::AllocatedBuffer Camera;	 // device-local
-		VkDescriptorSet Camera_descriptors;	 // references Camera
-
-		// location for ObjectsPipeline::World data: (streamed to GPU per-frame)
-		Helpers::AllocatedBuffer World_src; // host coherent; mapped
-		Helpers::AllocatedBuffer World;		// device-local
-		VkDescriptorSet World_descriptors;	// references World
-
-		// locations for ObjectsPipeline::Transform data (streamed to GPU per-frame):
-		Helpers::AllocatedBuffer Transforms_src; // host coherent; mapped to cpu memory
-		Helpers::AllocatedBuffer Transforms;	 // device-local
-		VkDescriptorSet Transform_descriptors;	 // references Transfroms
+		// (with `--parallel-recording`) one per recording job: each job records its share of the objects' draws into a secondary
+		//  command buffer from its own pool (pools are externally synchronized, so jobs never share one):
+		struct Recorder
+		{
+			VkCommandPool command_pool = VK_NULL_HANDLE; // transient; reset as a whole before every recording
+			VkCommandBuffer command_buffer = VK_NULL_HANDLE; // secondary, executed inside the objects render pass
+		};
+		std::vector<Recorder> recorders;
+
+		// per-frame stream for lines vertices, ObjectsPipeline::Transform data and instance lists
+		//  (sub-allocated every frame; the descriptors below reference it and are bound with dynamic offsets):
+		UploadRing upload_ring;
+		VkDeviceSize Transforms_range = 0; // bytes reserved for transforms each frame (the Transform_descriptors binding 0 range)
+		VkDeviceSize Instances_range = 0;  // bytes reserved for the instance list each frame (the Transform_descriptors binding 1 range)
+
+		VkDescriptorSet Camera_descriptors;	   // references this workspace's copy of camera_uniform
+		VkDescriptorSet World_descriptors;	   // references this workspace's copy of world_uniform
+		VkDescriptorSet Transform_descriptors; // references upload_ring (Transforms_range and Instances_range at dynamic offsets)
+
+		// staging for this frame's streamed data (from rtg.helpers.staging; given back once the workspace is available again):
+		std::vector<StagingPool::Buffer> staging;
+
+		// locations for CullPipeline data (GPU-driven culling; streamed to GPU per-frame through staging):
+		Helpers::AllocatedBuffer CullInstances;		// device-local
+		Helpers::AllocatedBuffer DrawCommands;		// device-local; written by the cull pipeline, read as indirect draws
+		Helpers::AllocatedBuffer DrawCounts;		// device-local; one count per bucket and phase, then the stats; cleared every frame
+		Helpers::AllocatedBuffer Occluded;			// device-local; per-instance early phase result
+		Helpers::AllocatedBuffer CullParams;		// device-local
+		Helpers::AllocatedBuffer CullStats;			// host coherent; mapped; DrawCounts stats copied back at the end of the frame
+		bool CullStats_pending = false;				// CullStats holds results not reported yet
+		VkDescriptorSet Cull_descriptors;			// references CullInstances, DrawCommands, DrawCounts, CullParams, Occluded
 	};
 	std::vector<Workspace> workspaces;
 
 	//-------------------------------------------------------------------
 	// static scene resources:
 
-	Helpers::AllocatedBuffer object_vertices;
+	MeshPool mesh_pool; // vertices of every resident mesh
+	uint64_t mesh_pool_generation = 0; // mesh_pool.generation that scene_nodes_vertices and cached commands were made with
+	void sync_mesh_pool(); // after mesh_pool moved meshes (grew or compacted): refresh their vertices, record commands again
 
 	struct ObjectVertices
 	{
-		uint32_t first = 0; // index of first vertex in object_vertices
-		uint32_t count = 0; // number of vertices in object_vertices
+		uint32_t first = 0; // index of first vertex in mesh_pool
+		uint32_t count = 0; // number of vertices in mesh_pool
+		bool operator==(ObjectVertices const &) const = default;
 	};
 	ObjectVertices plane_vertices;
 	ObjectVertices torus_vertices;
 	ObjectVertices boat_vertices;
 	ObjectVertices sea_vertices;
-	std::vector<ObjectVertices> scene_nodes_vertices;
+	std::vector<ObjectVertices> scene_nodes_vertices; // per mesh; {0, 0} while the mesh isn't resident
+
 
+	static constexpr VkImageUsageFlags TextureUsage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // sampled, uploaded, moved by defragmentation
 	std::vector<Helpers::AllocatedImage> textures;			   // holds handles of actual image data
 	std::vector<VkImageView> texture_views;					   // references to portions of of whole textures
 	VkSampler texture_sampler = VK_NULL_HANDLE;				   // how to sample from textures (wrapping, interpolation, etc.)
 	VkDescriptorPool texture_descriptor_pool = VK_NULL_HANDLE; // pool from which texture descriptors are allocated
 	std::vector<VkDescriptorSet> texture_descriptors;		   // descriptor for each texture, allocated from texture_descriptor_pool
+
+	// bindless (`--bindless`): one set with every texture and the materials, bound once per pass:
+	Helpers::AllocatedBuffer material_buffer;				    // ObjectsPipeline::Material per material (material i uses texture i for now)
+	VkDescriptorPool bindless_descriptor_pool = VK_NULL_HANDLE; // pool from which bindless_descriptors is allocated
+	VkDescriptorSet bindless_descriptors = VK_NULL_HANDLE;	    // references material_buffer and texture_views
+
+	// push constants (`--push-constants`): one set with every texture, bound once per pass:
+	VkDescriptorPool texture_array_descriptor_pool = VK_NULL_HANDLE; // pool from which texture_array_descriptors is allocated
+	VkDescriptorSet texture_array_descriptors = VK_NULL_HANDLE;		 // references texture_views (slots past the last texture repeat texture 0)
 	//--------------------------------------------------------------------
 	// Resources that change when the swapchain is resized:
 
@@ -196,6 +352,20 @@ struct Wanderer : RTG::Application
 	// used from on_swapchain and the destructor: (framebuffers are created in on_swapchain)
 	void destroy_framebuffers();
 
+	// Hi-Z pyramid (`--culling gpu-occlusion`): farthest depth per texel, level 0 is half the depth buffer size
+	Helpers::AllocatedImage hiz_image;
+	uint32_t hiz_levels = 0;
+	VkImageView hiz_view = VK_NULL_HANDLE;			  // all levels, sampled by the cull pipeline
+	std::vector<VkImageView> hiz_level_views;		  // one per level, written (and read) by the Hi-Z pipeline
+	VkDescriptorPool hiz_descriptor_pool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> hiz_level_descriptors; // per level: previous level (or depth) -> this level
+	VkDescriptorSet hiz_cull_descriptors = VK_NULL_HANDLE; // CullPipeline::set1_HiZ
+	bool hiz_ready = false;		 // pyramid holds the depth of the last frame
+	mat4 hiz_CLIP_FROM_WORLD;	 // matrix that depth was rendered with
+	std::array<float, 4> hiz_viewport{}; // viewport that depth was rendered with
+	void create_hiz_resources(VkExtent2D const &extent);
+	void destroy_hiz_resources();
+
 	//--------------------------------------------------------------------
 	// Resources that change when time passes or the user interacts:
 
@@ -209,15 +379,175 @@ struct Wanderer : RTG::Application
 
 	std::vector<LinesPipeline::Vertex> lines_vertices;
 
-	ObjectsPipeline::World world;
+	// change-tracked uniforms: each workspace's copy is only re-written when the content changed since it last saw it
+	VersionedUniform<LinesPipeline::Camera> camera_uniform;
+	VersionedUniform<ObjectsPipeline::World> world_uniform; // from the scene's sun lights (see make_world)
 
+	// nodes instancing sun lights (sorted by name, so the same ones are picked every frame):
+	std::vector<std::string> sun_light_nodes;
+	ObjectsPipeline::World make_world(SceneMgr &sceneMgr) const;
+
+	// one draw of the frame; its Transform is written straight into the workspace's upload ring while traversing the scene
+	//  (culling compacts these records, the transforms stay where they were written):
 	struct ObjectInstance
 	{
 		ObjectVertices vertices;
-		ObjectsPipeline::Transform transform;
-		uint32_t texture = 0;
+		uint32_t transform = 0; // index into this frame's transforms
+		uint32_t texture = 0;	// texture (and, bindless, material) index
 	};
+	static_assert(sizeof(ObjectInstance) == 16, "ObjectInstance is a compact draw record.");
 	std::vector<ObjectInstance> object_instances;
+	std::vector<BBox> object_bboxes; // world space; parallel to object_instances, only filled when a culling mode is on
+
+	uint32_t scene_instance_count = 0; // mesh instances in the scene graph (the most transforms a frame can write)
+
+	// mesh residency (`--mesh-budget`): mesh_pool only holds the budget's worth of vertices. When a mesh needs room that
+	//  isn't free, the least recently visible meshes that no frame in flight draws are evicted. Evicted meshes that culling
+	//  finds visible again are streamed back in, from their CPU copy in the mesh cache or else read from their .b72 files
+	//  on a loader thread, and drawn once their upload is submitted (until then their instances are dropped):
+	struct MeshResidency
+	{
+		enum State : uint8_t
+		{
+			Resident,  // in mesh_pool, drawable
+			Uploading, // in mesh_pool, upload not submitted yet
+			Loading,   // being read from its .b72 files
+			Evicted,   // not in mesh_pool
+		};
+		State state = Evicted;
+		SceneMgr::MeshObject *mesh = nullptr;
+		uint32_t vertex_count = 0;
+		MeshPool::Mesh handle = MeshPool::NoMesh; // in mesh_pool (Resident and Uploading)
+		uint32_t last_visible = 0;		  // residency_frame it last survived culling in
+		UploadBatcher::Ticket ticket = 0; // (Uploading)
+		std::vector<ObjectsPipeline::Vertex> cached;				 // CPU copy (counted in mesh_cache_used; empty if not cached)
+		std::future<std::vector<ObjectsPipeline::Vertex>> loading; // (Loading)
+	};
+	std::vector<MeshResidency> mesh_residency; // parallel to scene_nodes_vertices
+
+	static constexpr VkDeviceSize DefaultMeshCacheBytes = 256ull * 1024 * 1024;
+	static constexpr uint32_t MaxMeshLoads = 4; // .b72 reads in flight at once
+	VkDeviceSize mesh_cache_bytes = DefaultMeshCacheBytes; // CPU copies of mesh vertices kept for re-streaming
+	VkDeviceSize mesh_cache_used = 0;
+	uint32_t mesh_loads = 0;	  // .b72 reads in flight
+	uint32_t residency_frame = 0; // frames seen by update_mesh_residency
+	uint64_t mesh_evictions = 0;  // meshes evicted so far
+	std::vector<uint32_t> transform_meshes; // mesh of each transform written this frame (how instances find their mesh)
+
+	void update_mesh_residency(std::vector<ObjectInstance> &object_instances); // after culling; drops instances of meshes that aren't resident
+	bool place_mesh(uint32_t mesh, std::vector<ObjectsPipeline::Vertex> const &vertices); // allocate (evicting as needed) and upload; false if it doesn't fit
+	void evict_mesh(uint32_t mesh);
+	ObjectVertices pool_vertices(uint32_t mesh) const; // where a mesh in mesh_pool sits right now
+	void cache_mesh_vertices(uint32_t mesh, std::vector<ObjectsPipeline::Vertex> &&vertices); // (drops least recently visible copies to make room)
+
+	// instanced drawing: visible instances sharing vertices and texture are drawn together, each instance picking its
+	//  Transform (and material) through the per-frame instance list (gl_InstanceIndex -> ObjectsPipeline::Instance):
+	struct DrawGroup
+	{
+		ObjectVertices vertices;
+		uint32_t texture = 0; // texture to bind (always 0 with `--bindless`, where instances of any material share a draw)
+		uint32_t first_instance = 0; // first entry of the group in the instance list
+		uint32_t instance_count = 0;
+		bool operator==(DrawGroup const &) const = default;
+	};
+	std::vector<DrawGroup> draw_groups;
+	uint32_t instancing_draw_count = 0; // last reported count (only logged when it changes)
+	void build_draw_groups(ObjectsPipeline::Instance *instances); // instances: room for object_instances.size()
+
+	// draw sorting: each draw gets a 64-bit key, and the draws are recorded in radix-sorted key order.
+	//  by state (default):          pipeline (4 bits) | texture (12) | mesh (24) | depth (24)
+	//  front-to-back (--front-to-back): pipeline (4 bits) | depth (24) | texture (12) | mesh (24)
+	//  (depth is the view depth of the instance's origin, quantized through its float bits, which order like the floats)
+	uint64_t draw_key(uint32_t pipeline, uint32_t texture, uint32_t mesh, float depth) const;
+	std::vector<uint64_t> transform_draw_keys; // key of each transform written this frame (transforms aren't compacted by culling)
+	std::vector<uint64_t> draw_keys, draw_keys_scratch;
+	std::vector<uint32_t> draw_order, draw_order_scratch; // object_instances indices, in draw order once sorted
+	std::array<uint32_t, 6> draw_sort_state_changes{}; // last reported (pipeline binds, texture binds, draws) unsorted, then sorted
+
+	// cached command buffers (`--cache-commands`): what a workspace recorded for a swapchain image is submitted again while
+	//  everything it was recorded from is the same (the ring contents are re-written every frame, so camera, world and
+	//  transforms still move; only the draws themselves and where things sit in the ring have to match):
+	struct CachedCommands
+	{
+		VkCommandBuffer command_buffer = VK_NULL_HANDLE; // from command_pool; recorded without ONE_TIME_SUBMIT
+		bool valid = false;								 // cleared when the swapchain or the workspace's upload ring is re-made
+		std::array<VkDeviceSize, 5> ring_layout{};		 // transforms, instances, commands and lines offsets, then ring head
+		std::array<float, 4> viewport{};				 // x, y, width, height
+		std::array<int32_t, 4> scissor{};				 // x, y, width, height
+		std::vector<DrawGroup> draw_groups;
+	};
+	// CPU time spent recording the objects' draws (with --debug, reported every RecordingReportFrames frames, to compare
+	//  recording modes; see also test/recording_benchmark.cpp):
+	static constexpr uint32_t RecordingReportFrames = 256;
+	double recording_seconds = 0.0;
+	uint64_t recording_draws = 0;
+	uint32_t recording_frames = 0;
+
+	std::vector<std::vector<CachedCommands>> cached_commands; // [workspace][swapchain image]
+	bool cached_commands_reused = false;					  // last frame's state (only logged when it changes)
+	void invalidate_cached_commands(); // re-record everything on next use
+
+	//--------------------------------------------------------------------
+	// Culling:
+
+	// worker threads for per-frame CPU jobs:
+	ThreadPool worker_pool;
+
+	// software occlusion culling (`--culling occlusion`):
+	OcclusionCuller occlusion_culler;
+	float occluder_min_coverage = 0.02f;		 // only boxes covering at least this fraction of the screen are rasterized as occluders
+	uint32_t occluder_triangle_budget = 1 << 15; // at most this many occluder triangles per frame
+	uint32_t occlusion_culled_count = 0;		 // last reported count (only logged when it changes)
+
+	struct OcclusionCandidate
+	{
+		SceneMgr::MeshObject *mesh = nullptr;
+		glm::mat4 WORLD_FROM_LOCAL;
+	};
+	std::vector<OcclusionCandidate> occlusion_candidates; // parallel to object_instances while culling
+
+	// screen-space contribution culling (`--culling contribution`, threshold from `--contribution-threshold`):
+	uint32_t contribution_culled_count = 0; // last reported count (only logged when it changes)
+
+	// temporal visibility caching (`--culling temporal`): per-node frustum / contribution results are reused until the node
+	//  moves or the camera moves far enough to possibly change them; at most temporal_test_budget cached nodes are re-tested per frame
+	struct VisibilityCacheEntry
+	{
+		glm::mat4 WORLD_FROM_LOCAL; // bbox is valid while the node keeps this transform
+		BBox bbox;
+		bool visible = true;
+		bool contribution_culled = false; // rejected as too small (re-tested whenever the camera moves)
+		float margin = 0.0f;			  // distance from the bbox corners to the nearest frustum plane when tested
+		float radius = 0.0f;			  // distance from the camera to the farthest bbox corner when tested
+		glm::vec3 camera_position, camera_front, camera_right, camera_up; // main camera when tested
+		uint32_t tested_frame = 0;
+	};
+	std::unordered_map<SceneMgr::NodeObject *, VisibilityCacheEntry> visibility_cache;
+	Camera::Camera_Attributes visibility_cache_attributes{}; // cache is cleared when these (or the viewport size) change
+	float visibility_cache_viewport[2] = {0.0f, 0.0f};
+	uint32_t temporal_test_budget = 512; // nodes not in the cache yet are always tested and don't count
+	uint32_t temporal_frame = 0;
+
+	struct TemporalCandidate
+	{
+		SceneMgr::NodeObject *node = nullptr;
+		glm::mat4 WORLD_FROM_LOCAL;
+		bool bounds_changed = true; // no cache entry for node, or its transform differs from the cached one
+	};
+	std::vector<TemporalCandidate> temporal_candidates; // parallel to object_instances while culling
+
+	struct TemporalStats
+	{
+		uint32_t tested = 0;   // nodes tested this frame (cache misses included)
+		uint32_t deferred = 0; // possibly stale nodes left for later frames (budget spent)
+	} temporal_stats;
+
+	// GPU-driven culling (`--culling gpu-frustum` / `gpu-occlusion`):
+	bool gpu_culling_supported = false; // device has multiDrawIndirect, drawIndirectFirstInstance and drawIndirectCount
+	VkSampler hiz_sampler = VK_NULL_HANDLE; // nearest, used with texelFetch
+	std::array<uint32_t, CullPipeline::StatCount> gpu_culling_stats{}; // last reported counts (only logged when they change)
+	void calculate_frustum_planes(mat4 const &CLIP_FROM_WORLD, float (&planes)[6][4]);
+	void report_gpu_culling_stats(Workspace &workspace);
 
 	//--------------------------------------------------------------------
 	// Constructor modules functions, breaking up the constructor into smaller parts:
@@ -240,18 +570,34 @@ struct Wanderer : RTG::Application
 	// textures
 	void create_diy_textures();
 	void create_textures_descriptor();
+	void create_bindless_descriptor();
+	void create_texture_array_descriptor();
+	VkImageView create_texture_view(Helpers::AllocatedImage const &image);
+
+	// defragmentation (`--defrag`) moved a texture / material_buffer: point views and descriptors at the new one
+	//  (Helpers::defragment calls these once every submitted frame is finished):
+	void texture_moved(uint32_t texture);
+	void material_buffer_moved();
 
 	// object instances
-	void construct_scene_graph_vertices_with_culling(std::vector<ObjectInstance> &object_instances, SceneMgr &sceneMgr, const mat4 &CLIP_FROM_WORLD);
+	void construct_scene_graph_vertices_with_culling(std::vector<ObjectInstance> &object_instances, ObjectsPipeline::Transform *transforms, SceneMgr &sceneMgr, const mat4 &CLIP_FROM_WORLD); // transforms: room for scene_instance_count
+	void apply_occlusion_culling(std::vector<ObjectInstance> &object_instances);
+	uint32_t apply_temporal_visibility_culling(std::vector<ObjectInstance> &object_instances); // returns the contribution culled count
 	
 	//--------------------------------------------------------------------
 	// Load resources Helper:
 
 	// vertices helper
-	void load_mesh_object_vertices(SceneMgr::MeshObject *meshObject, std::vector<ObjectsPipeline::Vertex> &tmp_object_vertices);
+	void load_mesh_object_vertices(SceneMgr::MeshObject *meshObject, std::vector<std::vector<ObjectsPipeline::Vertex>> &loaded_vertices); // appends the mesh's vertices
+	static std::vector<ObjectsPipeline::Vertex> interleave_mesh_vertices(std::vector<glm::vec3> const &positions, std::vector<glm::vec3> const &normals, std::vector<glm::vec4> const &tangents, std::vector<glm::vec2> const &texcoords);
 
 	// object instances helper
 	mat4 calculate_normal_matrix(const glm::mat4 &worldFromLocal);
+	mat4 calculate_culling_clip_from_world(); // always the main camera's view, even in DEBUG mode
+	float calculate_screen_size(BBox const &world_bbox, glm::mat4 const &clip_from_world, VkViewport const &viewport); // in pixels; infinite if bbox crosses the camera plane
+
+	// rendering helper
+	void calculate_viewport_and_scissor(VkViewport &viewport, VkRect2D &scissor); // letterboxed to the camera aspect
 
 
 	//--------------------------------------------------------------------
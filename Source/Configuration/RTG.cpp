@@ -77,23 +77,153 @@ void RTG::Configuration::parse(int argc, char **argv)
 		else if (arg == "--culling")
 		{
 			if (argi + 1 >= argc)
-				throw std::runtime_error("--culling requires a parameter (a culling mode name), valid mode: none, frustum.");
+				throw std::runtime_error("--culling requires a parameter (a comma-separated list of culling modes), valid modes: none, frustum, occlusion, gpu-frustum, gpu-occlusion, contribution, temporal.");
 			argi += 1;
 
-			std::string culling_mode_str = argv[argi];
+			culling_mode = Culling_Mode::NONE;
 
-			if (culling_mode_str == "none")
+			std::string culling_mode_list = argv[argi];
+			size_t begin = 0;
+			while (begin <= culling_mode_list.size())
 			{
-				culling_mode = Culling_Mode::NONE;
+				size_t end = culling_mode_list.find(',', begin);
+				if (end == std::string::npos)
+					end = culling_mode_list.size();
+				std::string culling_mode_str = culling_mode_list.substr(begin, end - begin);
+				begin = end + 1;
+
+				if (culling_mode_str == "none")
+				{
+					culling_mode = Culling_Mode::NONE;
+				}
+				else if (culling_mode_str == "frustum")
+				{
+					culling_mode |= Culling_Mode::FRUSTUM;
+				}
+				else if (culling_mode_str == "occlusion")
+				{
+					// occluders are only worth rasterizing for what survived the frustum test:
+					culling_mode |= Culling_Mode::FRUSTUM | Culling_Mode::OCCLUSION;
+				}
+				else if (culling_mode_str == "gpu-frustum")
+				{
+					culling_mode |= Culling_Mode::GPU_FRUSTUM;
+				}
+				else if (culling_mode_str == "gpu-occlusion")
+				{
+					culling_mode |= Culling_Mode::GPU_FRUSTUM | Culling_Mode::GPU_OCCLUSION;
+				}
+				else if (culling_mode_str == "contribution")
+				{
+					culling_mode |= Culling_Mode::CONTRIBUTION;
+				}
+				else if (culling_mode_str == "temporal")
+				{
+					// caches the frustum (and contribution, if also given) tests:
+					culling_mode |= Culling_Mode::FRUSTUM | Culling_Mode::TEMPORAL;
+				}
+				else
+				{
+					throw std::runtime_error("--culling mode '" + culling_mode_str + "' not valid. Current valid modes: none, frustum, occlusion, gpu-frustum, gpu-occlusion, contribution, temporal.");
+				}
 			}
-			else if (culling_mode_str == "frustum")
+		}
+		else if (arg == "--contribution-threshold")
+		{
+			if (argi + 1 >= argc)
+				throw std::runtime_error("--contribution-threshold requires a parameter (a size in pixels).");
+			argi += 1;
+
+			std::string val = argv[argi];
+			size_t used = 0;
+			try
 			{
-				culling_mode = Culling_Mode::FRUSTUM;
+				contribution_threshold = std::stof(val, &used);
 			}
-			else
+			catch (std::exception const &)
+			{
+				used = 0;
+			}
+			if (used != val.size() || !(contribution_threshold >= 0.0f))
+				throw std::runtime_error("--contribution-threshold should be a non-negative number of pixels, got '" + val + "'.");
+		}
+		else if (arg == "--draw-indirect")
+		{
+			draw_indirect = true;
+		}
+		else if (arg == "--bindless")
+		{
+			bindless = true;
+		}
+		else if (arg == "--front-to-back")
+		{
+			front_to_back = true;
+		}
+		else if (arg == "--parallel-recording")
+		{
+			parallel_recording = true;
+		}
+		else if (arg == "--cache-commands")
+		{
+			cache_commands = true;
+		}
+		else if (arg == "--push-constants")
+		{
+			push_constants = true;
+		}
+		else if (arg == "--memory-report")
+		{
+			if (argi + 1 >= argc)
+				throw std::runtime_error("--memory-report requires a parameter (seconds between reports).");
+			argi += 1;
+			std::string val = argv[argi];
+			size_t used = 0;
+			try
+			{
+				memory_report = std::stof(val, &used);
+			}
+			catch (std::exception const &)
+			{
+				used = 0;
+			}
+			if (used != val.size() || !(memory_report >= 0.0f))
+				throw std::runtime_error("--memory-report should be a non-negative number of seconds, got '" + val + "'.");
+		}
+		else if (arg == "--mesh-budget")
+		{
+			if (argi + 1 >= argc)
+				throw std::runtime_error("--mesh-budget requires a parameter (MiB of mesh vertices to keep on the GPU).");
+			argi += 1;
+			std::string val = argv[argi];
+			size_t used = 0;
+			try
+			{
+				mesh_budget = std::stof(val, &used);
+			}
+			catch (std::exception const &)
+			{
+				used = 0;
+			}
+			if (used != val.size() || !(mesh_budget >= 0.0f))
+				throw std::runtime_error("--mesh-budget should be a non-negative number of MiB, got '" + val + "'.");
+		}
+		else if (arg == "--defrag")
+		{
+			if (argi + 1 >= argc)
+				throw std::runtime_error("--defrag requires a parameter (MiB to copy per frame).");
+			argi += 1;
+			std::string val = argv[argi];
+			size_t used = 0;
+			try
 			{
-				throw std::runtime_error("--culling mode not valid. Current valid mode: none, frustum.");
+				defrag = std::stof(val, &used);
 			}
+			catch (std::exception const &)
+			{
+				used = 0;
+			}
+			if (used != val.size() || !(defrag >= 0.0f))
+				throw std::runtime_error("--defrag should be a non-negative number of MiB, got '" + val + "'.");
 		}
 		else if (arg == "--headless")
 		{
@@ -125,7 +255,17 @@ void RTG::Configuration::usage(std::function<void(const char *, const char *)> c
 	callback("--drawing-size <w> <h>", "Set the size of the surface to draw to.");
 	callback("--scene <name>", "Set the path of scene graph to render.");
 	callback("--camera <name>", "Set the name of the scene camera.");
-	callback("--culling <mode>", "Valid mode: none, frustum.");
+	callback("--culling <mode>[,<mode>...]", "Valid modes: none, frustum, occlusion (software occlusion culling, implies frustum), gpu-frustum (compute culling + indirect draws), gpu-occlusion (two-phase Hi-Z culling, implies gpu-frustum), contribution (drops objects smaller than the contribution threshold; combine with frustum), temporal (re-tests only nodes whose visibility may have changed, within a per-frame budget; implies frustum).");
+	callback("--contribution-threshold <pixels>", "Set the projected size below which contribution culling drops an object (default 1).");
+	callback("--draw-indirect", "Submit the objects with one multi-draw indirect call per texture instead of one draw per mesh (ignored with gpu-frustum culling, which always draws indirectly).");
+	callback("--bindless", "Bind every texture once in a descriptor array and pick textures and materials per instance in the shaders (no per-draw descriptor binds).");
+	callback("--front-to-back", "Sort the objects nearest first (less overdraw) rather than by texture and mesh (fewer state changes and draws).");
+	callback("--parallel-recording", "Record the objects' draws on the worker threads into secondary command buffers (ignored with gpu-frustum culling, which only records a few indirect draws).");
+	callback("--cache-commands", "Re-submit the previously recorded commands of a swapchain image while the visible draws are unchanged, instead of recording every frame (ignored with gpu-frustum culling; turns off parallel recording).");
+	callback("--push-constants", "Bind every texture once as an array and select each draw's texture and material with push constants instead of re-binding a descriptor set per texture (ignored with --bindless).");
+	callback("--memory-report <seconds>", "Log GPU memory use per heap (against the driver's budget, where VK_EXT_memory_budget is supported) and per category (meshes, textures, workspaces, attachments, staging) every <seconds>; 0 (the default) turns it off.");
+	callback("--mesh-budget <MiB>", "Keep at most <MiB> of mesh vertices on the GPU: the least recently visible meshes are evicted, and streamed back in (from a CPU cache or their .b72 files) once culling finds them visible again; 0 (the default) keeps every mesh resident.");
+	callback("--defrag <MiB>", "On frames that upload nothing, move textures, materials, and the mesh pool out of sparse device memory blocks, copying at most <MiB> per frame, and release the emptied blocks (logging fragmentation before and after); 0 (the default) turns it off.");
 	callback("--headless <events>", "Run headless renderer and read frame times and events from the events file.");
 }
 
@@ -413,6 +553,14 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this)
 						graphics_queue_family = i;
 				}
 
+				// if it only does transfers (a copy engine), upload on it -- as long as it can copy images row by row:
+				if ((queue_family.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queue_family.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+				{
+					VkExtent3D const &granularity = queue_family.minImageTransferGranularity;
+					if (!transfer_queue_family && granularity.width == 1 && granularity.height == 1 && granularity.depth == 1)
+						transfer_queue_family = i;
+				}
+
 				// if it has present support, set the present queue family:
 				VkBool32 present_support = VK_FALSE;
 				VK(vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, surface, &present_support));
@@ -460,6 +608,12 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this)
 			{
 				throw std::runtime_error("No queue with present support.");
 			}
+
+			if (!transfer_queue_family)
+			{
+				transfer_queue_family = graphics_queue_family;
+			}
+			std::cout << "[RTG] (Queue Family) Uploads run on " << (transfer_queue_family != graphics_queue_family ? "transfer-only" : "the graphics") << " queue family " << transfer_queue_family.value() << "." << std::endl;
 		}
 
 		// select device extensions
@@ -469,11 +623,31 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this)
 #endif
 		device_extensions.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME); // Add the swapchain extension
 
+		{ // per-heap budgets, if the driver reports them:
+			uint32_t count = 0;
+			VK(vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &count, nullptr));
+			std::vector<VkExtensionProperties> available(count);
+			VK(vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &count, available.data()));
+
+			for (VkExtensionProperties const &extension : available)
+			{
+				if (std::strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+				{
+					memory_budget = true;
+					device_extensions.emplace_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+					break;
+				}
+			}
+			if (configuration.debug)
+				std::cout << "[RTG] (Device Extensions) " << VK_EXT_MEMORY_BUDGET_EXTENSION_NAME << ": " << (memory_budget ? "enabled" : "not supported") << "." << std::endl;
+		}
+
 		// create the logical device
 		{
 			std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
 			std::set<uint32_t> unique_queue_families{
 				graphics_queue_family.value(),
+				transfer_queue_family.value(),
 				present_queue_family.value()};
 
 			float queue_priorities[1] = {1.0f};
@@ -503,8 +677,80 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this)
 					std::cout << "[RTG] (Device Features) Supported by device; enabled.\n";
 			}
 
+			// indirect drawing (used by GPU-driven culling):
+			device_features.multiDrawIndirect = supported_features.multiDrawIndirect;
+			device_features.drawIndirectFirstInstance = supported_features.drawIndirectFirstInstance;
+
+			// texture arrays indexed by push constants (used by `--push-constants`):
+			device_features.shaderSampledImageArrayDynamicIndexing = supported_features.shaderSampledImageArrayDynamicIndexing;
+
+			// Vulkan 1.2 features can only be chained if the device itself is 1.2+:
+			void *device_features_chain = nullptr;
+			{
+				VkPhysicalDeviceProperties properties;
+				vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+				if (properties.apiVersion >= VK_API_VERSION_1_2)
+				{
+					VkPhysicalDeviceVulkan12Features supported_features_12{
+						.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+					};
+					VkPhysicalDeviceFeatures2 supported_features2{
+						.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+						.pNext = &supported_features_12,
+					};
+					vkGetPhysicalDeviceFeatures2(physical_device, &supported_features2);
+
+					// frame and upload scheduling:
+					device_features_12.timelineSemaphore = supported_features_12.timelineSemaphore;
+
+					device_features_12.drawIndirectCount = supported_features_12.drawIndirectCount;
+
+					// descriptor indexing (used by bindless textures):
+					device_features_12.runtimeDescriptorArray = supported_features_12.runtimeDescriptorArray;
+					device_features_12.shaderSampledImageArrayNonUniformIndexing = supported_features_12.shaderSampledImageArrayNonUniformIndexing;
+					device_features_12.descriptorBindingPartiallyBound = supported_features_12.descriptorBindingPartiallyBound;
+
+					device_features_chain = &device_features_12;
+				}
+
+				if (properties.apiVersion >= VK_API_VERSION_1_3)
+				{
+					VkPhysicalDeviceVulkan13Features supported_features_13{
+						.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+					};
+					VkPhysicalDeviceFeatures2 supported_features2{
+						.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+						.pNext = &supported_features_13,
+					};
+					vkGetPhysicalDeviceFeatures2(physical_device, &supported_features2);
+
+					// batched, per-resource barriers (used by BarrierBatch):
+					device_features_13.synchronization2 = supported_features_13.synchronization2;
+
+					device_features_12.pNext = &device_features_13;
+				}
+			}
+
+			if (!device_features_12.timelineSemaphore)
+			{
+				throw std::runtime_error("Device does not support timeline semaphores (Vulkan 1.2), which frames and uploads are scheduled with.");
+			}
+
+			if (configuration.debug)
+			{
+				std::cout << "[RTG] (Device Features) multiDrawIndirect: " << (device_features.multiDrawIndirect ? "enabled" : "not supported") << ".\n";
+				std::cout << "[RTG] (Device Features) drawIndirectFirstInstance: " << (device_features.drawIndirectFirstInstance ? "enabled" : "not supported") << ".\n";
+				std::cout << "[RTG] (Device Features) drawIndirectCount: " << (device_features_12.drawIndirectCount ? "enabled" : "not supported") << ".\n";
+				std::cout << "[RTG] (Device Features) shaderSampledImageArrayDynamicIndexing: " << (device_features.shaderSampledImageArrayDynamicIndexing ? "enabled" : "not supported") << ".\n";
+				std::cout << "[RTG] (Device Features) descriptor indexing (runtime arrays, non-uniform sampled images, partially bound): "
+						  << ((device_features_12.runtimeDescriptorArray && device_features_12.shaderSampledImageArrayNonUniformIndexing && device_features_12.descriptorBindingPartiallyBound) ? "enabled" : "not supported") << ".\n";
+				std::cout << "[RTG] (Device Features) synchronization2: " << (device_features_13.synchronization2 ? "enabled" : "not supported") << ".\n";
+			}
+
 			VkDeviceCreateInfo create_info{
 				.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+				.pNext = device_features_chain,
 				.queueCreateInfoCount = uint32_t(queue_create_infos.size()),
 				.pQueueCreateInfos = queue_create_infos.data(),
 
@@ -522,6 +768,7 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this)
 			VK(vkCreateDevice(physical_device, &create_info, nullptr, &device));
 
 			vkGetDeviceQueue(device, graphics_queue_family.value(), 0, &graphics_queue);
+			vkGetDeviceQueue(device, transfer_queue_family.value(), 0, &transfer_queue);
 			vkGetDeviceQueue(device, present_queue_family.value(), 0, &present_queue);
 		};
 	};
@@ -529,20 +776,13 @@ RTG::RTG(Configuration const &configuration_) : helpers(*this)
 	// create initial swapchain:
 	recreate_swapchain();
 
+	// create the frame timeline (at 0, so workspaces -- last used by "frame 0" -- are all available to start):
+	frames.create(device);
+
 	// create workspace resources:
 	workspaces.resize(configuration.workspaces);
 	for (auto &workspace : workspaces)
 	{
-		// create workspace fences:
-		{
-			VkFenceCreateInfo create_info{
-				.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-				.flags = VK_FENCE_CREATE_SIGNALED_BIT, // start signaled, because all workspaces are available to start
-			};
-
-			VK(vkCreateFence(device, &create_info, nullptr, &workspace.workspace_available));
-		}
-
 		// create workspace semaphores:
 		{
 			VkSemaphoreCreateInfo create_info{
@@ -583,11 +823,6 @@ RTG::~RTG()
 	// destroy workspace resources:
 	for (auto &workspace : workspaces)
 	{
-		if (workspace.workspace_available != VK_NULL_HANDLE)
-		{
-			vkDestroyFence(device, workspace.workspace_available, nullptr);
-			workspace.workspace_available = VK_NULL_HANDLE;
-		}
 		if (workspace.image_available != VK_NULL_HANDLE)
 		{
 			vkDestroySemaphore(device, workspace.image_available, nullptr);
@@ -601,6 +836,8 @@ RTG::~RTG()
 	}
 	workspaces.clear();
 
+	frames.destroy();
+
 	// destroy the swapchain:
 	destroy_swapchain();
 
@@ -909,6 +1146,8 @@ void RTG::run(Application &application)
 
 	// setup time handling
 	std::chrono::high_resolution_clock::time_point before = std::chrono::high_resolution_clock::now();
+	std::chrono::high_resolution_clock::time_point memory_reported = before;
+	UploadBatcher::Ticket uploads_submitted = 0; // (as of the last frame; frames that submit no uploads are idle)
 	// headless_start = std::chrono::high_resolution_clock::now();
 
 	while (!glfwWindowShouldClose(window))
@@ -944,11 +1183,11 @@ void RTG::run(Application &application)
 				workspace_index = next_workspace;
 				next_workspace = (next_workspace + 1) % workspaces.size();
 
-				// wait until the workspace is not being used:
-				VK(vkWaitForFences(device, 1, &workspaces[workspace_index].workspace_available, VK_TRUE, UINT64_MAX));
+				// wait until the workspace is not being used (the GPU has finished the last frame rendered with it):
+				frames.wait(workspaces[workspace_index].frame);
 
-				// mark the workspace as in use:
-				VK(vkResetFences(device, 1, &workspaces[workspace_index].workspace_available));
+				// mark the workspace as in use by the next frame:
+				workspaces[workspace_index].frame = frames.next();
 			};
 
 			uint32_t image_index = -1U;
@@ -982,13 +1221,31 @@ void RTG::run(Application &application)
 			// headless_accumulated_time = std::chrono::duration<double>(headless_accumulator - headless_start).count();
 			// std::cout << headless_accumulated_time << " AVAILABLE" << std::endl;
 
+			// submit uploads queued since the last frame (so this frame's work sees them):
+			helpers.uploads.flush();
+
+			// idle frames move memory out of sparse blocks (`--defrag`):
+			helpers.defragment(helpers.uploads.submitted() == uploads_submitted);
+			uploads_submitted = helpers.uploads.submitted();
+
+			if (configuration.memory_report > 0.0f)
+			{
+				std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+				if (std::chrono::duration<float>(now - memory_reported).count() >= configuration.memory_report)
+				{
+					memory_reported = now;
+					helpers.log_memory();
+				}
+			}
+
 			// queue rendering work
 			application.render(*this, RenderParams{
 										  .workspace_index = workspace_index,
 										  .image_index = image_index,
 										  .image_available = workspaces[workspace_index].image_available,
 										  .image_done = workspaces[workspace_index].image_done,
-										  .workspace_available = workspaces[workspace_index].workspace_available,
+										  .frame_done = frames.semaphore,
+										  .frame = workspaces[workspace_index].frame,
 									  });
 
 			// queue the work for presentation: (resize swapchain if needed)
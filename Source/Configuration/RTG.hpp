@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Source/VkMemory/Helpers.hpp"
+#include "Source/VkMemory/Timeline.hpp"
 #include "Source/DataType/InputEvent.hpp"
 #include "Source/Tools/SceneMgr.hpp"
 #include "Source/Camera/Camera.hpp"
@@ -77,12 +78,61 @@ struct RTG
 		Camera debug_camera; // used for DEBUG mode
 		Camera user_camera; // backup for user camera settings
 		
-		// if set, use a specific culling mode:
-		enum Culling_Mode {
-			NONE,
-			FRUSTUM
+		// if set, use specific culling modes (bitmask, modes can be combined):
+		//  `--culling <mode>[,<mode>...]` command-line flag
+		enum Culling_Mode : uint32_t {
+			NONE = 0,
+			FRUSTUM = 1 << 0,
+			OCCLUSION = 1 << 1, // CPU software occlusion culling (implies FRUSTUM)
+			GPU_FRUSTUM = 1 << 2, // compute-shader frustum culling feeding vkCmdDrawIndirectCount
+			GPU_OCCLUSION = 1 << 3, // two-phase Hi-Z occlusion culling on the GPU (implies GPU_FRUSTUM)
+			CONTRIBUTION = 1 << 4, // screen-space contribution culling of objects smaller than contribution_threshold
+			TEMPORAL = 1 << 5, // cache FRUSTUM / CONTRIBUTION results per node across frames (implies FRUSTUM)
 		};
-		Culling_Mode culling_mode;
+		uint32_t culling_mode = NONE;
+
+		// projected size (in pixels, larger side of the screen rectangle) below which CONTRIBUTION culling drops an object:
+		//  `--contribution-threshold <pixels>` command-line flag
+		float contribution_threshold = 1.0f;
+
+		// if true, draw the objects with one vkCmdDrawIndirect per texture bucket (commands written by the CPU each frame):
+		//  `--draw-indirect` command-line flag
+		bool draw_indirect = false;
+
+		// if true, bind all textures at once as a descriptor array (plus a material buffer) indexed per instance:
+		//  `--bindless` command-line flag
+		bool bindless = false;
+
+		// if true, sort opaque draws front-to-back (less overdraw) instead of by state (fewer binds and draws):
+		//  `--front-to-back` command-line flag
+		bool front_to_back = false;
+
+		// if true, split the objects' draws across the worker threads, each recording a secondary command buffer:
+		//  `--parallel-recording` command-line flag
+		bool parallel_recording = false;
+
+		// if true, keep the recorded command buffer of each workspace and swapchain image, and submit it again while the
+		//  draws it records are unchanged (CPU-driven culling only):
+		//  `--cache-commands` command-line flag
+		bool cache_commands = false;
+
+		// if true, select each draw's texture (and material) with push constants into a texture array bound once:
+		//  `--push-constants` command-line flag
+		bool push_constants = false;
+
+		// if positive, log GPU memory use (per heap against its budget, and per category) every this many seconds:
+		//  `--memory-report <seconds>` command-line flag
+		float memory_report = 0.0f;
+
+		// if positive, keep at most this many MiB of mesh vertices on the GPU, evicting the least recently visible meshes
+		//  and streaming them back in when they are visible again:
+		//  `--mesh-budget <MiB>` command-line flag
+		float mesh_budget = 0.0f;
+
+		// if positive, move movable resources (textures, materials, the mesh pool) out of sparse device memory blocks on
+		//  idle frames, copying at most this many MiB per frame, so emptied blocks are released:
+		//  `--defrag <MiB>` command-line flag
+		float defrag = 0.0f;
 
 		// if set, use the headless mode
 		bool is_headless;
@@ -145,10 +195,17 @@ struct RTG
 	std::optional<uint32_t> graphics_queue_family;
 	VkQueue graphics_queue = VK_NULL_HANDLE;
 
+	// queue for uploads (a transfer-only family when the device has a usable one, otherwise the graphics queue):
+	std::optional<uint32_t> transfer_queue_family;
+	VkQueue transfer_queue = VK_NULL_HANDLE;
+
 	// queue for present operations:
 	std::optional<uint32_t> present_queue_family;
 	VkQueue present_queue = VK_NULL_HANDLE;
 
+	// VK_EXT_memory_budget is enabled (Helpers::query_memory_budget reports the driver's budget and usage per heap):
+	bool memory_budget = false;
+
 	//-------------------------------------------------
 	// Handles for the window and surface:
 
@@ -173,12 +230,16 @@ struct RTG
 	void recreate_swapchain();
 	void destroy_swapchain(); // NOTE: swapchain must exist
 
+	// Frames are scheduled on a timeline semaphore: the nth frame's work signals value n when it is done, so anything
+	//  last used by frame n (a workspace, a retired buffer) is free once frames.reached(n).
+	Timeline frames;
+
 	// Workspaces hold dynamic state that must be kept separate between frames.
 	//  RTG stores some synchronization primitives per workspace.
 	//  (The bulk of per-workspace data will be managed by the Application.)
 	struct PerWorkspace
 	{
-		VkFence workspace_available = VK_NULL_HANDLE; // workspace is ready for a new render
+		uint64_t frame = 0;							  // last frame rendered with the workspace (ready for a new render once frames reaches it)
 		VkSemaphore image_available = VK_NULL_HANDLE; // the image is ready to write to
 		VkSemaphore image_done = VK_NULL_HANDLE;	  // the image is done being written to
 	};
@@ -235,7 +296,8 @@ struct RTG
 		uint32_t image_index;						  // which swapchain image to render into
 		VkSemaphore image_available = VK_NULL_HANDLE; // nothing should use the swapchain image until this is signal'd
 		VkSemaphore image_done = VK_NULL_HANDLE;	  // this should be signal'd when the image is done being written to
-		VkFence workspace_available = VK_NULL_HANDLE; // this should be signal'd when *all* work is done for the frame
+		VkSemaphore frame_done = VK_NULL_HANDLE;	  // timeline; frame should be signal'd on it when *all* work is done for the frame
+		uint64_t frame = 0;							  // this frame's value on frame_done (and on rtg.frames)
 	};
 
 	//------------------------------
@@ -244,4 +306,15 @@ struct RTG
 	VkPhysicalDeviceFeatures device_features{
 		.wideLines = VK_TRUE, // enable wide lines
 	};
+
+	// Vulkan 1.2 features (chained into device creation; only what the device supports is enabled -- except
+	//  timelineSemaphore, which frame and upload scheduling need):
+	VkPhysicalDeviceVulkan12Features device_features_12{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+	};
+
+	// Vulkan 1.3 features (chained after device_features_12, likewise):
+	VkPhysicalDeviceVulkan13Features device_features_13{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+	};
 };
@@ -0,0 +1,328 @@
+#include "Source/Culling/OcclusionCuller.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OCCLUSION_USE_SSE 1
+#else
+#define OCCLUSION_USE_SSE 0 // scalar fallback (e.g. arm64); same results, one pixel at a time
+#endif
+
+static_assert(OcclusionCuller::TileWidth % 4 == 0, "tile rows are processed four pixels at a time.");
+
+OcclusionCuller::OcclusionCuller(uint32_t width_, uint32_t height_)
+{
+    tiles_x = std::max(1u, (width_ + TileWidth - 1) / TileWidth);
+    tiles_y = std::max(1u, (height_ + TileHeight - 1) / TileHeight);
+    width = tiles_x * TileWidth;
+    height = tiles_y * TileHeight;
+
+    depth.assign(size_t(width) * height, 1.0f);
+    tile_max_depth.assign(size_t(tiles_x) * tiles_y, 1.0f);
+    band_bins.resize(tiles_y);
+
+    clip_from_world = glm::mat4(1.0f);
+}
+
+void OcclusionCuller::begin_frame(glm::mat4 const &clip_from_world_)
+{
+    clip_from_world = clip_from_world_;
+
+    std::fill(depth.begin(), depth.end(), 1.0f);
+    std::fill(tile_max_depth.begin(), tile_max_depth.end(), 1.0f);
+
+    triangles.clear();
+    for (std::vector<uint32_t> &bin : band_bins)
+    {
+        bin.clear();
+    }
+
+    stats = Stats{};
+}
+
+bool OcclusionCuller::project_bbox(BBox const &bbox, float &min_x, float &min_y, float &max_x, float &max_y, float &min_z) const
+{
+    min_x = min_y = min_z = FLT_MAX;
+    max_x = max_y = -FLT_MAX;
+
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        glm::vec4 corner(
+            (i & 4) ? bbox.max.x : bbox.min.x,
+            (i & 2) ? bbox.max.y : bbox.min.y,
+            (i & 1) ? bbox.max.z : bbox.min.z,
+            1.0f);
+        glm::vec4 clip = clip_from_world * corner;
+
+        if (clip.w < NearW)
+            return false;
+
+        float inv_w = 1.0f / clip.w;
+        float x = (clip.x * inv_w * 0.5f + 0.5f) * float(width);
+        float y = (clip.y * inv_w * 0.5f + 0.5f) * float(height);
+        float z = clip.z * inv_w;
+
+        min_x = std::min(min_x, x);
+        max_x = std::max(max_x, x);
+        min_y = std::min(min_y, y);
+        max_y = std::max(max_y, y);
+        min_z = std::min(min_z, z);
+    }
+
+    return true;
+}
+
+float OcclusionCuller::screen_coverage(BBox const &world_bbox) const
+{
+    if (world_bbox.empty())
+        return 0.0f;
+
+    float min_x, min_y, max_x, max_y, min_z;
+    if (!project_bbox(world_bbox, min_x, min_y, max_x, max_y, min_z))
+        return 1.0f; // camera is (nearly) inside the box; likely a wall/room, the best kind of occluder
+
+    float w = std::clamp(max_x, 0.0f, float(width)) - std::clamp(min_x, 0.0f, float(width));
+    float h = std::clamp(max_y, 0.0f, float(height)) - std::clamp(min_y, 0.0f, float(height));
+    return (w * h) / (float(width) * float(height));
+}
+
+void OcclusionCuller::add_occluder(std::vector<glm::vec3> const &positions, glm::mat4 const &world_from_local)
+{
+    glm::mat4 clip_from_local = clip_from_world * world_from_local;
+
+    for (size_t i = 0; i + 2 < positions.size(); i += 3)
+    {
+        setup_triangle(
+            clip_from_local * glm::vec4(positions[i + 0], 1.0f),
+            clip_from_local * glm::vec4(positions[i + 1], 1.0f),
+            clip_from_local * glm::vec4(positions[i + 2], 1.0f));
+    }
+
+    ++stats.occluders;
+}
+
+void OcclusionCuller::setup_triangle(glm::vec4 const &c0, glm::vec4 const &c1, glm::vec4 const &c2)
+{
+    // no clipping: triangles reaching behind the near plane are simply not used as occluders
+    if (c0.w < NearW || c1.w < NearW || c2.w < NearW)
+        return;
+
+    glm::vec4 const *clip[3] = {&c0, &c1, &c2};
+    float x[3], y[3], z[3];
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        float inv_w = 1.0f / clip[i]->w;
+        x[i] = (clip[i]->x * inv_w * 0.5f + 0.5f) * float(width);
+        y[i] = (clip[i]->y * inv_w * 0.5f + 0.5f) * float(height);
+        z[i] = clip[i]->z * inv_w;
+    }
+
+    // twice the signed area; make the winding positive so "inside" is E >= 0 for every edge
+    float area2 = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (std::fabs(area2) < 1e-6f)
+        return;
+    if (area2 < 0.0f)
+    {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+        area2 = -area2;
+    }
+
+    // pixels whose centers (i + 0.5) fall inside the triangle's bounds:
+    int32_t min_x = std::max(0, int32_t(std::ceil(std::min({x[0], x[1], x[2]}) - 0.5f)));
+    int32_t min_y = std::max(0, int32_t(std::ceil(std::min({y[0], y[1], y[2]}) - 0.5f)));
+    int32_t max_x = std::min(int32_t(width) - 1, int32_t(std::floor(std::max({x[0], x[1], x[2]}) - 0.5f)));
+    int32_t max_y = std::min(int32_t(height) - 1, int32_t(std::floor(std::max({y[0], y[1], y[2]}) - 0.5f)));
+    if (min_x > max_x || min_y > max_y)
+        return;
+
+    ScreenTriangle tri;
+    tri.min_x = min_x;
+    tri.min_y = min_y;
+    tri.max_x = max_x;
+    tri.max_y = max_y;
+
+    // edge functions for edges 0->1, 1->2, 2->0 (evaluated at pixel centers):
+    float a[3], b[3], c[3];
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        uint32_t j = (i + 1) % 3;
+        a[i] = y[i] - y[j];
+        b[i] = x[j] - x[i];
+        c[i] = -(a[i] * x[i] + b[i] * y[i]);
+
+        tri.edge_a[i] = a[i];
+        tri.edge_b[i] = b[i];
+        tri.edge_c[i] = c[i];
+    }
+
+    // depth plane from barycentrics (edge 1->2 weights vertex 0, edge 2->0 weights vertex 1, edge 0->1 weights vertex 2):
+    float inv_area2 = 1.0f / area2;
+    tri.z_a = (a[1] * z[0] + a[2] * z[1] + a[0] * z[2]) * inv_area2;
+    tri.z_b = (b[1] * z[0] + b[2] * z[1] + b[0] * z[2]) * inv_area2;
+    tri.z_c = (c[1] * z[0] + c[2] * z[1] + c[0] * z[2]) * inv_area2;
+    // farthest depth anywhere inside the pixel, not at its center:
+    tri.z_c += 0.5f * (std::fabs(tri.z_a) + std::fabs(tri.z_b));
+    tri.z_max = std::max({z[0], z[1], z[2]});
+
+    uint32_t index = uint32_t(triangles.size());
+    triangles.emplace_back(tri);
+    for (int32_t band = min_y / int32_t(TileHeight); band <= max_y / int32_t(TileHeight); ++band)
+    {
+        band_bins[band].emplace_back(index);
+    }
+
+    ++stats.triangles;
+}
+
+void OcclusionCuller::rasterize_occluders(ThreadPool &pool)
+{
+    // bands touch disjoint tiles, so they can be rasterized in parallel without locking:
+    pool.parallel_for(tiles_y, [this](uint32_t band) { rasterize_band(band); });
+}
+
+void OcclusionCuller::rasterize_band(uint32_t band)
+{
+    assert(band < tiles_y);
+
+    for (uint32_t index : band_bins[band])
+    {
+        ScreenTriangle const &tri = triangles[index];
+        for (uint32_t tx = uint32_t(tri.min_x) / TileWidth; tx <= uint32_t(tri.max_x) / TileWidth; ++tx)
+        {
+            rasterize_triangle_in_tile(tri, tx, band);
+        }
+    }
+
+    // refresh the per-tile maximum used to skip whole tiles when testing:
+    for (uint32_t tx = 0; tx < tiles_x; ++tx)
+    {
+        float const *tile = tile_data(tx, band);
+        tile_max_depth[band * tiles_x + tx] = *std::max_element(tile, tile + TileWidth * TileHeight);
+    }
+}
+
+void OcclusionCuller::rasterize_triangle_in_tile(ScreenTriangle const &tri, uint32_t tx, uint32_t ty)
+{
+    int32_t tile_x = int32_t(tx * TileWidth);
+    int32_t tile_y = int32_t(ty * TileHeight);
+
+    int32_t y_begin = std::max(tri.min_y, tile_y);
+    int32_t y_end = std::min(tri.max_y, tile_y + int32_t(TileHeight) - 1);
+    // process whole groups of four pixels that overlap the triangle's columns:
+    int32_t gx_begin = (std::max(tri.min_x, tile_x) - tile_x) & ~3;
+    int32_t gx_end = std::min(tri.max_x, tile_x + int32_t(TileWidth) - 1) - tile_x;
+
+    float *tile = tile_data(tx, ty);
+
+#if OCCLUSION_USE_SSE
+    __m128 const lane_offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    __m128 const zero = _mm_setzero_ps();
+    __m128 const e0_a = _mm_set1_ps(tri.edge_a[0]), e0_b = _mm_set1_ps(tri.edge_b[0]), e0_c = _mm_set1_ps(tri.edge_c[0]);
+    __m128 const e1_a = _mm_set1_ps(tri.edge_a[1]), e1_b = _mm_set1_ps(tri.edge_b[1]), e1_c = _mm_set1_ps(tri.edge_c[1]);
+    __m128 const e2_a = _mm_set1_ps(tri.edge_a[2]), e2_b = _mm_set1_ps(tri.edge_b[2]), e2_c = _mm_set1_ps(tri.edge_c[2]);
+    __m128 const z_a = _mm_set1_ps(tri.z_a), z_b = _mm_set1_ps(tri.z_b), z_c = _mm_set1_ps(tri.z_c);
+    __m128 const z_max = _mm_set1_ps(tri.z_max);
+
+    for (int32_t y = y_begin; y <= y_end; ++y)
+    {
+        float *row = tile + (y - tile_y) * TileWidth;
+        __m128 py = _mm_set1_ps(float(y) + 0.5f);
+
+        // the y terms are constant along the row:
+        __m128 e0_row = _mm_add_ps(_mm_mul_ps(e0_b, py), e0_c);
+        __m128 e1_row = _mm_add_ps(_mm_mul_ps(e1_b, py), e1_c);
+        __m128 e2_row = _mm_add_ps(_mm_mul_ps(e2_b, py), e2_c);
+        __m128 z_row = _mm_add_ps(_mm_mul_ps(z_b, py), z_c);
+
+        for (int32_t gx = gx_begin; gx <= gx_end; gx += 4)
+        {
+            __m128 px = _mm_add_ps(_mm_set1_ps(float(tile_x + gx)), lane_offsets);
+
+            __m128 inside = _mm_and_ps(
+                _mm_and_ps(
+                    _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(e0_a, px), e0_row), zero),
+                    _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(e1_a, px), e1_row), zero)),
+                _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(e2_a, px), e2_row), zero));
+            if (_mm_movemask_ps(inside) == 0)
+                continue;
+
+            __m128 z = _mm_min_ps(_mm_add_ps(_mm_mul_ps(z_a, px), z_row), z_max);
+            __m128 old_z = _mm_loadu_ps(row + gx);
+            __m128 new_z = _mm_min_ps(old_z, z);
+            _mm_storeu_ps(row + gx, _mm_or_ps(_mm_and_ps(inside, new_z), _mm_andnot_ps(inside, old_z)));
+        }
+    }
+#else
+    for (int32_t y = y_begin; y <= y_end; ++y)
+    {
+        float *row = tile + (y - tile_y) * TileWidth;
+        float py = float(y) + 0.5f;
+
+        for (int32_t x = gx_begin; x < std::min(gx_end + 4, int32_t(TileWidth)); ++x)
+        {
+            float px = float(tile_x + x) + 0.5f;
+
+            bool inside = true;
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                inside = inside && (tri.edge_a[i] * px + tri.edge_b[i] * py + tri.edge_c[i] >= 0.0f);
+            }
+            if (!inside)
+                continue;
+
+            float z = std::min(tri.z_a * px + tri.z_b * py + tri.z_c, tri.z_max);
+            row[x] = std::min(row[x], z);
+        }
+    }
+#endif
+}
+
+bool OcclusionCuller::is_bbox_visible(BBox const &world_bbox)
+{
+    ++stats.tested;
+
+    float min_x, min_y, max_x, max_y, min_z;
+    if (!project_bbox(world_bbox, min_x, min_y, max_x, max_y, min_z))
+        return true;
+
+    // pixels overlapping the screen rectangle:
+    int32_t px_begin = std::max(0, int32_t(std::floor(min_x)));
+    int32_t py_begin = std::max(0, int32_t(std::floor(min_y)));
+    int32_t px_end = std::min(int32_t(width) - 1, int32_t(std::floor(max_x)));
+    int32_t py_end = std::min(int32_t(height) - 1, int32_t(std::floor(max_y)));
+    if (px_begin > px_end || py_begin > py_end)
+        return true; // off screen; that's for frustum culling to decide
+
+    for (int32_t ty = py_begin / int32_t(TileHeight); ty <= py_end / int32_t(TileHeight); ++ty)
+    {
+        for (int32_t tx = px_begin / int32_t(TileWidth); tx <= px_end / int32_t(TileWidth); ++tx)
+        {
+            // every pixel of the tile is nearer than the occludee:
+            if (tile_max_depth[ty * tiles_x + tx] < min_z)
+                continue;
+
+            float const *tile = tile_data(tx, ty);
+            int32_t tile_x = tx * int32_t(TileWidth);
+            int32_t tile_y = ty * int32_t(TileHeight);
+
+            for (int32_t y = std::max(py_begin, tile_y); y <= std::min(py_end, tile_y + int32_t(TileHeight) - 1); ++y)
+            {
+                float const *row = tile + (y - tile_y) * TileWidth;
+                for (int32_t x = std::max(px_begin, tile_x); x <= std::min(px_end, tile_x + int32_t(TileWidth) - 1); ++x)
+                {
+                    if (row[x - tile_x] >= min_z)
+                        return true;
+                }
+            }
+        }
+    }
+
+    ++stats.culled;
+    return false;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Source/DataType/BBox.hpp"
+#include "Source/Tools/ThreadPool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * CPU software occlusion culling against a low-resolution, tiled depth buffer.
+ *
+ *  culler.begin_frame(CLIP_FROM_WORLD);
+ *  culler.add_occluder(positions, WORLD_FROM_LOCAL); // for a few large meshes (triangle lists)
+ *  culler.rasterize_occluders(pool);                 // SIMD, one band of tiles per job
+ *  if (!culler.is_bbox_visible(world_bbox)) { ...skip draw... }
+ *
+ * Depth follows the clip matrix (smaller is nearer) and is cleared to 1 (far plane).
+ * Coverage is sampled at pixel centers (so meshes have no cracks along shared edges), but the depth written is the
+ *  farthest depth the occluder reaches inside that pixel, and an occludee is visible if any pixel under its screen
+ *  rectangle is not nearer than the occludee's nearest point. Anything crossing the near plane is never used as an
+ *  occluder triangle and is always reported as visible.
+ */
+struct OcclusionCuller
+{
+    OcclusionCuller(uint32_t width = 256, uint32_t height = 128);
+    ~OcclusionCuller() = default;
+    OcclusionCuller(OcclusionCuller const &) = delete;
+
+    static constexpr uint32_t TileWidth = 8;  // pixels per tile row (a multiple of the 4-wide SIMD lanes)
+    static constexpr uint32_t TileHeight = 8; // rows per tile; a "band" is one row of tiles
+    static constexpr float NearW = 1e-5f;     // clip w below this is treated as behind the camera
+
+    // buffer layout (width and height are rounded up to whole tiles):
+    uint32_t width, height;
+    uint32_t tiles_x, tiles_y;
+    std::vector<float> depth;          // tile-major; tile (tx, ty) holds TileWidth * TileHeight floats, row-major inside the tile
+    std::vector<float> tile_max_depth; // farthest depth stored in each tile (refreshed by rasterize_occluders)
+
+    glm::mat4 clip_from_world;
+
+    // per-frame counters:
+    struct Stats
+    {
+        uint32_t occluders = 0;
+        uint32_t triangles = 0; // triangles that survived setup and were binned
+        uint32_t tested = 0;
+        uint32_t culled = 0;
+    } stats;
+
+    // clear the buffer and occluder list for a new frame seen through clip_from_world
+    void begin_frame(glm::mat4 const &clip_from_world);
+
+    // fraction of the buffer covered by the screen rectangle of bbox (1 if bbox crosses the near plane, 0 if off screen)
+    float screen_coverage(BBox const &world_bbox) const;
+
+    // transform, set up and bin the triangles of an occluder (positions is a triangle list)
+    void add_occluder(std::vector<glm::vec3> const &positions, glm::mat4 const &world_from_local);
+
+    // rasterize every binned triangle into the depth buffer
+    void rasterize_occluders(ThreadPool &pool);
+
+    // test a world-space bbox against the rasterized occluders
+    bool is_bbox_visible(BBox const &world_bbox);
+
+private:
+    // triangle prepared for rasterization (edge functions and depth plane in pixel units)
+    struct ScreenTriangle
+    {
+        float edge_a[3], edge_b[3], edge_c[3]; // E_i(x, y) = a*x + b*y + c, >= 0 inside
+        float z_a, z_b, z_c;                   // depth plane z(x, y) = z_a*x + z_b*y + z_c, c already includes the conservative margin
+        float z_max;                           // farthest vertex depth (depth never exceeds this)
+        int32_t min_x, min_y, max_x, max_y;    // pixel range whose centers may be covered (inclusive, clamped to the buffer)
+    };
+    std::vector<ScreenTriangle> triangles;
+    std::vector<std::vector<uint32_t>> band_bins; // triangle indices overlapping each band
+
+    // project the corners of bbox; false if any corner is behind the near plane
+    bool project_bbox(BBox const &bbox, float &min_x, float &min_y, float &max_x, float &max_y, float &min_z) const;
+
+    void setup_triangle(glm::vec4 const &c0, glm::vec4 const &c1, glm::vec4 const &c2);
+    void rasterize_band(uint32_t band);
+    void rasterize_triangle_in_tile(ScreenTriangle const &tri, uint32_t tx, uint32_t ty);
+
+    float *tile_data(uint32_t tx, uint32_t ty) { return depth.data() + (ty * tiles_x + tx) * (TileWidth * TileHeight); }
+    float const *tile_data(uint32_t tx, uint32_t ty) const { return depth.data() + (ty * tiles_x + tx) * (TileWidth * TileHeight); }
+};
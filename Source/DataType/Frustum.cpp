@@ -1,5 +1,9 @@
 #include "Source/DataType/Frustum.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 Frustum Frustum::createFrustumFromCamera(const Camera &camera)
 {
     /* cr. adapeted from Learn OpenGL: https://learnopengl.com/Guest-Articles/2021/Scene/Frustum-Culling */
@@ -53,4 +57,19 @@ bool Frustum::isBBoxInFrustum(BBox &bbox)
     }
 
     return (cornerInFrustumCnt >= 4); // pass if >= 6 corners are in the frustum
+}
+
+float Frustum::distanceToBoundary(BBox &bbox)
+{
+    float distance = std::numeric_limits<float>::infinity();
+
+    for (const glm::vec3 &corner : bbox.get_corners())
+    {
+        for (const Plane &plane : {nearFace, farFace, leftFace, rightFace, topFace, bottomFace})
+        {
+            distance = std::min(distance, std::abs(plane.signedDistance(corner)));
+        }
+    }
+
+    return distance;
 }
\ No newline at end of file
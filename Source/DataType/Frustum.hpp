@@ -18,4 +18,5 @@ struct Frustum
 
     static Frustum createFrustumFromCamera(const Camera &camera);
     bool isBBoxInFrustum(BBox &bbox);
+    float distanceToBoundary(BBox &bbox); // smallest distance from a bbox corner to any plane (no corner changes side before a plane moves this far)
 };
@@ -10,3 +10,8 @@ bool Plane::pointInFront(glm::vec3 point) const
 {
     return glm::dot(point - position, normal) > 0;
 }
+
+float Plane::signedDistance(glm::vec3 point) const
+{
+    return glm::dot(point - position, normal);
+}
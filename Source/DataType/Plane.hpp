@@ -11,4 +11,5 @@ struct Plane
     glm::vec3 normal;
 
     bool pointInFront(glm::vec3 point) const;
+    float signedDistance(glm::vec3 point) const; // positive in front, in units of normal's length
 };
@@ -0,0 +1,161 @@
+#include "Source/Application/Wanderer/Wanderer.hpp"
+
+#include "Source/VkMemory/Helpers.hpp"
+#include "Source/Helper/VK.hpp"
+#include "vulkan/vulkan_core.h"
+
+static uint32_t comp_code[] =
+#include "spv/Source/Shader/Wanderer/cull.comp.inl"
+    ;
+
+static uint32_t hiz_comp_code[] =
+#include "spv/Source/Shader/Wanderer/cull-hiz.comp.inl"
+    ;
+
+void Wanderer::CullPipeline::create(RTG &rtg)
+{
+    VkShaderModule comp_module = rtg.helpers.create_shader_module(comp_code);
+    VkShaderModule hiz_comp_module = rtg.helpers.create_shader_module(hiz_comp_code);
+
+    { // set0_Cull layout holds the instance list and parameters (read), the indirect draw commands + counts (written) and the early phase results used in the compute shader
+        std::array<VkDescriptorSetLayoutBinding, 5> bindings{
+            VkDescriptorSetLayoutBinding{
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+            VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+            VkDescriptorSetLayoutBinding{
+                .binding = 2,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+            VkDescriptorSetLayoutBinding{
+                .binding = 3,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+            VkDescriptorSetLayoutBinding{
+                .binding = 4,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+        };
+
+        VkDescriptorSetLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = uint32_t(bindings.size()),
+            .pBindings = bindings.data()};
+
+        VK(vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set0_Cull));
+    };
+
+    { // set1_HiZ layout holds the Hi-Z pyramid (all levels) used in the Hi-Z variant of the compute shader
+        std::array<VkDescriptorSetLayoutBinding, 1> bindings{
+            VkDescriptorSetLayoutBinding{
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+        };
+
+        VkDescriptorSetLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = uint32_t(bindings.size()),
+            .pBindings = bindings.data()};
+
+        VK(vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set1_HiZ));
+    };
+
+    { // create pipeline layout:
+        VkPushConstantRange range{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(Push)};
+
+        std::array<VkDescriptorSetLayout, 2> layouts{
+            set0_Cull,
+            set1_HiZ,
+        };
+
+        VkPipelineLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = uint32_t(layouts.size()),
+            .pSetLayouts = layouts.data(),
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &range};
+
+        VK(vkCreatePipelineLayout(rtg.device, &create_info, nullptr, &layout));
+    };
+
+    { // create pipelines (both variants share the layout):
+        std::array<VkComputePipelineCreateInfo, 2> create_infos{
+            VkComputePipelineCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                .stage{
+                    .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module = comp_module,
+                    .pName = "main"},
+                .layout = layout},
+            VkComputePipelineCreateInfo{
+                .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+                .stage{
+                    .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module = hiz_comp_module,
+                    .pName = "main"},
+                .layout = layout},
+        };
+
+        std::array<VkPipeline, 2> handles{};
+        VK(vkCreateComputePipelines(rtg.device,
+                                    VK_NULL_HANDLE, // pipeline cache
+                                    uint32_t(create_infos.size()),
+                                    create_infos.data(),
+                                    nullptr, // allocation callback
+                                    handles.data()));
+        handle = handles[0];
+        hiz_handle = handles[1];
+    };
+
+    vkDestroyShaderModule(rtg.device, hiz_comp_module, nullptr);
+    vkDestroyShaderModule(rtg.device, comp_module, nullptr);
+}
+
+void Wanderer::CullPipeline::destroy(RTG &rtg)
+{
+    if (set0_Cull != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorSetLayout(rtg.device, set0_Cull, nullptr);
+        set0_Cull = VK_NULL_HANDLE;
+    }
+
+    if (set1_HiZ != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorSetLayout(rtg.device, set1_HiZ, nullptr);
+        set1_HiZ = VK_NULL_HANDLE;
+    }
+
+    if (layout != VK_NULL_HANDLE)
+    {
+        vkDestroyPipelineLayout(rtg.device, layout, nullptr);
+        layout = VK_NULL_HANDLE;
+    }
+
+    if (handle != VK_NULL_HANDLE)
+    {
+        vkDestroyPipeline(rtg.device, handle, nullptr);
+        handle = VK_NULL_HANDLE;
+    }
+
+    if (hiz_handle != VK_NULL_HANDLE)
+    {
+        vkDestroyPipeline(rtg.device, hiz_handle, nullptr);
+        hiz_handle = VK_NULL_HANDLE;
+    }
+}
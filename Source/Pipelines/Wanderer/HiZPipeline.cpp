@@ -0,0 +1,97 @@
+#include "Source/Application/Wanderer/Wanderer.hpp"
+
+#include "Source/VkMemory/Helpers.hpp"
+#include "Source/Helper/VK.hpp"
+#include "vulkan/vulkan_core.h"
+
+static uint32_t comp_code[] =
+#include "spv/Source/Shader/Wanderer/hiz.comp.inl"
+    ;
+
+void Wanderer::HiZPipeline::create(RTG &rtg)
+{
+    VkShaderModule comp_module = rtg.helpers.create_shader_module(comp_code);
+
+    { // set0_Levels layout holds the level being read (sampled) and the level being written (storage image) in the compute shader
+        std::array<VkDescriptorSetLayoutBinding, 2> bindings{
+            VkDescriptorSetLayoutBinding{
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+            VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT},
+        };
+
+        VkDescriptorSetLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = uint32_t(bindings.size()),
+            .pBindings = bindings.data()};
+
+        VK(vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set0_Levels));
+    };
+
+    { // create pipeline layout:
+        VkPushConstantRange range{
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(Push)};
+
+        std::array<VkDescriptorSetLayout, 1> layouts{
+            set0_Levels,
+        };
+
+        VkPipelineLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = uint32_t(layouts.size()),
+            .pSetLayouts = layouts.data(),
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &range};
+
+        VK(vkCreatePipelineLayout(rtg.device, &create_info, nullptr, &layout));
+    };
+
+    { // create pipeline:
+        VkComputePipelineCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = comp_module,
+                .pName = "main"},
+            .layout = layout};
+
+        VK(vkCreateComputePipelines(rtg.device,
+                                    VK_NULL_HANDLE, // pipeline cache
+                                    1,
+                                    &create_info,
+                                    nullptr, // allocation callback
+                                    &handle));
+    };
+
+    vkDestroyShaderModule(rtg.device, comp_module, nullptr);
+}
+
+void Wanderer::HiZPipeline::destroy(RTG &rtg)
+{
+    if (set0_Levels != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorSetLayout(rtg.device, set0_Levels, nullptr);
+        set0_Levels = VK_NULL_HANDLE;
+    }
+
+    if (layout != VK_NULL_HANDLE)
+    {
+        vkDestroyPipelineLayout(rtg.device, layout, nullptr);
+        layout = VK_NULL_HANDLE;
+    }
+
+    if (handle != VK_NULL_HANDLE)
+    {
+        vkDestroyPipeline(rtg.device, handle, nullptr);
+        handle = VK_NULL_HANDLE;
+    }
+}
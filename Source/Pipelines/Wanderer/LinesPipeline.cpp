@@ -19,7 +19,7 @@ void Wanderer::LinesPipeline::create(RTG &rtg, VkRenderPass render_pass, uint32_
     VkShaderModule frag_module = rtg.helpers.create_shader_module(frag_code);
 
     { // create camera descriptor set layout binding:
-      //  the set0_Camera layout holds a Camera structure in a uniform buffer used in the vertex shader
+      //  the set0_Camera layout holds a Camera structure in a uniform buffer (the workspace's copy of a versioned uniform) used in the vertex shader
         std::array<VkDescriptorSetLayoutBinding, 1> bindings{
             VkDescriptorSetLayoutBinding{
                 .binding = 0,
@@ -12,15 +12,25 @@ static uint32_t frag_code[] =
 #include "spv/Source/Shader/Wanderer/objects.frag.inl"
     ;
 
+static uint32_t push_frag_code[] =
+#include "spv/Source/Shader/Wanderer/objects-push.frag.inl"
+    ;
+
+static uint32_t bindless_frag_code[] =
+#include "spv/Source/Shader/Wanderer/objects-bindless.frag.inl"
+    ;
+
 void Wanderer::ObjectsPipeline::create(RTG &rtg, VkRenderPass render_pass, uint32_t subpass)
 {
 
     VkShaderModule vert_module = rtg.helpers.create_shader_module(vert_code);
-    VkShaderModule frag_module = rtg.helpers.create_shader_module(frag_code);
+    VkShaderModule frag_module = rtg.configuration.bindless         ? rtg.helpers.create_shader_module(bindless_frag_code)
+                                 : rtg.configuration.push_constants ? rtg.helpers.create_shader_module(push_frag_code)
+                                                                    : rtg.helpers.create_shader_module(frag_code);
 
     // create transforms descriptor set layout binding:
 
-    { // set0_World layout holds world info in a uniform buffer used in the fragment shader
+    { // set0_World layout holds world info in a uniform buffer (the workspace's copy of a versioned uniform) used in the fragment shader
         std::array<VkDescriptorSetLayoutBinding, 1> bindings{
             VkDescriptorSetLayoutBinding{
                 .binding = 0,
@@ -36,11 +46,16 @@ void Wanderer::ObjectsPipeline::create(RTG &rtg, VkRenderPass render_pass, uint3
         VK(vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set0_World));
     };
 
-    { // set1_Transforms layout holds a Transform structure in a STORAGE buffer used in the vertex shader
-        std::array<VkDescriptorSetLayoutBinding, 1> bindings{
+    { // set1_Transforms layout holds the Transform structures and the per-instance transform indices in STORAGE buffers (at dynamic offsets in the upload ring) used in the vertex shader
+        std::array<VkDescriptorSetLayoutBinding, 2> bindings{
             VkDescriptorSetLayoutBinding{
                 .binding = 0,
-                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_VERTEX_BIT},
+            VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
                 .descriptorCount = 1,
                 .stageFlags = VK_SHADER_STAGE_VERTEX_BIT}};
 
@@ -68,19 +83,73 @@ void Wanderer::ObjectsPipeline::create(RTG &rtg, VkRenderPass render_pass, uint3
         VK(vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set2_TEXTURE));
     };
 
+    if (rtg.configuration.push_constants)
+    { // set2_Textures layout holds every texture in a sampler2D array used in the fragment shader (indexed by push constant)
+        std::array<VkDescriptorSetLayoutBinding, 1> bindings{
+            VkDescriptorSetLayoutBinding{
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = MaxTextures,
+                .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT}};
+
+        VkDescriptorSetLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = uint32_t(bindings.size()),
+            .pBindings = bindings.data()};
+
+        VK(vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set2_Textures));
+    };
+
+    if (rtg.configuration.bindless)
+    { // set2_Bindless layout holds the materials in a STORAGE buffer and every texture in a sampler2D array, used in the fragment shader
+        std::array<VkDescriptorSetLayoutBinding, 2> bindings{
+            VkDescriptorSetLayoutBinding{
+                .binding = 0,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT},
+            VkDescriptorSetLayoutBinding{
+                .binding = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount = MaxTextures,
+                .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT}};
+
+        // the texture array doesn't have to be filled:
+        std::array<VkDescriptorBindingFlags, 2> binding_flags{
+            0,
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT};
+        VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+            .bindingCount = uint32_t(binding_flags.size()),
+            .pBindingFlags = binding_flags.data()};
+
+        VkDescriptorSetLayoutCreateInfo create_info{
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = &flags_info,
+            .bindingCount = uint32_t(bindings.size()),
+            .pBindings = bindings.data()};
+
+        VK(vkCreateDescriptorSetLayout(rtg.device, &create_info, nullptr, &set2_Bindless));
+    };
+
     { // create pipeline layout:
         std::array<VkDescriptorSetLayout, 3> layouts{
             set0_World, // set0_Camera,
             set1_Transforms,
-            set2_TEXTURE,
+            rtg.configuration.bindless ? set2_Bindless : rtg.configuration.push_constants ? set2_Textures : set2_TEXTURE,
         };
 
+        VkPushConstantRange range{
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .offset = 0,
+            .size = sizeof(Push)};
+
         VkPipelineLayoutCreateInfo create_info{
             .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
             .setLayoutCount = uint32_t(layouts.size()),
             .pSetLayouts = layouts.data(),
-            .pushConstantRangeCount = 0,
-            .pPushConstantRanges = nullptr};
+            .pushConstantRangeCount = rtg.configuration.push_constants ? 1u : 0u,
+            .pPushConstantRanges = rtg.configuration.push_constants ? &range : nullptr};
 
         VK(vkCreatePipelineLayout(rtg.device, &create_info, nullptr, &layout));
     };
@@ -222,6 +291,18 @@ void Wanderer::ObjectsPipeline::destroy(RTG &rtg)
         set2_TEXTURE = VK_NULL_HANDLE;
     }
 
+    if (set2_Textures != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorSetLayout(rtg.device, set2_Textures, nullptr);
+        set2_Textures = VK_NULL_HANDLE;
+    }
+
+    if (set2_Bindless != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorSetLayout(rtg.device, set2_Bindless, nullptr);
+        set2_Bindless = VK_NULL_HANDLE;
+    }
+
     if (layout != VK_NULL_HANDLE)
     {
         vkDestroyPipelineLayout(rtg.device, layout, nullptr);
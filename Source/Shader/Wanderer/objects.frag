@@ -1,5 +1,12 @@
 #version 450
 
+// compiled three times: as-is (the draw's texture bound as set 2), with -DPUSH_CONSTANTS (every texture in one array, picked
+//  per draw with push constants) and with -DBINDLESS (every texture in one array, picked per instance through its material)
+
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
 layout(set = 0, binding = 0, std140) uniform World {
     vec3 SKY_DIRECTION;
     vec3 SKY_ENERGY; //energy supplied by sky to a surface patch with normal = SKY_DIRECTION
@@ -7,7 +14,31 @@ layout(set = 0, binding = 0, std140) uniform World {
     vec3 SUN_ENERGY; //energy supplied by sun to a surface patch with normal = SUN_DIRECTION
 };
 
+#ifdef BINDLESS
+struct Material {
+    uint TEXTURE; // index into TEXTURES
+};
+
+layout(set = 2, binding = 0, std430) readonly buffer Materials {
+    Material MATERIALS[];
+};
+
+layout(set = 2, binding = 1) uniform sampler2D TEXTURES[]; // (partially bound; only the first textures are written)
+
+layout(location = 3) flat in uint inMaterial;
+#elif defined(PUSH_CONSTANTS)
+const uint MAX_TEXTURES = 128; // ObjectsPipeline::MaxTextures
+
+layout(set = 2, binding = 0) uniform sampler2D TEXTURES[MAX_TEXTURES]; // (every slot written; unused ones repeat texture 0)
+
+layout(push_constant) uniform Push {
+    uint MATERIAL; // (materials map 1:1 onto textures for now)
+    uint TEXTURE;  // index into TEXTURES
+    uint FLAGS;    // (none defined yet)
+};
+#else
 layout(set = 2, binding = 0) uniform sampler2D TEXTURE;
+#endif
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
@@ -17,7 +48,15 @@ layout(location = 0) out vec4 outColor;
 
 void main() {
     vec3 n = normalize(inNormal);
+#ifdef BINDLESS
+    // (instances of one draw can use different materials, so the index is non-uniform)
+    vec3 albedo = texture(TEXTURES[nonuniformEXT(MATERIALS[inMaterial].TEXTURE)], inTexCoord).rgb / 3.1415926;
+#elif defined(PUSH_CONSTANTS)
+    // (push constants are the same for the whole draw, so the index is dynamically uniform)
+    vec3 albedo = texture(TEXTURES[TEXTURE], inTexCoord).rgb / 3.1415926;
+#else
     vec3 albedo = texture(TEXTURE, inTexCoord).rgb / 3.1415926;
+#endif
 
     //hemisphere sky + directional sun:
     vec3 e = SKY_ENERGY * (0.5 * dot(n, SKY_DIRECTION) + 0.5) + SUN_ENERGY * max(0.0, dot(n, SUN_DIRECTION));
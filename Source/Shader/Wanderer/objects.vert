@@ -10,6 +10,16 @@ layout(set = 1, binding = 0, std140) readonly buffer Transforms {
 	Transform TRANSFORMS[];
 };
 
+// per instance (gl_InstanceIndex, firstInstance included): which TRANSFORMS entry and material it uses
+struct Instance {
+	uint TRANSFORM;
+	uint MATERIAL;
+};
+
+layout(set = 1, binding = 1, std430) readonly buffer Instances {
+	Instance INSTANCES[];
+};
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec4 inTangent;
@@ -18,11 +28,15 @@ layout(location = 3) in vec2 inTexCoord;
 layout(location = 0) out vec3 outPosition;
 layout(location = 1) out vec3 outNormal;
 layout(location = 2) out vec2 outTexCoord;
+layout(location = 3) flat out uint outMaterial; // (only read by the bindless fragment shader)
 
 void main() {
-	gl_Position = TRANSFORMS[gl_InstanceIndex].CLIP_FROM_LOCAL * vec4(inPosition, 1.0);
+	uint transform = INSTANCES[gl_InstanceIndex].TRANSFORM;
+
+	gl_Position = TRANSFORMS[transform].CLIP_FROM_LOCAL * vec4(inPosition, 1.0);
 
-	outPosition = mat4x3(TRANSFORMS[gl_InstanceIndex].WORLD_FROM_LOCAL) * vec4(inPosition, 1.0);
-	outNormal = mat3(TRANSFORMS[gl_InstanceIndex].WORLD_FROM_LOCAL_NORMAL) * inNormal;
+	outPosition = mat4x3(TRANSFORMS[transform].WORLD_FROM_LOCAL) * vec4(inPosition, 1.0);
+	outNormal = mat3(TRANSFORMS[transform].WORLD_FROM_LOCAL_NORMAL) * inNormal;
 	outTexCoord = inTexCoord;
+	outMaterial = INSTANCES[gl_InstanceIndex].MATERIAL;
 }
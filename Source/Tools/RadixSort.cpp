@@ -0,0 +1,54 @@
+#include "Source/Tools/RadixSort.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <utility>
+
+void RadixSort::sort(std::vector<uint64_t> &keys, std::vector<uint32_t> &values, std::vector<uint64_t> &keys_scratch, std::vector<uint32_t> &values_scratch)
+{
+    assert(keys.size() == values.size());
+    std::size_t count = keys.size();
+    if (count < 2)
+        return;
+
+    // histogram every byte of every key in a single read of the keys:
+    std::array<std::array<uint32_t, 256>, 8> histograms{};
+    for (uint64_t key : keys)
+    {
+        for (uint32_t pass = 0; pass < 8; ++pass)
+            ++histograms[pass][(key >> (pass * 8)) & 0xff];
+    }
+
+    keys_scratch.resize(count);
+    values_scratch.resize(count);
+
+    for (uint32_t pass = 0; pass < 8; ++pass)
+    {
+        std::array<uint32_t, 256> &histogram = histograms[pass];
+        uint32_t shift = pass * 8;
+
+        // all keys share this byte (e.g. unused high bits), so this pass wouldn't move anything:
+        if (histogram[(keys[0] >> shift) & 0xff] == count)
+            continue;
+
+        // histogram -> first output slot of each byte value:
+        uint32_t offset = 0;
+        for (uint32_t &bucket : histogram)
+        {
+            uint32_t size = bucket;
+            bucket = offset;
+            offset += size;
+        }
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            uint32_t slot = histogram[(keys[i] >> shift) & 0xff]++;
+            keys_scratch[slot] = keys[i];
+            values_scratch[slot] = values[i];
+        }
+
+        std::swap(keys, keys_scratch);
+        std::swap(values, values_scratch);
+    }
+}
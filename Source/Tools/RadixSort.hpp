@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace RadixSort
+{
+    // stable LSD radix sort of values by 64-bit keys (one byte per pass; passes where every key has the same byte are skipped)
+    //  keys and values are reordered together; the scratch vectors are kept by the caller so sorting every frame doesn't allocate
+    void sort(std::vector<uint64_t> &keys, std::vector<uint32_t> &values, std::vector<uint64_t> &keys_scratch, std::vector<uint32_t> &values_scratch);
+}
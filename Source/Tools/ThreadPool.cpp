@@ -0,0 +1,130 @@
+#include "Source/Tools/ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t worker_count)
+{
+    if (worker_count == DefaultWorkerCount)
+    {
+        uint32_t hardware_threads = std::thread::hardware_concurrency(); // may be 0 if unknown
+        worker_count = std::min(hardware_threads > 1 ? hardware_threads - 1 : 0, MaxWorkerCount);
+    }
+
+    workers.reserve(worker_count);
+    for (uint32_t i = 0; i < worker_count; ++i)
+    {
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quitting = true;
+    }
+    wake.notify_all();
+
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void ThreadPool::parallel_for(uint32_t count, std::function<void(uint32_t)> const &job)
+{
+    if (count == 0)
+        return;
+
+    // not worth waking anyone up:
+    if (workers.empty() || count == 1)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+            job(i);
+        return;
+    }
+
+    // post the batch:
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current_job = &job;
+        current_count = count;
+        next_index.store(0);
+        pending_workers = uint32_t(workers.size());
+        ++generation;
+    }
+    wake.notify_all();
+
+    // help out:
+    run_jobs(job, count);
+
+    // wait for every worker to check in, so none of them is still holding a pointer to `job`:
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&]() { return pending_workers == 0; });
+        current_job = nullptr;
+        current_count = 0;
+    }
+
+    // pass on what went wrong (on whichever thread it was):
+    if (failure)
+    {
+        std::exception_ptr rethrown = std::move(failure);
+        failure = nullptr;
+        std::rethrow_exception(rethrown);
+    }
+}
+
+void ThreadPool::worker_loop()
+{
+    uint64_t seen_generation = 0;
+
+    while (true)
+    {
+        std::function<void(uint32_t)> const *job = nullptr;
+        uint32_t count = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return quitting || generation != seen_generation; });
+            if (quitting)
+                return;
+
+            seen_generation = generation;
+            job = current_job;
+            count = current_count;
+        }
+
+        run_jobs(*job, count);
+
+        bool last = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --pending_workers;
+            last = (pending_workers == 0);
+        }
+        if (last)
+            done.notify_all();
+    }
+}
+
+void ThreadPool::run_jobs(std::function<void(uint32_t)> const &job, uint32_t count)
+{
+    for (uint32_t i = next_index.fetch_add(1); i < count; i = next_index.fetch_add(1))
+    {
+        try
+        {
+            job(i);
+        }
+        catch (...)
+        {
+            // keep the first exception (for parallel_for to rethrow) and stop handing out indices:
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!failure)
+                failure = std::current_exception();
+            next_index.store(count);
+            return;
+        }
+    }
+}
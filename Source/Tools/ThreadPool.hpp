@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Small persistent pool of worker threads for per-frame CPU jobs.
+ *
+ *  ThreadPool pool;
+ *  pool.parallel_for(count, [&](uint32_t i) { ... }); // runs every index once, returns when all are done
+ *
+ * The calling thread takes jobs too, so a pool with no workers simply runs the loop inline. If a job throws, no further
+ *  indices are handed out, and parallel_for rethrows the first exception once every worker is done with the batch.
+ */
+struct ThreadPool
+{
+    explicit ThreadPool(uint32_t worker_count = DefaultWorkerCount);
+    ~ThreadPool();
+    ThreadPool(ThreadPool const &) = delete;
+
+    static constexpr uint32_t DefaultWorkerCount = -1U; // one worker per hardware thread (minus the caller), capped at MaxWorkerCount
+    static constexpr uint32_t MaxWorkerCount = 7;
+
+    // run job(i) for every i in [0, count) (or until a job throws); not re-entrant (don't call from inside a job)
+    void parallel_for(uint32_t count, std::function<void(uint32_t)> const &job);
+
+    // number of threads that run jobs during parallel_for (workers + the caller)
+    uint32_t thread_count() const { return uint32_t(workers.size()) + 1; }
+
+private:
+    void worker_loop();
+    void run_jobs(std::function<void(uint32_t)> const &job, uint32_t count);
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake; // signaled when a new batch of jobs is posted (or when quitting)
+    std::condition_variable done; // signaled when the last worker finishes a batch
+
+    // current batch (written under mutex, read by workers after they wake):
+    std::function<void(uint32_t)> const *current_job = nullptr;
+    uint32_t current_count = 0;
+    uint64_t generation = 0;      // bumped for every batch, so workers can tell a new batch from a spurious wakeup
+    uint32_t pending_workers = 0; // workers that have not finished the current batch yet
+    bool quitting = false;
+    std::exception_ptr failure; // first exception thrown by a job of the current batch
+
+    std::atomic<uint32_t> next_index{0}; // next job index to hand out
+};
@@ -7,5 +7,6 @@
 namespace TypeHelper
 {
     mat4 convert_glm_mat4_to_mat4(const glm::mat4& matrix);
+    glm::mat4 convert_mat4_to_glm_mat4(const mat4& matrix);
 
 };
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include "Source/VkMemory/BarrierBatch.hpp"
+
+#include <cstdint>
+
+// synchronization1 masks are the low 32 bits of the synchronization2 ones; the rest only have broader equivalents:
+static VkPipelineStageFlags stages_v1(VkPipelineStageFlags2 stages, VkPipelineStageFlags if_none)
+{
+	VkPipelineStageFlags out = VkPipelineStageFlags(stages & 0xffffffffull);
+	if (stages >> 32)
+		out |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT; // (copy / resolve / blit / clear and other split-out stages)
+	return out ? out : if_none;
+}
+
+static VkAccessFlags access_v1(VkAccessFlags2 access)
+{
+	VkAccessFlags out = VkAccessFlags(access & 0xffffffffull);
+	if (access & (VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT))
+		out |= VK_ACCESS_SHADER_READ_BIT;
+	if (access & VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT)
+		out |= VK_ACCESS_SHADER_WRITE_BIT;
+	return out;
+}
+
+void BarrierBatch::memory(VkPipelineStageFlags2 src_stages, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access)
+{
+	memory_barriers.emplace_back(VkMemoryBarrier2{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+		.srcStageMask = src_stages,
+		.srcAccessMask = src_access,
+		.dstStageMask = dst_stages,
+		.dstAccessMask = dst_access,
+	});
+}
+
+void BarrierBatch::buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+						  VkPipelineStageFlags2 src_stages, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access)
+{
+	if (size == 0)
+		return;
+
+	// extend the previous barrier when this range continues it with the same masks:
+	if (!buffer_barriers.empty())
+	{
+		VkBufferMemoryBarrier2 &last = buffer_barriers.back();
+		if (last.buffer == buffer && last.size != VK_WHOLE_SIZE && last.offset + last.size == offset
+			&& last.srcStageMask == src_stages && last.srcAccessMask == src_access && last.dstStageMask == dst_stages && last.dstAccessMask == dst_access)
+		{
+			last.size = (size == VK_WHOLE_SIZE ? VK_WHOLE_SIZE : last.size + size);
+			return;
+		}
+	}
+
+	buffer_barriers.emplace_back(VkBufferMemoryBarrier2{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+		.srcStageMask = src_stages,
+		.srcAccessMask = src_access,
+		.dstStageMask = dst_stages,
+		.dstAccessMask = dst_access,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = buffer,
+		.offset = offset,
+		.size = size,
+	});
+}
+
+void BarrierBatch::image(VkImage image, VkImageSubresourceRange const &range, VkImageLayout old_layout, VkImageLayout new_layout,
+						 VkPipelineStageFlags2 src_stages, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access)
+{
+	image_barriers.emplace_back(VkImageMemoryBarrier2{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+		.srcStageMask = src_stages,
+		.srcAccessMask = src_access,
+		.dstStageMask = dst_stages,
+		.dstAccessMask = dst_access,
+		.oldLayout = old_layout,
+		.newLayout = new_layout,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange = range,
+	});
+}
+
+void BarrierBatch::record(VkCommandBuffer command_buffer)
+{
+	if (empty())
+		return;
+
+	if (synchronization2)
+	{
+		VkDependencyInfo dependency_info{
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.memoryBarrierCount = uint32_t(memory_barriers.size()),
+			.pMemoryBarriers = memory_barriers.data(),
+			.bufferMemoryBarrierCount = uint32_t(buffer_barriers.size()),
+			.pBufferMemoryBarriers = buffer_barriers.data(),
+			.imageMemoryBarrierCount = uint32_t(image_barriers.size()),
+			.pImageMemoryBarriers = image_barriers.data(),
+		};
+		vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+	}
+	else
+	{
+		record_v1(command_buffer);
+	}
+
+	memory_barriers.clear();
+	buffer_barriers.clear();
+	image_barriers.clear();
+}
+
+void BarrierBatch::record_v1(VkCommandBuffer command_buffer) const
+{
+	VkPipelineStageFlags2 src_stages = 0;
+	VkPipelineStageFlags2 dst_stages = 0;
+
+	std::vector<VkMemoryBarrier> memory_v1;
+	memory_v1.reserve(memory_barriers.size());
+	for (VkMemoryBarrier2 const &b : memory_barriers)
+	{
+		src_stages |= b.srcStageMask;
+		dst_stages |= b.dstStageMask;
+		memory_v1.emplace_back(VkMemoryBarrier{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = access_v1(b.srcAccessMask),
+			.dstAccessMask = access_v1(b.dstAccessMask),
+		});
+	}
+
+	std::vector<VkBufferMemoryBarrier> buffer_v1;
+	buffer_v1.reserve(buffer_barriers.size());
+	for (VkBufferMemoryBarrier2 const &b : buffer_barriers)
+	{
+		src_stages |= b.srcStageMask;
+		dst_stages |= b.dstStageMask;
+		buffer_v1.emplace_back(VkBufferMemoryBarrier{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+			.srcAccessMask = access_v1(b.srcAccessMask),
+			.dstAccessMask = access_v1(b.dstAccessMask),
+			.srcQueueFamilyIndex = b.srcQueueFamilyIndex,
+			.dstQueueFamilyIndex = b.dstQueueFamilyIndex,
+			.buffer = b.buffer,
+			.offset = b.offset,
+			.size = b.size,
+		});
+	}
+
+	std::vector<VkImageMemoryBarrier> image_v1;
+	image_v1.reserve(image_barriers.size());
+	for (VkImageMemoryBarrier2 const &b : image_barriers)
+	{
+		src_stages |= b.srcStageMask;
+		dst_stages |= b.dstStageMask;
+		image_v1.emplace_back(VkImageMemoryBarrier{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.srcAccessMask = access_v1(b.srcAccessMask),
+			.dstAccessMask = access_v1(b.dstAccessMask),
+			.oldLayout = b.oldLayout,
+			.newLayout = b.newLayout,
+			.srcQueueFamilyIndex = b.srcQueueFamilyIndex,
+			.dstQueueFamilyIndex = b.dstQueueFamilyIndex,
+			.image = b.image,
+			.subresourceRange = b.subresourceRange,
+		});
+	}
+
+	vkCmdPipelineBarrier(
+		command_buffer,
+		stages_v1(src_stages, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT),	 // src stage mask
+		stages_v1(dst_stages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT), // dst stage mask
+		0,															 // dependency flags
+		uint32_t(memory_v1.size()), memory_v1.data(),				 // memory barriers (count, data)
+		uint32_t(buffer_v1.size()), buffer_v1.data(),				 // buffer memory barriers (count, data)
+		uint32_t(image_v1.size()), image_v1.data()					 // image memory barriers (count, data)
+	);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <vector>
+
+/*
+ * Pipeline barriers gathered and recorded together: each one names exactly what was written (a buffer range, an image,
+ *  or -- only when nothing narrower fits -- all memory) and which stages read it, and record() issues them all in one
+ *  vkCmdPipelineBarrier2.
+ *
+ *  BarrierBatch barriers{.synchronization2 = rtg.device_features_13.synchronization2 == VK_TRUE};
+ *  barriers.buffer(transforms, offset, size,
+ *  	VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+ *  	VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+ *  barriers.buffer(lines, ...VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT);
+ *  barriers.record(command_buffer); // (and the batch is empty again)
+ *
+ * Adjacent ranges of one buffer with the same masks are merged into one barrier. Without synchronization2 the batch
+ *  falls back to a single vkCmdPipelineBarrier with the stages of every barrier merged (and the newer access bits mapped
+ *  to their older, broader equivalents), which still keeps the per-resource scopes.
+ */
+struct BarrierBatch
+{
+	bool synchronization2 = false; // device has the synchronization2 feature enabled (else: vkCmdPipelineBarrier)
+
+	void memory(VkPipelineStageFlags2 src_stages, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access);
+
+	void buffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size,
+				VkPipelineStageFlags2 src_stages, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access);
+
+	void image(VkImage image, VkImageSubresourceRange const &range, VkImageLayout old_layout, VkImageLayout new_layout,
+			   VkPipelineStageFlags2 src_stages, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access);
+
+	bool empty() const { return memory_barriers.empty() && buffer_barriers.empty() && image_barriers.empty(); }
+
+	void record(VkCommandBuffer command_buffer); // issue everything gathered (nothing if empty) and clear
+
+	//-----------------------
+	// internals:
+
+	std::vector<VkMemoryBarrier2> memory_barriers;
+	std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+	std::vector<VkImageMemoryBarrier2> image_barriers;
+
+	void record_v1(VkCommandBuffer command_buffer) const; // (without synchronization2)
+};
@@ -0,0 +1,314 @@
+#include "Source/VkMemory/BlockAllocator.hpp"
+
+#include "Source/Helper/VK.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <iostream>
+
+void BlockAllocator::create(VkDevice device_, VkPhysicalDeviceMemoryProperties const &memory_properties_, VkDeviceSize buffer_image_granularity, bool verbose_)
+{
+	assert(device == VK_NULL_HANDLE);
+
+	device = device_;
+	memory_properties = memory_properties_;
+	verbose = verbose_;
+
+	// pieces are multiples of MinNodeSize aligned to their size, so no granularity page spans two pieces unless pages are larger:
+	separate_kinds = buffer_image_granularity > MinNodeSize;
+
+	pools.clear();
+	pools.resize(2 * memory_properties.memoryTypeCount);
+	for (uint32_t i = 0; i < pools.size(); ++i)
+	{
+		pools[i].memory_type_index = i / 2;
+	}
+	stats_ = Stats{};
+}
+
+void BlockAllocator::destroy()
+{
+	if (stats_.allocation_count != 0 || !dedicated.empty())
+	{
+		// not fatal, just sloppy, so complain but don't throw:
+		std::cerr << "[Helpers] (Device Memory) " << stats_.allocation_count << " suballocations and " << dedicated.size() << " dedicated allocations still live; freeing their memory anyway." << std::endl;
+	}
+
+	if (verbose)
+	{
+		std::cout << "[Helpers] (Device Memory) Peak device memory: " << stats_.peak_device_bytes << " bytes." << std::endl;
+	}
+
+	for (Pool &pool : pools)
+	{
+		for (std::unique_ptr<Block> &block : pool.blocks)
+		{
+			if (block->mapped != nullptr)
+			{
+				vkUnmapMemory(device, block->memory);
+			}
+			vkFreeMemory(device, block->memory, nullptr);
+		}
+		pool.blocks.clear();
+	}
+	pools.clear();
+	block_of.clear();
+
+	for (auto const &[memory, info] : dedicated)
+	{
+		// (unmapped along with the free)
+		vkFreeMemory(device, memory, nullptr);
+	}
+	dedicated.clear();
+
+	stats_ = Stats{};
+	device = VK_NULL_HANDLE;
+}
+
+//----------------------------
+
+BlockAllocator::Region BlockAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, uint32_t memory_type_index, Kind kind)
+{
+	assert(device != VK_NULL_HANDLE);
+	assert(memory_type_index < memory_properties.memoryTypeCount);
+	assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+	Pool &pool = pool_for(memory_type_index, kind);
+
+	VkDeviceSize node_size = std::bit_ceil(std::max({size, alignment, MinNodeSize}));
+
+	if (node_size > pool.block_size / 2)
+	{ // too big to share a block with much else; give it memory of its own:
+		return allocate_dedicated(size, memory_type_index);
+	}
+
+	Region region;
+
+	uint32_t order = uint32_t(std::countr_zero(node_size / MinNodeSize));
+
+	Block *found = nullptr;
+	for (std::unique_ptr<Block> &block : pool.blocks)
+	{
+		if (block->draining)
+			continue;
+		if (allocate_in(*block, order, &region.offset))
+		{
+			found = block.get();
+			break;
+		}
+	}
+	if (found == nullptr)
+	{
+		found = &create_block(uint32_t(&pool - pools.data()));
+		bool allocated = allocate_in(*found, order, &region.offset);
+		assert(allocated);
+		(void)allocated;
+	}
+
+	found->live.emplace(region.offset, Block::Live{.order = order, .size = size});
+	found->used += node_size;
+
+	region.memory = found->memory;
+	region.mapped = found->mapped;
+
+	stats_.allocation_count += 1;
+	stats_.used_bytes += node_size;
+	stats_.requested_bytes += size;
+	return region;
+}
+
+BlockAllocator::Region BlockAllocator::allocate_dedicated(VkDeviceSize size, uint32_t memory_type_index)
+{
+	assert(device != VK_NULL_HANDLE);
+	assert(memory_type_index < memory_properties.memoryTypeCount);
+
+	Region region;
+	region.memory = allocate_memory(size, memory_type_index, &region.mapped);
+	dedicated.emplace(region.memory, Dedicated{.size = size, .memory_type_index = memory_type_index});
+
+	stats_.dedicated_count += 1;
+	stats_.dedicated_bytes += size;
+	stats_.heap_bytes[heap_of(memory_type_index)] += size;
+	update_peak();
+	return region;
+}
+
+void BlockAllocator::free(VkDeviceMemory memory, VkDeviceSize offset)
+{
+	assert(device != VK_NULL_HANDLE);
+
+	auto found = block_of.find(memory);
+	if (found == block_of.end())
+	{
+		auto found_dedicated = dedicated.find(memory);
+		assert(found_dedicated != dedicated.end() && offset == 0);
+
+		stats_.dedicated_count -= 1;
+		stats_.dedicated_bytes -= found_dedicated->second.size;
+		stats_.heap_bytes[heap_of(found_dedicated->second.memory_type_index)] -= found_dedicated->second.size;
+		dedicated.erase(found_dedicated);
+
+		// (unmapped along with the free)
+		vkFreeMemory(device, memory, nullptr);
+		return;
+	}
+
+	Block &block = *found->second;
+	Pool &pool = pools[block.pool];
+
+	auto live = block.live.find(offset);
+	assert(live != block.live.end());
+	uint32_t order = live->second.order;
+	VkDeviceSize node_size = MinNodeSize << order;
+
+	stats_.allocation_count -= 1;
+	stats_.used_bytes -= node_size;
+	stats_.requested_bytes -= live->second.size;
+
+	block.used -= node_size;
+	block.live.erase(live);
+
+	// merge with the buddy for as long as it is free too:
+	while (order < pool.top_order)
+	{
+		VkDeviceSize buddy = offset ^ (MinNodeSize << order);
+		if (block.free_nodes[order].erase(buddy) == 0)
+			break;
+		offset = std::min(offset, buddy);
+		order += 1;
+	}
+	block.free_nodes[order].insert(offset);
+
+	// release empty blocks, keeping one per pool so resources that come and go don't churn vkAllocateMemory:
+	if (block.used == 0 && pool.blocks.size() > 1)
+	{
+		destroy_block(block);
+	}
+}
+
+//----------------------------
+
+BlockAllocator::Pool &BlockAllocator::pool_for(uint32_t memory_type_index, Kind kind)
+{
+	Pool &pool = pools[2 * memory_type_index + (separate_kinds ? kind : Linear)];
+
+	if (pool.block_size == 0)
+	{ // first use: size blocks to at most an eighth of their heap (so small heaps, e.g. a 256MiB BAR window, aren't hogged)
+		VkDeviceSize heap_size = memory_properties.memoryHeaps[memory_properties.memoryTypes[memory_type_index].heapIndex].size;
+		pool.block_size = DefaultBlockSize;
+		while (pool.block_size > heap_size / 8 && pool.block_size > 64 * MinNodeSize)
+		{
+			pool.block_size /= 2;
+		}
+		pool.top_order = uint32_t(std::countr_zero(pool.block_size / MinNodeSize));
+	}
+
+	return pool;
+}
+
+bool BlockAllocator::allocate_in(Block &block, uint32_t order, VkDeviceSize *offset)
+{
+	// smallest free piece that is big enough:
+	uint32_t from = order;
+	while (from < block.free_nodes.size() && block.free_nodes[from].empty())
+	{
+		from += 1;
+	}
+	if (from >= block.free_nodes.size())
+		return false;
+
+	VkDeviceSize at = *block.free_nodes[from].begin();
+	block.free_nodes[from].erase(block.free_nodes[from].begin());
+
+	// split it down to the requested order, keeping the upper halves free:
+	while (from > order)
+	{
+		from -= 1;
+		block.free_nodes[from].insert(at + (MinNodeSize << from));
+	}
+
+	*offset = at;
+	return true;
+}
+
+BlockAllocator::Block &BlockAllocator::create_block(uint32_t pool_index)
+{
+	Pool &pool = pools[pool_index];
+
+	std::unique_ptr<Block> block = std::make_unique<Block>();
+	block->memory = allocate_memory(pool.block_size, pool.memory_type_index, &block->mapped);
+	block->pool = pool_index;
+	block->free_nodes.resize(pool.top_order + 1);
+	block->free_nodes[pool.top_order].insert(0);
+
+	block_of.emplace(block->memory, block.get());
+	pool.blocks.emplace_back(std::move(block));
+
+	stats_.block_count += 1;
+	stats_.block_bytes += pool.block_size;
+	stats_.heap_bytes[heap_of(pool.memory_type_index)] += pool.block_size;
+	update_peak();
+
+	if (verbose)
+	{
+		std::cout << "[Helpers] (Device Memory) New " << pool.block_size << "-byte block for memory type " << pool.memory_type_index
+				  << " (" << pool.blocks.size() << " in its pool, " << stats_.block_count << " total)." << std::endl;
+	}
+
+	return *pool.blocks.back();
+}
+
+void BlockAllocator::destroy_block(Block &block)
+{
+	assert(block.used == 0);
+
+	Pool &pool = pools[block.pool];
+
+	if (block.mapped != nullptr)
+	{
+		vkUnmapMemory(device, block.memory);
+	}
+	vkFreeMemory(device, block.memory, nullptr);
+	block_of.erase(block.memory);
+
+	stats_.block_count -= 1;
+	stats_.block_bytes -= pool.block_size;
+	stats_.heap_bytes[heap_of(pool.memory_type_index)] -= pool.block_size;
+
+	auto found = std::find_if(pool.blocks.begin(), pool.blocks.end(), [&](std::unique_ptr<Block> const &b)
+							  { return b.get() == &block; });
+	assert(found != pool.blocks.end());
+	pool.blocks.erase(found);
+
+	if (verbose)
+	{
+		std::cout << "[Helpers] (Device Memory) Released an empty block of memory type " << pool.memory_type_index
+				  << " (" << pool.blocks.size() << " in its pool, " << stats_.block_count << " total)." << std::endl;
+	}
+}
+
+VkDeviceMemory BlockAllocator::allocate_memory(VkDeviceSize size, uint32_t memory_type_index, void **mapped)
+{
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+
+	VkMemoryAllocateInfo alloc_info{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.allocationSize = size,
+		.memoryTypeIndex = memory_type_index};
+
+	VK(vkAllocateMemory(device, &alloc_info, nullptr, &memory)); // 3rd parameter: custom allocator callbacks
+
+	*mapped = nullptr;
+	if (memory_properties.memoryTypes[memory_type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{ // map it once, for everything that will ever live in it:
+		VK(vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped));
+	}
+
+	return memory;
+}
+
+void BlockAllocator::update_peak()
+{
+	stats_.peak_device_bytes = std::max(stats_.peak_device_bytes, stats_.block_bytes + stats_.dedicated_bytes);
+}
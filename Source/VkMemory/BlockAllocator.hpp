@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Device memory suballocator behind Helpers::allocate: memory is taken from the driver in large blocks (one pool of
+ *  blocks per memory type) and handed out in power-of-two pieces with a buddy allocator, so creating and resizing
+ *  resources rarely costs a vkAllocateMemory (and stays far from maxMemoryAllocationCount).
+ *
+ *  BlockAllocator::Region region = allocator.allocate(req.size, req.alignment, memory_type_index, BlockAllocator::Linear);
+ *  VK(vkBindBufferMemory(device, buffer, region.memory, region.offset));
+ *  ...
+ *  allocator.free(region.memory, region.offset);
+ *
+ * Pieces are aligned to their (power-of-two) size, which covers any alignment up to that size. When the device's
+ *  bufferImageGranularity is coarser than the smallest piece, optimal-tiling images and linear resources (buffers,
+ *  linear images) come from separate blocks so they never share a granularity page.
+ *
+ * Host-visible blocks are mapped once, when created, and stay mapped until freed; Region::mapped is the block's base.
+ *  Requests too large to share a block get their own (dedicated) memory.
+ */
+struct BlockAllocator
+{
+	enum Kind : uint32_t
+	{
+		Linear = 0,	 // buffers and linear-tiling images
+		Optimal = 1, // optimal-tiling images
+	};
+
+	static constexpr VkDeviceSize MinNodeSize = 256;					   // smallest piece handed out
+	static constexpr VkDeviceSize DefaultBlockSize = 64ull * 1024 * 1024; // (smaller for small heaps; see pool_for)
+
+	struct Region
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0; // offset of the piece in memory
+		void *mapped = nullptr;	 // base of memory in the CPU address space (nullptr if not host visible)
+	};
+
+	// allocate size bytes at an offset aligned to alignment (a power of two)
+	Region allocate(VkDeviceSize size, VkDeviceSize alignment, uint32_t memory_type_index, Kind kind);
+
+	// memory of its own (offset 0, exactly size bytes), never shared with other requests; freed with free() as usual
+	Region allocate_dedicated(VkDeviceSize size, uint32_t memory_type_index);
+
+	// return a piece (memory + offset as returned by allocate); empty blocks are released, except the last of a pool
+	void free(VkDeviceMemory memory, VkDeviceSize offset);
+
+	struct Stats
+	{
+		uint32_t block_count = 0;			// blocks being suballocated
+		uint32_t dedicated_count = 0;		// allocations with memory of their own
+		uint32_t allocation_count = 0;		// live pieces in blocks
+		VkDeviceSize block_bytes = 0;		// memory in blocks
+		VkDeviceSize used_bytes = 0;		// memory in live pieces (requests rounded up to powers of two)
+		VkDeviceSize requested_bytes = 0;	// memory asked for by live pieces
+		VkDeviceSize dedicated_bytes = 0;	// memory in dedicated allocations
+		VkDeviceSize peak_device_bytes = 0; // high-water mark of block_bytes + dedicated_bytes
+		std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heap_bytes{}; // [heap index] memory in blocks and dedicated allocations
+	};
+	Stats const &stats() const { return stats_; }
+
+	//-----------------------
+	// internals:
+
+	// used to synchronize create/destroy with Helpers:
+	void create(VkDevice device, VkPhysicalDeviceMemoryProperties const &memory_properties, VkDeviceSize buffer_image_granularity, bool verbose);
+	void destroy(); // releases every block (complains about pieces still allocated)
+
+	struct Block
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void *mapped = nullptr;
+		uint32_t pool = 0;		// index in pools
+		VkDeviceSize used = 0;	// bytes in live pieces
+		bool draining = false;	// being emptied by defragmentation (see Defragmenter); allocate() skips it
+		std::vector<std::set<VkDeviceSize>> free_nodes; // [order] offsets of free pieces of MinNodeSize << order bytes
+		struct Live
+		{
+			uint32_t order;
+			VkDeviceSize size; // as requested
+		};
+		std::unordered_map<VkDeviceSize, Live> live; // offset -> live piece
+	};
+
+	struct Pool
+	{
+		uint32_t memory_type_index = 0;
+		VkDeviceSize block_size = 0; // (0 until the pool is first used)
+		uint32_t top_order = 0;		 // order of a whole block
+		std::vector<std::unique_ptr<Block>> blocks;
+	};
+	std::vector<Pool> pools; // [memory type * 2 + kind]
+
+	struct Dedicated
+	{
+		VkDeviceSize size = 0;
+		uint32_t memory_type_index = 0;
+	};
+	std::unordered_map<VkDeviceMemory, Block *> block_of;
+	std::unordered_map<VkDeviceMemory, Dedicated> dedicated;
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memory_properties{};
+	bool separate_kinds = false; // bufferImageGranularity is coarser than MinNodeSize
+	bool verbose = false;		 // log block creation and release
+	Stats stats_;
+
+	Pool &pool_for(uint32_t memory_type_index, Kind kind);
+	bool allocate_in(Block &block, uint32_t order, VkDeviceSize *offset);
+	Block &create_block(uint32_t pool_index);
+	void destroy_block(Block &block);
+	VkDeviceMemory allocate_memory(VkDeviceSize size, uint32_t memory_type_index, void **mapped);
+	void update_peak();
+	uint32_t heap_of(uint32_t memory_type_index) const { return memory_properties.memoryTypes[memory_type_index].heapIndex; }
+};
@@ -4,9 +4,13 @@
 #include "Source/Helper/VK.hpp"
 
 #include <utility>
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+#include <string>
 
 Helpers::Allocation::Allocation(Allocation &&from)
 {
@@ -16,6 +20,7 @@ Helpers::Allocation::Allocation(Allocation &&from)
 	std::swap(size, from.size);
 	std::swap(offset, from.offset);
 	std::swap(mapped, from.mapped);
+	std::swap(category, from.category);
 }
 
 Helpers::Allocation &Helpers::Allocation::operator=(Allocation &&from)
@@ -30,6 +35,7 @@ Helpers::Allocation &Helpers::Allocation::operator=(Allocation &&from)
 	std::swap(size, from.size);
 	std::swap(offset, from.offset);
 	std::swap(mapped, from.mapped);
+	std::swap(category, from.category);
 
 	return *this;
 }
@@ -44,51 +50,54 @@ Helpers::Allocation::~Allocation()
 
 //----------------------------
 
-Helpers::Allocation Helpers::allocate(VkDeviceSize size, VkDeviceSize alignment, uint32_t memory_type_index, MapFlag map)
+Helpers::Allocation Helpers::allocate(VkDeviceSize size, VkDeviceSize alignment, uint32_t memory_type_index, MapFlag map, MemoryCategory category, BlockAllocator::Kind kind)
 {
 	Helpers::Allocation allocation;
 
-	VkMemoryAllocateInfo alloc_info{
-		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		.allocationSize = size,
-		.memoryTypeIndex = memory_type_index};
-
-	VK(vkAllocateMemory(rtg.device, &alloc_info, nullptr, &allocation.handle)); // 3rd parameter: custom allocator callbacks
+	BlockAllocator::Region region = block_allocator.allocate(size, alignment, memory_type_index, kind);
 
+	allocation.handle = region.memory;
+	allocation.offset = region.offset;
 	allocation.size = size;
-	allocation.offset = 0;
+	allocation.category = category;
 
 	if (map == Mapped)
 	{
-		VK(vkMapMemory(rtg.device, allocation.handle, 0, allocation.size, 0, &allocation.mapped));
+		// (host-visible blocks stay mapped for their whole lifetime, so this is just the block's mapping)
+		if (region.mapped == nullptr)
+		{
+			block_allocator.free(region.memory, region.offset);
+			throw std::runtime_error("Mapped allocation requested from memory type " + std::to_string(memory_type_index) + ", which is not host visible.");
+		}
+		allocation.mapped = region.mapped;
 	}
 
+	account(category, size, true);
+
 	return allocation;
 }
 
-Helpers::Allocation Helpers::allocate(VkMemoryRequirements const &req, VkMemoryPropertyFlags properties, MapFlag map)
+Helpers::Allocation Helpers::allocate(VkMemoryRequirements const &req, VkMemoryPropertyFlags properties, MapFlag map, MemoryCategory category, BlockAllocator::Kind kind)
 {
-	return allocate(req.size, req.alignment, find_memory_type(req.memoryTypeBits, properties), map);
+	return allocate(req.size, req.alignment, find_memory_type(req.memoryTypeBits, properties), map, category, kind);
 }
 
 void Helpers::free(Helpers::Allocation &&allocation)
 {
-	if (allocation.mapped != nullptr)
-	{
-		vkUnmapMemory(rtg.device, allocation.handle);
-		allocation.mapped = nullptr;
-	}
-
-	vkFreeMemory(rtg.device, allocation.handle, nullptr);
+	// (the block stays mapped; it is unmapped when released)
+	block_allocator.free(allocation.handle, allocation.offset);
+	account(allocation.category, allocation.size, false);
 
 	allocation.handle = VK_NULL_HANDLE;
 	allocation.offset = 0;
 	allocation.size = 0;
+	allocation.mapped = nullptr;
+	allocation.category = Other;
 }
 
 //----------------------------
 
-Helpers::AllocatedBuffer Helpers::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map)
+Helpers::AllocatedBuffer Helpers::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map, MemoryCategory category)
 {
 	AllocatedBuffer buffer;
 	VkBufferCreateInfo create_info{
@@ -105,7 +114,7 @@ Helpers::AllocatedBuffer Helpers::create_buffer(VkDeviceSize size, VkBufferUsage
 	vkGetBufferMemoryRequirements(rtg.device, buffer.handle, &req);
 
 	// allocate memory
-	buffer.allocation = allocate(req, properties, map);
+	buffer.allocation = allocate(req, properties, map, category);
 
 	// bind memory
 	VK(vkBindBufferMemory(rtg.device, buffer.handle, buffer.allocation.handle, buffer.allocation.offset));
@@ -122,7 +131,7 @@ void Helpers::destroy_buffer(AllocatedBuffer &&buffer)
 	this->free(std::move(buffer.allocation));
 }
 
-Helpers::AllocatedImage Helpers::create_image(VkExtent2D const &extent, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map)
+Helpers::AllocatedImage Helpers::create_image(VkExtent2D const &extent, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map, uint32_t mip_levels, MemoryCategory category)
 {
 	AllocatedImage image;
 	image.extent = extent;
@@ -136,7 +145,7 @@ Helpers::AllocatedImage Helpers::create_image(VkExtent2D const &extent, VkFormat
 			.width = extent.width,
 			.height = extent.height,
 			.depth = 1},
-		.mipLevels = 1,
+		.mipLevels = mip_levels,
 		.arrayLayers = 1, // number of layers in image array
 		.samples = VK_SAMPLE_COUNT_1_BIT,
 		.tiling = tiling,
@@ -149,7 +158,7 @@ Helpers::AllocatedImage Helpers::create_image(VkExtent2D const &extent, VkFormat
 	VkMemoryRequirements req;
 	vkGetImageMemoryRequirements(rtg.device, image.handle, &req);
 
-	image.allocation = allocate(req, properties, map);
+	image.allocation = allocate(req, properties, map, category, tiling == VK_IMAGE_TILING_OPTIMAL ? BlockAllocator::Optimal : BlockAllocator::Linear);
 
 	VK(vkBindImageMemory(rtg.device, image.handle, image.allocation.handle, image.allocation.offset));
 
@@ -167,185 +176,551 @@ void Helpers::destroy_image(AllocatedImage &&image)
 	this->free(std::move(image.allocation));
 }
 
+Helpers::AllocatedImage Helpers::create_transient_attachment(VkExtent2D const &extent, VkFormat format, VkImageUsageFlags usage)
+{
+	// (TRANSIENT_ATTACHMENT may only be combined with attachment usages)
+	VkImageUsageFlags const attachment_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+	bool transient = (usage & ~attachment_usage) == 0;
+
+	AllocatedImage image;
+	image.extent = extent;
+	image.format = format;
+
+	VkImageCreateInfo create_info{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.imageType = VK_IMAGE_TYPE_2D,
+		.format = format,
+		.extent{
+			.width = extent.width,
+			.height = extent.height,
+			.depth = 1},
+		.mipLevels = 1,
+		.arrayLayers = 1,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.usage = usage | (transient ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0),
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+	VK(vkCreateImage(rtg.device, &create_info, nullptr, &image.handle));
+
+	VkMemoryRequirements req;
+	vkGetImageMemoryRequirements(rtg.device, image.handle, &req);
+
+	// lazily allocated memory, if some type of it can hold the image (a transient image in ordinary memory is fine too):
+	VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	for (uint32_t i = 0; transient && i < memory_properties.memoryTypeCount; ++i)
+	{
+		if ((req.memoryTypeBits & (1 << i)) && (memory_properties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))
+		{
+			properties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+			break;
+		}
+	}
+
+	if (rtg.configuration.debug)
+	{
+		std::cout << "[Helpers] (Memory) " << extent.width << "x" << extent.height << " " << string_VkFormat(format) << " attachment: "
+				  << (properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT ? "transient, lazily allocated." : transient ? "transient, no lazily allocated memory for it." : "not transient (needs more than attachment usage).") << std::endl;
+	}
+
+	if (properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+	{ // memory of its own, just the image's size (a block of lazily allocated memory would be committed by whatever else
+	  //  landed in it, and would hold 64 MiB of address space for one attachment):
+		BlockAllocator::Region region = block_allocator.allocate_dedicated(req.size, find_memory_type(req.memoryTypeBits, properties));
+		image.allocation.handle = region.memory;
+		image.allocation.offset = region.offset;
+		image.allocation.size = req.size;
+		image.allocation.category = Attachments;
+		account(Attachments, req.size, true);
+	}
+	else
+	{
+		image.allocation = allocate(req, properties, Unmapped, Attachments, BlockAllocator::Optimal);
+	}
+
+	VK(vkBindImageMemory(rtg.device, image.handle, image.allocation.handle, image.allocation.offset));
+
+	return image;
+}
+
 //----------------------------
 
-void Helpers::transfer_to_buffer(void *data, size_t size, AllocatedBuffer &target)
+void Helpers::account(MemoryCategory category, VkDeviceSize bytes, bool allocated)
 {
+	assert(category < CategoryCount);
+	CategoryUsage &usage = memory_usage[category];
+	if (allocated)
+	{
+		usage.bytes += bytes;
+		usage.count += 1;
+	}
+	else
+	{
+		assert(usage.bytes >= bytes && usage.count > 0);
+		usage.bytes -= bytes;
+		usage.count -= 1;
+	}
+}
 
-	AllocatedBuffer transfer_src = create_buffer(
-		size,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host visible memory, coherent (no special sync needed)
-		Mapped);
+char const *Helpers::category_name(MemoryCategory category)
+{
+	switch (category)
+	{
+	case Other:
+		return "other";
+	case Meshes:
+		return "meshes";
+	case Textures:
+		return "textures";
+	case Workspace:
+		return "workspaces";
+	case Attachments:
+		return "attachments";
+	case Staging:
+		return "staging";
+	default:
+		return "?";
+	}
+}
 
-	// copy data to transfer buffer
-	std::memcpy(transfer_src.allocation.data(), data, size);
+std::vector<Helpers::HeapBudget> Helpers::query_memory_budget() const
+{
+	std::vector<HeapBudget> heaps(memory_properties.memoryHeapCount);
 
-	// record CPU->GPU transfer to command buffer
+	if (rtg.memory_budget)
 	{
-		VK(vkResetCommandBuffer(transfer_command_buffer, 0));
-
-		VkCommandBufferBeginInfo begin_info{
-			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT // record again every submit
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+		};
+		VkPhysicalDeviceMemoryProperties2 properties{
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+			.pNext = &budget,
 		};
+		vkGetPhysicalDeviceMemoryProperties2(rtg.physical_device, &properties);
 
-		VK(vkBeginCommandBuffer(transfer_command_buffer, &begin_info));
+		for (uint32_t i = 0; i < heaps.size(); ++i)
+		{
+			heaps[i].budget = budget.heapBudget[i];
+			heaps[i].usage = budget.heapUsage[i];
+		}
+	}
+	else
+	{ // no budget from the driver; the whole heap (shared with everyone else, so optimistic) and what we hold of it:
+		for (uint32_t i = 0; i < heaps.size(); ++i)
+		{
+			heaps[i].budget = memory_properties.memoryHeaps[i].size;
+			heaps[i].usage = block_allocator.stats().heap_bytes[i];
+		}
+	}
+
+	for (uint32_t i = 0; i < heaps.size(); ++i)
+	{
+		heaps[i].size = memory_properties.memoryHeaps[i].size;
+		heaps[i].device_local = (memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+	}
+
+	return heaps;
+}
 
-		VkBufferCopy copy_region{
-			.srcOffset = 0,
-			.dstOffset = 0,
-			.size = size};
+void Helpers::log_memory() const
+{
+	constexpr double MiB = 1024.0 * 1024.0;
 
-		vkCmdCopyBuffer(transfer_command_buffer, transfer_src.handle, target.handle, 1, &copy_region);
+	std::ostringstream line;
+	line << std::fixed << std::setprecision(1);
+	line << "[Helpers] (Memory)";
 
-		VK(vkEndCommandBuffer(transfer_command_buffer));
+	std::vector<HeapBudget> heaps = query_memory_budget();
+	for (uint32_t i = 0; i < heaps.size(); ++i)
+	{
+		HeapBudget const &heap = heaps[i];
+		line << " heap " << i << (heap.device_local ? " (device)" : " (host)") << ": "
+			 << heap.usage / MiB << " / " << heap.budget / MiB << " MiB";
+		if (heap.usage > heap.budget / 10 * 9)
+			line << " [near budget]";
+		line << ";";
 	}
 
-	// run command buffer
+	BlockAllocator::Stats const &stats = block_allocator.stats();
+	line << " ours: " << (stats.block_bytes + stats.dedicated_bytes) / MiB << " MiB (" << stats.used_bytes / MiB << " MiB in use);";
+
+	for (uint32_t c = 0; c < CategoryCount; ++c)
 	{
-		VkSubmitInfo submit_info{
-			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-			.commandBufferCount = 1,
-			.pCommandBuffers = &transfer_command_buffer};
-		VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
+		CategoryUsage const &usage = memory_usage[c];
+		line << " " << category_name(MemoryCategory(c)) << " " << usage.bytes / MiB << " MiB (" << usage.count << ")"
+			 << (c + 1 < CategoryCount ? "," : ".");
 	}
 
-	// wait for command buffer to finish
-	VK(vkQueueWaitIdle(rtg.graphics_queue));
+	std::cout << line.str() << std::endl;
+}
+
+//----------------------------
 
-	// destroy to avoid buffer memory leaking
-	destroy_buffer(std::move(transfer_src));
+void Helpers::track_movable(AllocatedBuffer *buffer, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, std::function<void()> moved)
+{
+	assert(buffer != nullptr);
+	assert((usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) && (usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT));
+	movables[buffer] = Movable{.buffer = buffer, .usage = usage, .properties = properties, .moved = std::move(moved)};
 }
 
-void Helpers::transfer_to_image(void *data, size_t size, AllocatedImage &target)
+void Helpers::track_movable(AllocatedImage *image, VkImageUsageFlags usage, uint32_t mip_levels, std::function<void()> moved)
 {
-	assert(target.handle); // target image should be allocated already
+	assert(image != nullptr);
+	assert((usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) && (usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT));
+	movables[image] = Movable{.image = image, .usage = usage, .properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, .mip_levels = mip_levels, .moved = std::move(moved)};
+}
 
-	// check data is the right size [new]
-	size_t bytes_per_pixel = vkuFormatElementSize(target.format);
-	assert(size == target.extent.width * target.extent.height * bytes_per_pixel);
+void Helpers::track_relocatable(AllocatedBuffer *buffer, std::function<void()> relocate)
+{
+	assert(buffer != nullptr);
+	movables[buffer] = Movable{.buffer = buffer, .relocate = std::move(relocate)};
+}
+
+void Helpers::untrack_movable(void const *resource)
+{
+	auto found = movables.find(resource);
+	if (found == movables.end())
+		return;
+
+	for (DefragMove &move : defrag.moves)
+	{
+		if (move.resource != resource)
+			continue;
+		if (move.buffer.handle != VK_NULL_HANDLE || move.image.handle != VK_NULL_HANDLE)
+		{
+			VK(vkQueueWaitIdle(rtg.graphics_queue)); // (the copy may be in flight)
+			if (move.buffer.handle != VK_NULL_HANDLE)
+				destroy_buffer(std::move(move.buffer));
+			else
+				destroy_image(std::move(move.image));
+		}
+		move.resource = nullptr;
+	}
+	movables.erase(found);
+}
+
+float Helpers::fragmentation() const
+{
+	BlockAllocator::Stats const &stats = block_allocator.stats();
+	if (stats.block_bytes == 0)
+		return 0.0f;
+	return 1.0f - float(double(stats.used_bytes) / double(stats.block_bytes));
+}
 
-	// create a host-coherent source buffer
-	AllocatedBuffer transfer_src = create_buffer(
-		size,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		Mapped);
+void Helpers::defragment(bool idle)
+{
+	if (defrag_bytes_per_frame == 0)
+		return;
+
+	if (defrag.settle_frames > 0)
+	{ // (a committed pass is reported once buffers that moved themselves have been retired by their owners)
+		defrag.settle_frames -= 1;
+		if (defrag.settle_frames == 0)
+		{
+			std::cout << "[Helpers] (Defrag) Moved " << defrag.moved_count << " resources (" << defrag.moved_bytes / 1024 << " KiB); fragmentation "
+					  << std::fixed << std::setprecision(1) << 100.0f * defrag.before << "% over " << defrag.blocks_before << " blocks -> "
+					  << 100.0f * fragmentation() << "% over " << block_allocator.stats().block_count << " blocks." << std::defaultfloat << std::endl;
+		}
+		return;
+	}
+
+	if (!idle)
+		return;
+
+	if (defrag.moves.empty())
+	{
+		defrag.idle_frames += 1;
+		if (defrag.idle_frames < DefragInterval)
+			return;
+		defrag.idle_frames = 0;
+		begin_defrag_pass();
+	}
+	else if (defrag.recorded < defrag.moves.size())
+	{
+		record_defrag_moves();
+	}
+	else
+	{
+		commit_defrag_pass();
+	}
+}
+
+void Helpers::begin_defrag_pass()
+{
+	// bytes of each block held by movable resources:
+	std::unordered_map<BlockAllocator::Block const *, VkDeviceSize> movable_bytes;
+	for (auto const &[resource, movable] : movables)
+	{
+		Allocation const &allocation = movable_allocation(movable);
+		auto found = block_allocator.block_of.find(allocation.handle);
+		if (found == block_allocator.block_of.end())
+			continue; // (dedicated memory, or nothing allocated)
+
+		BlockAllocator::Block const &block = *found->second;
+		auto live = block.live.find(allocation.offset);
+		assert(live != block.live.end());
+		movable_bytes[&block] += BlockAllocator::MinNodeSize << live->second.order;
+	}
+
+	// drain sparse blocks that hold nothing but movable resources, emptiest first, while the rest of the pool has room
+	//  for what they hold (by bytes; buddy splits may still need a new block now and then):
+	uint32_t draining = 0;
+	for (BlockAllocator::Pool &pool : block_allocator.pools)
+	{
+		if (pool.blocks.size() < 2)
+			continue;
+
+		std::vector<BlockAllocator::Block *> sparse;
+		VkDeviceSize room = 0;
+		for (std::unique_ptr<BlockAllocator::Block> &block : pool.blocks)
+		{
+			room += pool.block_size - block->used;
+			auto found = movable_bytes.find(block.get());
+			if (block->used > 0 && block->used <= VkDeviceSize(defrag_sparse_threshold * double(pool.block_size)) && found != movable_bytes.end() && found->second == block->used)
+				sparse.emplace_back(block.get());
+		}
+		std::sort(sparse.begin(), sparse.end(), [](BlockAllocator::Block const *a, BlockAllocator::Block const *b)
+				  { return a->used < b->used; });
+
+		VkDeviceSize moving = 0;
+		for (BlockAllocator::Block *block : sparse)
+		{
+			VkDeviceSize room_left = room - (pool.block_size - block->used); // (a drained block is no destination)
+			if (moving + block->used > room_left)
+				break;
+			room = room_left;
+			moving += block->used;
+			block->draining = true;
+			draining += 1;
+		}
+	}
+	if (draining == 0)
+		return;
 
-	// copy image data into the source buffer
-	std::memcpy(transfer_src.allocation.data(), data, size);
+	defrag.before = fragmentation();
+	defrag.blocks_before = block_allocator.stats().block_count;
+	for (auto const &[resource, movable] : movables)
+	{
+		Allocation const &allocation = movable_allocation(movable);
+		auto found = block_allocator.block_of.find(allocation.handle);
+		if (found != block_allocator.block_of.end() && found->second->draining)
+			defrag.moves.emplace_back(DefragMove{.resource = resource, .bytes = allocation.size});
+	}
 
-	// begin recording a command buffer
-	VK(vkResetCommandBuffer(transfer_command_buffer, 0));
+	if (rtg.configuration.debug)
+	{
+		VkDeviceSize bytes = 0;
+		for (DefragMove const &move : defrag.moves)
+		{
+			bytes += move.bytes;
+		}
+		std::cout << "[Helpers] (Defrag) Draining " << draining << " sparse blocks: " << defrag.moves.size() << " resources, " << bytes / 1024 << " KiB." << std::endl;
+	}
+}
+
+void Helpers::record_defrag_moves()
+{
+	if (defrag.used_command_buffers == defrag.command_buffers.size())
+	{
+		VkCommandBufferAllocateInfo alloc_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.commandPool = defrag.command_pool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1,
+		};
+		defrag.command_buffers.emplace_back(VK_NULL_HANDLE);
+		VK(vkAllocateCommandBuffers(rtg.device, &alloc_info, &defrag.command_buffers.back()));
+	}
+	VkCommandBuffer command_buffer = defrag.command_buffers[defrag.used_command_buffers++];
 
 	VkCommandBufferBeginInfo begin_info{
 		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, // will record again every submit
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
 	};
+	VK(vkBeginCommandBuffer(command_buffer, &begin_info));
 
-	VK(vkBeginCommandBuffer(transfer_command_buffer, &begin_info));
+	VkDeviceSize spent = 0;
+	while (defrag.recorded < defrag.moves.size())
+	{
+		DefragMove &move = defrag.moves[defrag.recorded];
+		if (spent > 0 && spent + move.bytes > defrag_bytes_per_frame)
+			break;
+		defrag.recorded += 1;
+		spent += move.bytes;
+
+		if (move.resource == nullptr)
+			continue; // (untracked since the pass started)
+		Movable &movable = movables.at(move.resource);
+
+		if (movable.relocate)
+		{ // (the owner copies, and retires its old buffer, on its own)
+			movable.relocate();
+			continue;
+		}
 
-	//
-	VkImageSubresourceRange whole_image{
-		.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-		.baseMipLevel = 0,
-		.levelCount = 1,
-		.baseArrayLayer = 0,
-		.layerCount = 1,
-	};
+		if (movable.buffer)
+		{
+			AllocatedBuffer const &from = *movable.buffer;
+			move.buffer = create_buffer(from.size, movable.usage, movable.properties, Unmapped, from.allocation.category);
 
-	{ // put the receiving image in destination-optimal layout [new]
-		VkImageMemoryBarrier barrier{
-			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-			.srcAccessMask = 0,
-			.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-			.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED, // throw away old image
-			.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-			.image = target.handle,
-			.subresourceRange = whole_image,
-		};
+			VkBufferCopy region{.srcOffset = 0, .dstOffset = 0, .size = from.size};
+			vkCmdCopyBuffer(command_buffer, from.handle, move.buffer.handle, 1, &region);
+			continue;
+		}
 
-		vkCmdPipelineBarrier(
-			transfer_command_buffer,		   // commandBuffer
-			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, // srcStageMask
-			VK_PIPELINE_STAGE_TRANSFER_BIT,	   // dstStageMask
-			0,								   // dependencyFlags
-			0, nullptr,						   // memory barrier count, pointer
-			0, nullptr,						   // buffer memory barrier count, pointer
-			1, &barrier						   // image memory barrier count, pointer
-		);
-	};
+		AllocatedImage const &from = *movable.image;
+		move.image = create_image(from.extent, from.format, VK_IMAGE_TILING_OPTIMAL, movable.usage, movable.properties, Unmapped, movable.mip_levels, from.allocation.category);
 
-	{ // copy the source buffer to the image [new]
-		VkBufferImageCopy region{
-			.bufferOffset = 0,
-			.bufferRowLength = target.extent.width,
-			.bufferImageHeight = target.extent.height,
-			.imageSubresource{
-				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-				.mipLevel = 0,
-				.baseArrayLayer = 0,
-				.layerCount = 1,
+		VkImageSubresourceRange whole_image{
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.baseMipLevel = 0,
+			.levelCount = movable.mip_levels,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		};
+		std::array<VkImageMemoryBarrier, 2> barriers{
+			VkImageMemoryBarrier{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = 0, // (only ever read)
+				.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = from.handle,
+				.subresourceRange = whole_image,
+			},
+			VkImageMemoryBarrier{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = 0,
+				.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = move.image.handle,
+				.subresourceRange = whole_image,
 			},
-			.imageOffset{.x = 0, .y = 0, .z = 0},
-			.imageExtent{
-				.width = target.extent.width,
-				.height = target.extent.height,
-				.depth = 1},
 		};
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, uint32_t(barriers.size()), barriers.data());
 
-		vkCmdCopyBufferToImage(
-			transfer_command_buffer,
-			transfer_src.handle,
-			target.handle,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			1, &region);
-
-		// NOTE: if image had mip levels, would need to copy as additional regions here.
-	};
+		std::vector<VkImageCopy> regions(movable.mip_levels);
+		for (uint32_t level = 0; level < movable.mip_levels; ++level)
+		{
+			VkImageSubresourceLayers layers{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = level, .baseArrayLayer = 0, .layerCount = 1};
+			regions[level] = VkImageCopy{
+				.srcSubresource = layers,
+				.srcOffset = {0, 0, 0},
+				.dstSubresource = layers,
+				.dstOffset = {0, 0, 0},
+				.extent = {std::max(from.extent.width >> level, 1u), std::max(from.extent.height >> level, 1u), 1},
+			};
+		}
+		vkCmdCopyImage(command_buffer, from.handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, move.image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, uint32_t(regions.size()), regions.data());
+
+		// both go back to shader-read (frames until the pass commits still sample the original):
+		barriers[0].srcAccessMask = 0;
+		barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, uint32_t(barriers.size()), barriers.data());
+	}
 
-	{ // transition the image memory to shader-read-only-optimal layout [new]
-		VkImageMemoryBarrier barrier{
-			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+	{ // copied buffers are visible to whatever reads them once swapped in:
+		VkMemoryBarrier barrier{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
 			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-			.image = target.handle,
-			.subresourceRange = whole_image,
+			.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
 		};
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
 
-		vkCmdPipelineBarrier(
-			transfer_command_buffer,			   // commandBuffer
-			VK_PIPELINE_STAGE_TRANSFER_BIT,		   // srcStageMask
-			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, // dstStageMask
-			0,									   // dependencyFlags
-			0, nullptr,							   // memory barrier count, pointer
-			0, nullptr,							   // buffer memory barrier count, pointer
-			1, &barrier							   // image memory barrier count, pointer
-		);
-	};
-
-	// end and submit the command buffer
-	VK(vkEndCommandBuffer(transfer_command_buffer));
+	VK(vkEndCommandBuffer(command_buffer));
 
+	// (ahead of this frame's work in the queue, so the copies are done once this frame's value on rtg.frames is reached;
+	//  commit_defrag_pass waits for a frame at least that new before using them)
 	VkSubmitInfo submit_info{
 		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
 		.commandBufferCount = 1,
-		.pCommandBuffers = &transfer_command_buffer};
-
+		.pCommandBuffers = &command_buffer,
+	};
 	VK(vkQueueSubmit(rtg.graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
+}
 
-	// wait for command buffer to finish executing
-	VK(vkQueueWaitIdle(rtg.graphics_queue));
+void Helpers::commit_defrag_pass()
+{
+	// copies are done, and so is every frame that bound the originals, once the newest submitted frame is
+	//  (descriptor sets such frames used can't be rewritten until then; RTG::run calls this after handing out the
+	//  frame it is about to render, which hasn't recorded anything yet, and after at least one frame since the copies):
+	rtg.frames.wait(rtg.frames.submitted - 1);
+
+	defrag.moved_count = 0;
+	defrag.moved_bytes = 0;
+	for (DefragMove &move : defrag.moves)
+	{
+		if (move.resource == nullptr)
+			continue;
+		Movable &movable = movables.at(move.resource);
+		defrag.moved_count += 1;
+		defrag.moved_bytes += move.bytes;
+		if (movable.relocate)
+			continue;
+
+		if (movable.buffer)
+			std::swap(*movable.buffer, move.buffer);
+		else
+			std::swap(*movable.image, move.image);
+
+		if (movable.moved)
+			movable.moved();
+
+		// (freeing the last piece of a drained block releases the block)
+		if (movable.buffer)
+			destroy_buffer(std::move(move.buffer));
+		else
+			destroy_image(std::move(move.image));
+	}
+	defrag.moves.clear();
+	defrag.recorded = 0;
+
+	for (BlockAllocator::Pool &pool : block_allocator.pools)
+	{
+		for (std::unique_ptr<BlockAllocator::Block> &block : pool.blocks)
+		{
+			block->draining = false; // (blocks emptied by relocations are released when their owners retire them)
+		}
+	}
 
-	// destroy the source buffer
-	destroy_buffer(std::move(transfer_src));
+	VK(vkResetCommandPool(rtg.device, defrag.command_pool, 0));
+	defrag.used_command_buffers = 0;
+
+	defrag.settle_frames = uint32_t(rtg.workspaces.size()) + 1;
+}
+
+//----------------------------
+
+UploadBatcher::Ticket Helpers::transfer_to_buffer(void *data, size_t size, AllocatedBuffer &target)
+{
+	assert(target.handle); // target buffer should be allocated already
+	assert(size <= target.size);
+
+	return uploads.upload_buffer(data, size, target.handle);
+}
+
+UploadBatcher::Ticket Helpers::transfer_to_image(void *data, size_t size, AllocatedImage &target)
+{
+	assert(target.handle); // target image should be allocated already
+
+	// check data is the right size [new]
+	size_t bytes_per_pixel = vkuFormatElementSize(target.format);
+	assert(size == target.extent.width * target.extent.height * bytes_per_pixel);
+
+	return uploads.upload_image(data, size, target.handle, target.extent, bytes_per_pixel);
 }
 
 //----------------------------
@@ -404,20 +779,41 @@ Helpers::~Helpers()
 
 void Helpers::create()
 {
-	VkCommandPoolCreateInfo create_info{// resources made with create and destroy are long-lived
-										.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-										.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-										.queueFamilyIndex = rtg.graphics_queue_family.value()};
-	VK(vkCreateCommandPool(rtg.device, &create_info, nullptr, &transfer_command_pool));
+	vkGetPhysicalDeviceMemoryProperties(rtg.physical_device, &memory_properties);
+	vkGetPhysicalDeviceProperties(rtg.physical_device, &physical_device_properties);
 
-	VkCommandBufferAllocateInfo alloc_info{// resources made with alloc and free are short-lived, can be changed each frame
-										   .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-										   .commandPool = transfer_command_pool,
-										   .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-										   .commandBufferCount = 1};
-	VK(vkAllocateCommandBuffers(rtg.device, &alloc_info, &transfer_command_buffer));
+	block_allocator.create(rtg.device, memory_properties, physical_device_properties.limits.bufferImageGranularity, rtg.configuration.debug);
 
-	vkGetPhysicalDeviceMemoryProperties(rtg.physical_device, &memory_properties);
+	staging.create(*this);
+	uploads.create(*this);
+
+	defrag_bytes_per_frame = VkDeviceSize(double(rtg.configuration.defrag) * 1024.0 * 1024.0);
+	{ // copies made by defragmentation run on the graphics queue:
+		VkCommandPoolCreateInfo create_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, // (the whole pool is reset when a pass commits)
+			.queueFamilyIndex = rtg.graphics_queue_family.value()};
+		VK(vkCreateCommandPool(rtg.device, &create_info, nullptr, &defrag.command_pool));
+	}
+
+	{ // look for memory the CPU can stream into and the GPU reads at full speed:
+		VkMemoryPropertyFlags flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		VkDeviceSize bar_window = VkDeviceSize(256) * 1024 * 1024; // without resizable BAR only this much of VRAM is host visible
+		for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i)
+		{
+			VkMemoryType const &type = memory_properties.memoryTypes[i];
+			if ((type.propertyFlags & flags) == flags && memory_properties.memoryHeaps[type.heapIndex].size > bar_window)
+			{
+				streaming_memory_type = i;
+				break;
+			}
+		}
+
+		if (streaming_memory_type != UINT32_MAX)
+			std::cout << "[Helpers] (Device Memory) Streamed data is read in place (memory type " << streaming_memory_type << ")." << std::endl;
+		else
+			std::cout << "[Helpers] (Device Memory) Streamed data is copied to device-local memory." << std::endl;
+	}
 
 	if (rtg.configuration.debug)
 	{
@@ -439,15 +835,26 @@ void Helpers::create()
 
 void Helpers::destroy()
 {
-	if (transfer_command_buffer != VK_NULL_HANDLE)
+	// (the device is idle by now, so copies of a pass underway are done)
+	for (DefragMove &move : defrag.moves)
 	{
-		vkFreeCommandBuffers(rtg.device, transfer_command_pool, 1, &transfer_command_buffer);
-		transfer_command_buffer = VK_NULL_HANDLE;
+		if (move.buffer.handle != VK_NULL_HANDLE)
+			destroy_buffer(std::move(move.buffer));
+		if (move.image.handle != VK_NULL_HANDLE)
+			destroy_image(std::move(move.image));
 	}
-
-	if (transfer_command_pool != VK_NULL_HANDLE)
+	defrag.moves.clear();
+	movables.clear();
+	if (defrag.command_pool != VK_NULL_HANDLE)
 	{
-		vkDestroyCommandPool(rtg.device, transfer_command_pool, nullptr);
-		transfer_command_pool = VK_NULL_HANDLE;
+		// (this also frees the command buffers allocated from it)
+		vkDestroyCommandPool(rtg.device, defrag.command_pool, nullptr);
+		defrag.command_pool = VK_NULL_HANDLE;
+		defrag.command_buffers.clear();
 	}
+
+	uploads.destroy();
+	staging.destroy();
+
+	block_allocator.destroy();
 }
@@ -1,8 +1,16 @@
 #pragma once
 
+#include "Source/VkMemory/BlockAllocator.hpp"
+#include "Source/VkMemory/StagingPool.hpp"
+#include "Source/VkMemory/UploadBatcher.hpp"
+
 #include <vulkan/vulkan_core.h>
 #include <vulkan/utility/vk_format_utils.h>
 
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
 #include <vector>
 
 struct RTG;
@@ -13,6 +21,18 @@ struct Helpers
 	//-----------------------
 	// memory allocation:
 
+	// what an allocation is for (only used for accounting; see memory_usage and log_memory):
+	enum MemoryCategory : uint8_t
+	{
+		Other = 0,
+		Meshes,		 // vertex (and index) data
+		Textures,	 // sampled images
+		Workspace,	 // per-workspace buffers (uniforms, streamed instances, culling buffers)
+		Attachments, // depth and other render targets
+		Staging,	 // upload staging buffers
+		CategoryCount
+	};
+
 	// An owning reference to (part of) a slab of device memory:
 	struct Allocation
 	{
@@ -20,6 +40,7 @@ struct Helpers
 		VkDeviceSize offset = 0; // offset of the allocated object inside the memory
 		VkDeviceSize size = 0;	 // size of the allocated object inside the memory (might be *larger* than the internal size of the object!)
 		void *mapped = nullptr;
+		MemoryCategory category = Other; // (not part of being "empty")
 		void *data() const { return reinterpret_cast<char *>(mapped) + offset; } // get pointer to beginning of allocation, taking offset into account
 
 		// Call an all-zero (no handle, offset, size, mapped) Allocation "empty":
@@ -36,14 +57,18 @@ struct Helpers
 	};
 
 	// allocate a block of requested size and alighment from a memory with the given type index
-	Allocation allocate(VkDeviceSize size, VkDeviceSize alighment, uint32_t memory_type_index, MapFlag map = Unmapped);
+	//  (suballocated from a larger block; kind says whether it will hold an optimal-tiling image, see BlockAllocator)
+	Allocation allocate(VkDeviceSize size, VkDeviceSize alighment, uint32_t memory_type_index, MapFlag map = Unmapped, MemoryCategory category = Other, BlockAllocator::Kind kind = BlockAllocator::Linear);
 
 	// allocate a block that works for a given VkMemoryRequirements and VkMemoryPropertyFlags
-	Allocation allocate(VkMemoryRequirements const &requirements, VkMemoryPropertyFlags memory_properties, MapFlag map = Unmapped);
+	Allocation allocate(VkMemoryRequirements const &requirements, VkMemoryPropertyFlags memory_properties, MapFlag map = Unmapped, MemoryCategory category = Other, BlockAllocator::Kind kind = BlockAllocator::Linear);
 
 	// free an allocated block
 	void free(Allocation &&allocation);
 
+	// where allocations come from (stats() reports blocks, pieces, and the peak device memory use):
+	BlockAllocator block_allocator;
+
 	// specializations that also create a buffer or image (respectively):
 	struct AllocatedBuffer
 	{
@@ -53,7 +78,7 @@ struct Helpers
 
 		// NOTE: could define default constructor, move constructor, move assignment, destructor for a bit more paranoia
 	};
-	AllocatedBuffer create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map = Unmapped);
+	AllocatedBuffer create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map = Unmapped, MemoryCategory category = Other);
 	void destroy_buffer(AllocatedBuffer &&allocated_buffer);
 
 	struct AllocatedImage
@@ -65,18 +90,82 @@ struct Helpers
 
 		// NOTE: could define default constructor, move constructor, move assignment, destructor for a bit more paranoia
 	};
-	AllocatedImage create_image(VkExtent2D const &extent, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map = Unmapped);
+	AllocatedImage create_image(VkExtent2D const &extent, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map = Unmapped, uint32_t mip_levels = 1, MemoryCategory category = Other);
 	void destroy_image(AllocatedImage &&allocated_image);
 
+	// attachment that only lives inside render passes (not loaded, not stored): created TRANSIENT_ATTACHMENT in lazily
+	//  allocated memory where the device has a type for it (tile-based GPUs may then never back it with real memory),
+	//  as an allocation of its own sized to the image rather than a piece of a shared block. If usage needs more than
+	//  attachment bits (e.g. SAMPLED, when a pass does store it), or there is no lazily allocated memory, it is an
+	//  ordinary device-local image instead. Destroy with destroy_image.
+	AllocatedImage create_transient_attachment(VkExtent2D const &extent, VkFormat format, VkImageUsageFlags usage);
+
+	//-----------------------
+	// memory accounting:
+
+	// live allocations per category (kept by allocate/free; the staging pool reports its buffers through account()):
+	struct CategoryUsage
+	{
+		VkDeviceSize bytes = 0;
+		uint32_t count = 0;
+	};
+	std::array<CategoryUsage, CategoryCount> memory_usage{};
+	void account(MemoryCategory category, VkDeviceSize bytes, bool allocated);
+	static char const *category_name(MemoryCategory category);
+
+	// per-heap use against the budget: from VK_EXT_memory_budget when rtg.memory_budget is set (usage then counts
+	//  every process on the device), otherwise the heap's size and what block_allocator holds in it:
+	struct HeapBudget
+	{
+		VkDeviceSize size = 0;
+		VkDeviceSize budget = 0;
+		VkDeviceSize usage = 0;
+		bool device_local = false;
+	};
+	std::vector<HeapBudget> query_memory_budget() const;
+
+	// one "[Helpers] (Memory)" line with the above (RTG::run calls this every `--memory-report` seconds):
+	void log_memory() const;
+
+	//-----------------------
+	// defragmentation:
+
+	// Resources the defragmentation pass may move out of sparse blocks. Buffers and images (color, optimal tiling,
+	//  device local, in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL between frames) are copied by the pass, so their usage
+	//  must include TRANSFER_SRC and TRANSFER_DST, and their contents must not change while tracked; once the copy is
+	//  swapped in (the tracked object now holds the new handle), moved() lets the owner fix up what refers to it.
+	//  Relocatable buffers are instead asked to move themselves (relocate(), e.g. MeshPool compacting into a new buffer).
+	void track_movable(AllocatedBuffer *buffer, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, std::function<void()> moved);
+	void track_movable(AllocatedImage *image, VkImageUsageFlags usage, uint32_t mip_levels, std::function<void()> moved);
+	void track_relocatable(AllocatedBuffer *buffer, std::function<void()> relocate);
+	void untrack_movable(void const *resource); // before destroying it (drops its move if a pass is underway)
+
+	// once per frame, before the frame's work is queued (RTG::run calls this; idle means the frame uploads nothing):
+	//  every DefragInterval idle frames, finds blocks at most defrag_sparse_threshold full that hold only movable
+	//  resources; then, on idle frames, copies up to defrag_bytes_per_frame of them out on the graphics queue; once all
+	//  are copied, waits for every submitted frame on rtg.frames (so moved() may rewrite descriptors frames in flight
+	//  used), swaps the copies in, and frees the originals, which releases the emptied blocks. Logs fragmentation()
+	//  before and after.
+	void defragment(bool idle);
+
+	float fragmentation() const; // share of block memory not holding live pieces
+
+	static constexpr uint32_t DefragInterval = 300;
+	VkDeviceSize defrag_bytes_per_frame = 0; // 0 turns defragmentation off (`--defrag <MiB>`)
+	float defrag_sparse_threshold = 0.5f;
+
 	//-----------------------
 	// CPU -> GPU data transfer:
 
-	// NOTE: synchronizes *hard* against the GPU; inefficient to use for streaming data!
-	void transfer_to_buffer(void *data, size_t size, AllocatedBuffer &target);
-	void transfer_to_image(void *data, size_t size, AllocatedImage &image); // NOTE: image layout after call is VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	// NOTE: asynchronous; data is staged right away (so it can be freed after the call) and the copy is batched in uploads,
+	//  which RTG::run flushes before each frame. Use uploads.wait() on the returned ticket before destroying the target.
+	UploadBatcher::Ticket transfer_to_buffer(void *data, size_t size, AllocatedBuffer &target);
+	UploadBatcher::Ticket transfer_to_image(void *data, size_t size, AllocatedImage &image); // NOTE: image layout after the upload is VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+
+	UploadBatcher uploads;
 
-	VkCommandPool transfer_command_pool = VK_NULL_HANDLE;
-	VkCommandBuffer transfer_command_buffer = VK_NULL_HANDLE;
+	// staging buffers for uploads and per-frame streaming (stats() reports the high-water mark):
+	StagingPool staging;
 
 	//-----------------------
 	// Misc utilities:
@@ -85,6 +174,14 @@ struct Helpers
 	VkPhysicalDeviceMemoryProperties memory_properties{};
 	uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags property_flags) const;
 
+	// device-local, host-visible, coherent memory type in a heap big enough to stream per-frame data into
+	//  (resizable BAR or unified memory), so the GPU can read what the CPU writes in place; UINT32_MAX if there is none
+	//  (no such type, or only the small 256MiB BAR window):
+	uint32_t streaming_memory_type = UINT32_MAX;
+
+	// device limits (buffer offset alignments and such):
+	VkPhysicalDeviceProperties physical_device_properties{};
+
 	// for selecting image formats:
 	VkFormat find_image_format(std::vector<VkFormat> const &candidates, VkImageTiling tiling, VkFormatFeatureFlags features) const;
 
@@ -107,4 +204,43 @@ struct Helpers
 	// used to synchronize create/destroy with RTG:
 	void create();	// create vulkan resources (after GPU-held handles are created)
 	void destroy(); // destroy vulkan resources (before GPU-held handles are destroyed)
+
+	struct Movable
+	{
+		AllocatedBuffer *buffer = nullptr; // (one of buffer, image)
+		AllocatedImage *image = nullptr;
+		VkFlags usage = 0;
+		VkMemoryPropertyFlags properties = 0;
+		uint32_t mip_levels = 1;
+		std::function<void()> moved;	// (copied resources)
+		std::function<void()> relocate; // (relocatable buffers)
+	};
+	std::unordered_map<void const *, Movable> movables;
+
+	struct DefragMove
+	{
+		void const *resource = nullptr; // (nullptr once untracked)
+		VkDeviceSize bytes = 0;
+		AllocatedBuffer buffer; // the copy; after the swap, the original (until freed)
+		AllocatedImage image;
+	};
+	struct Defrag
+	{
+		std::vector<DefragMove> moves; // of the pass underway
+		size_t recorded = 0;		   // moves before this are copied (or relocated)
+		uint32_t idle_frames = 0;	   // since the last look for sparse blocks
+		uint32_t settle_frames = 0;	   // frames until the committed pass is reported (relocated buffers retire meanwhile)
+		float before = 0.0f;		   // fragmentation() when the pass started
+		uint32_t blocks_before = 0;
+		uint32_t moved_count = 0;
+		VkDeviceSize moved_bytes = 0;
+		VkCommandPool command_pool = VK_NULL_HANDLE;  // graphics queue family; reset when a pass commits
+		std::vector<VkCommandBuffer> command_buffers; // one per frame of copies
+		size_t used_command_buffers = 0;
+	} defrag;
+
+	void begin_defrag_pass();
+	void record_defrag_moves();
+	void commit_defrag_pass();
+	Allocation const &movable_allocation(Movable const &movable) const { return movable.buffer ? movable.buffer->allocation : movable.image->allocation; }
 };
@@ -0,0 +1,363 @@
+#include "Source/VkMemory/MeshPool.hpp"
+
+#include "Source/Configuration/RTG.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <iterator>
+#include <utility>
+
+void MeshPool::create(Helpers &helpers, VkDeviceSize vertex_size_, uint32_t capacity_)
+{
+	assert(buffer.handle == VK_NULL_HANDLE);
+	assert(vertex_size_ > 0);
+
+	vertex_size = vertex_size_;
+	frames = &helpers.rtg.frames;
+	capacity = 0;
+	used = 0;
+	frame = 0;
+	last_rebuild_frame = 0;
+
+	free_ranges.clear();
+	if (capacity_ > 0)
+	{
+		rebuild(helpers, capacity_); // (nothing to move yet)
+	}
+}
+
+void MeshPool::destroy(Helpers &helpers)
+{
+	// (the device is idle by now, so buffers waiting on frames in flight are done too)
+	for (Move &move : moves)
+	{
+		if (move.source.handle != VK_NULL_HANDLE)
+		{
+			helpers.destroy_buffer(std::move(move.source));
+		}
+	}
+	moves.clear();
+	for (Retired &r : retired)
+	{
+		helpers.destroy_buffer(std::move(r.buffer));
+	}
+	retired.clear();
+
+	if (buffer.handle != VK_NULL_HANDLE)
+	{
+		helpers.destroy_buffer(std::move(buffer));
+	}
+	free_ranges.clear();
+	pending_frees.clear();
+	slots.clear();
+	free_slots.clear();
+	capacity = 0;
+	used = 0;
+}
+
+//----------------------------
+
+MeshPool::Mesh MeshPool::add_mesh(Helpers &helpers, void const *vertices, uint32_t count, UploadBatcher::Ticket *ticket)
+{
+	if (ticket)
+		*ticket = 0;
+
+	uint32_t first = allocate(count);
+	if (first == NoSpace)
+	{
+		// vertices that a rebuild would leave free (pending frees are dropped by it: frames in flight read the old buffer):
+		uint32_t pending = 0;
+		for (PendingFree const &p : pending_frees)
+		{
+			pending += p.range.count;
+		}
+		uint64_t needed = uint64_t(used - pending) + count;
+
+		if (needed <= capacity && frame >= last_rebuild_frame + CompactionInterval)
+		{
+			// compacting makes room (and it has been a while since the last copy of the whole pool):
+			rebuild(helpers, capacity);
+		}
+		else if (capacity < max_capacity && needed <= max_capacity)
+		{
+			uint64_t grown = std::max(uint64_t(capacity) * 2, needed);
+			rebuild(helpers, uint32_t(std::min(grown, uint64_t(max_capacity))));
+		}
+		else
+		{
+			return NoMesh;
+		}
+		first = allocate(count);
+		assert(first != NoSpace);
+	}
+
+	Mesh mesh;
+	if (!free_slots.empty())
+	{
+		mesh = free_slots.back();
+		free_slots.pop_back();
+	}
+	else
+	{
+		mesh = Mesh(slots.size());
+		slots.emplace_back();
+	}
+	slots[mesh] = Slot{.range = Range{.first = first, .count = count}, .live = true};
+
+	if (count > 0)
+	{
+		// (buffer is live -- frames in flight draw other meshes from it -- so the upload must not move it to another queue family)
+		UploadBatcher::Ticket uploaded = helpers.uploads.upload_buffer(vertices, count * vertex_size, buffer.handle, first * vertex_size, true);
+		if (ticket)
+			*ticket = uploaded;
+	}
+	return mesh;
+}
+
+void MeshPool::remove_mesh(Mesh mesh, bool drawn_in_flight)
+{
+	assert(mesh < slots.size() && slots[mesh].live);
+
+	Range range = slots[mesh].range;
+	slots[mesh] = Slot{};
+	free_slots.emplace_back(mesh);
+
+	if (drawn_in_flight && range.count > 0)
+	{
+		// (the newest frame handed out -- the one being recorded, if any -- may still draw it)
+		pending_frees.emplace_back(PendingFree{.range = range, .value = frames->submitted});
+	}
+	else
+	{
+		free(range);
+	}
+}
+
+//----------------------------
+
+void MeshPool::begin_frame(Helpers &helpers)
+{
+	frame += 1;
+
+	for (size_t i = 0; i < pending_frees.size();)
+	{
+		if (!frames->reached(pending_frees[i].value))
+		{
+			++i;
+			continue;
+		}
+		free(pending_frees[i].range);
+		pending_frees[i] = pending_frees.back();
+		pending_frees.pop_back();
+	}
+
+	for (size_t i = 0; i < retired.size();)
+	{
+		if (!frames->reached(retired[i].value))
+		{
+			++i;
+			continue;
+		}
+		helpers.destroy_buffer(std::move(retired[i].buffer));
+		retired[i] = std::move(retired.back());
+		retired.pop_back();
+	}
+
+	// compact (now and then) when at least a quarter of the pool is free but no single range holds half of that:
+	if (capacity == 0 || frame < last_rebuild_frame + CompactionInterval || !pending_frees.empty())
+		return;
+	uint32_t free_count = capacity - used;
+	if (free_count < capacity / 4 || largest_free() >= free_count / 2)
+		return;
+
+	if (helpers.rtg.configuration.debug)
+	{
+		std::cout << "[Helpers] (Mesh Pool) Compacting " << used << " vertices in " << free_ranges.size() + 1 << " pieces (largest free range "
+				  << largest_free() << " of " << free_count << " free vertices)." << std::endl;
+	}
+	rebuild(helpers, capacity);
+}
+
+void MeshPool::record_moves(VkCommandBuffer command_buffer)
+{
+	for (Move &move : moves)
+	{
+		if (!move.regions.empty())
+		{
+			vkCmdCopyBuffer(command_buffer, move.source.handle, move.target, uint32_t(move.regions.size()), move.regions.data());
+
+			// copies land before later copies out of the target (a rebuild in the same frame) and before vertex fetch:
+			VkBufferMemoryBarrier barrier{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.buffer = move.target,
+				.offset = 0,
+				.size = VK_WHOLE_SIZE,
+			};
+			vkCmdPipelineBarrier(command_buffer,
+								 VK_PIPELINE_STAGE_TRANSFER_BIT,
+								 VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+								 0,
+								 0, nullptr,
+								 1, &barrier,
+								 0, nullptr);
+		}
+
+		if (move.source.handle != VK_NULL_HANDLE)
+		{
+			// this frame (and frames in flight before it) may still read the old buffer:
+			retired.emplace_back(Retired{.buffer = std::move(move.source), .value = frames->submitted});
+		}
+	}
+	moves.clear();
+}
+
+uint32_t MeshPool::largest_free() const
+{
+	uint32_t largest = 0;
+	for (auto const &[first, count] : free_ranges)
+	{
+		largest = std::max(largest, count);
+	}
+	return largest;
+}
+
+//----------------------------
+
+uint32_t MeshPool::allocate(uint32_t count)
+{
+	if (count == 0)
+		return 0;
+
+	for (auto it = free_ranges.begin(); it != free_ranges.end(); ++it)
+	{
+		if (it->second < count)
+			continue;
+
+		uint32_t first = it->first;
+		uint32_t left = it->second - count;
+		free_ranges.erase(it);
+		if (left > 0)
+		{
+			free_ranges.emplace(first + count, left);
+		}
+		used += count;
+		return first;
+	}
+	return NoSpace;
+}
+
+void MeshPool::free(Range range)
+{
+	uint32_t first = range.first;
+	uint32_t count = range.count;
+	if (count == 0)
+		return;
+
+	assert(first + count <= capacity);
+	assert(used >= count);
+	used -= count;
+
+	auto next = free_ranges.lower_bound(first);
+	assert(next == free_ranges.end() || next->first >= first + count); // (not already free)
+
+	// merge with the free range after,
+	if (next != free_ranges.end() && next->first == first + count)
+	{
+		count += next->second;
+		next = free_ranges.erase(next);
+	}
+	// and the one before:
+	if (next != free_ranges.begin())
+	{
+		auto prev = std::prev(next);
+		assert(prev->first + prev->second <= first);
+		if (prev->first + prev->second == first)
+		{
+			prev->second += count;
+			return;
+		}
+	}
+	free_ranges.emplace_hint(next, first, count);
+}
+
+void MeshPool::rebuild(Helpers &helpers, uint32_t new_capacity)
+{
+	// uploads still in the current batch write the old buffer; submit them so they land before the frame that moves them:
+	helpers.uploads.flush();
+
+	Move move;
+	move.source = std::move(buffer);
+	buffer = Helpers::AllocatedBuffer{};
+	if (new_capacity > 0)
+	{
+		buffer = helpers.create_buffer(
+			new_capacity * vertex_size,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // vertex buffer; copied into by uploads, out of and into by rebuilds
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			Helpers::Unmapped,
+			Helpers::Meshes);
+	}
+	move.target = buffer.handle;
+
+	// pack live meshes to the front, keeping their order (so neighbours stay merged into one copy):
+	std::vector<Mesh> order;
+	order.reserve(slots.size());
+	for (Mesh mesh = 0; mesh < slots.size(); ++mesh)
+	{
+		if (slots[mesh].live && slots[mesh].range.count > 0)
+			order.emplace_back(mesh);
+	}
+	std::sort(order.begin(), order.end(), [this](Mesh a, Mesh b)
+			  { return slots[a].range.first < slots[b].range.first; });
+
+	uint32_t head = 0;
+	for (Mesh mesh : order)
+	{
+		Range &range = slots[mesh].range;
+		assert(head + range.count <= new_capacity);
+
+		VkDeviceSize src = range.first * vertex_size;
+		VkDeviceSize dst = head * vertex_size;
+		VkDeviceSize size = range.count * vertex_size;
+		if (!move.regions.empty() && move.regions.back().srcOffset + move.regions.back().size == src)
+		{
+			move.regions.back().size += size;
+		}
+		else
+		{
+			move.regions.emplace_back(VkBufferCopy{.srcOffset = src, .dstOffset = dst, .size = size});
+		}
+
+		range.first = head;
+		head += range.count;
+	}
+
+	// removed ranges still read by frames in flight live on in the old buffer only:
+	pending_frees.clear();
+	free_ranges.clear();
+	if (head < new_capacity)
+	{
+		free_ranges.emplace(head, new_capacity - head);
+	}
+
+	if (helpers.rtg.configuration.debug && capacity > 0)
+	{
+		std::cout << "[Helpers] (Mesh Pool) Rebuilt " << capacity << " -> " << new_capacity << " vertices; moving " << head << " vertices in "
+				  << move.regions.size() << " copies." << std::endl;
+	}
+
+	capacity = new_capacity;
+	used = head;
+	generation += 1;
+	last_rebuild_frame = frame;
+
+	if (move.source.handle != VK_NULL_HANDLE || !move.regions.empty())
+	{
+		moves.emplace_back(std::move(move));
+	}
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "Source/VkMemory/Helpers.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+/*
+ * Vertex storage for meshes that come and go at runtime: one device-local vertex buffer, handed out in ranges of whole
+ *  vertices (first-fit from a list of free ranges, coalesced on free), so each mesh draws with its own firstVertex.
+ *
+ *  MeshPool::Mesh mesh = pool.add_mesh(helpers, vertices, count); // uploaded through helpers.uploads
+ *  ...
+ *  pool.begin_frame(helpers);           // every frame, once the frame's workspace is available
+ *  pool.record_moves(command_buffer);   // before anything in the frame draws from pool.buffer
+ *  MeshPool::Range range = pool.range(mesh);
+ *  vkCmdDraw(command_buffer, range.count, 1, range.first, 0);
+ *  ...
+ *  pool.remove_mesh(mesh);
+ *
+ * When no free range fits a new mesh, the pool is rebuilt into a new buffer: the same size if compacting makes room
+ *  (at most once every CompactionInterval frames), else bigger (doubling, up to max_capacity). Live meshes are packed to
+ *  the front of the new buffer by GPU copies that record_moves() puts in the next recorded frame; the old buffer is
+ *  destroyed once the frames that may still read it are done (so record them into a command buffer submitted once, not
+ *  one that is kept and re-submitted). begin_frame() also compacts now and then when the free
+ *  space is badly fragmented. Meshes keep their handles across rebuilds, but not their ranges: generation changes
+ *  whenever ranges move, so re-read range() (and re-record anything that bound pool.buffer) when it does.
+ *
+ * Removed ranges (and retired buffers) are stamped with the newest frame on rtg.frames (the frame timeline) and only
+ *  reused (destroyed) once the GPU reaches it -- as soon as that frame is done, not a fixed number of frames later --
+ *  unless remove_mesh() is told no frame in flight draws the mesh.
+ */
+struct MeshPool
+{
+	using Mesh = uint32_t; // handle; stays valid until remove_mesh
+	static constexpr Mesh NoMesh = -1U;
+
+	static constexpr uint32_t NoSpace = -1U;
+	static constexpr uint32_t CompactionInterval = 600; // frames between fragmentation-driven compactions (at least)
+
+	struct Range
+	{
+		uint32_t first = 0; // first vertex in buffer
+		uint32_t count = 0;
+	};
+
+	Helpers::AllocatedBuffer buffer; // VERTEX_BUFFER | TRANSFER_SRC | TRANSFER_DST, device-local
+	VkDeviceSize vertex_size = 0;	 // bytes per vertex
+	uint32_t capacity = 0;			 // vertices in buffer
+	uint32_t max_capacity = -1U;	 // growth stops here (add_mesh fails instead)
+	uint32_t used = 0;				 // vertices in live meshes and in removed ranges not reusable yet
+	uint64_t generation = 0;		 // bumped whenever ranges move (and buffer changes)
+
+	void create(Helpers &helpers, VkDeviceSize vertex_size, uint32_t capacity);
+	void destroy(Helpers &helpers);
+
+	// place and upload count vertices (graphics work after the next uploads.flush() sees them; ticket gets the upload's
+	//  ticket, 0 if there was nothing to upload); NoMesh if neither compacting nor growing makes room right now:
+	Mesh add_mesh(Helpers &helpers, void const *vertices, uint32_t count, UploadBatcher::Ticket *ticket = nullptr);
+	// drawn_in_flight: frames still in flight may draw the mesh (if false, the range is reusable right away)
+	void remove_mesh(Mesh mesh, bool drawn_in_flight = true);
+
+	Range range(Mesh mesh) const { return slots[mesh].range; }
+
+	void begin_frame(Helpers &helpers);				   // releases what frames in flight no longer read; may compact
+	void record_moves(VkCommandBuffer command_buffer); // copies from rebuilds (nothing if there weren't any)
+	bool has_moves() const { return !moves.empty(); }  // record_moves() has copies to record
+
+	uint32_t largest_free() const; // biggest mesh that fits without a rebuild
+
+	//-----------------------
+	// internals:
+
+	Timeline *frames = nullptr;		 // helpers.rtg.frames
+	uint64_t frame = 0;				 // begin_frame() calls
+	uint64_t last_rebuild_frame = 0;
+
+	struct Slot
+	{
+		Range range;
+		bool live = false;
+	};
+	std::vector<Slot> slots; // [Mesh]
+	std::vector<Mesh> free_slots;
+
+	std::map<uint32_t, uint32_t> free_ranges; // first vertex -> vertex count (never adjacent; they are merged)
+
+	struct PendingFree
+	{
+		Range range;
+		uint64_t value = 0; // reusable once frames reaches it
+	};
+	std::vector<PendingFree> pending_frees;
+
+	struct Move
+	{
+		Helpers::AllocatedBuffer source; // previous buffer (retired once the copies are recorded)
+		VkBuffer target = VK_NULL_HANDLE;
+		std::vector<VkBufferCopy> regions;
+	};
+	std::vector<Move> moves; // rebuilds not recorded yet, oldest first
+
+	struct Retired
+	{
+		Helpers::AllocatedBuffer buffer;
+		uint64_t value = 0; // last frame that may read it (destroyed once frames reaches it)
+	};
+	std::vector<Retired> retired;
+
+	uint32_t allocate(uint32_t count); // first vertex of a free range (count == 0 always succeeds, with 0), or NoSpace
+	void free(Range range);
+	void rebuild(Helpers &helpers, uint32_t new_capacity); // pack live meshes into a new buffer of new_capacity vertices
+};
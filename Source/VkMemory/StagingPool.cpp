@@ -0,0 +1,179 @@
+#include "Source/VkMemory/StagingPool.hpp"
+
+#include "Source/Configuration/RTG.hpp"
+#include "Source/Helper/VK.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <iostream>
+
+void StagingPool::create(Helpers &helpers_)
+{
+	assert(helpers == nullptr);
+
+	helpers = &helpers_;
+	verbose = helpers->rtg.configuration.debug;
+	stats_ = Stats{};
+}
+
+void StagingPool::destroy()
+{
+	if (helpers == nullptr)
+		return;
+
+	if (stats_.in_use_bytes != 0)
+	{
+		// not fatal, just sloppy, so complain but don't throw:
+		std::cerr << "[Helpers] (Staging) " << stats_.in_use_bytes << " bytes of staging buffers still acquired; they will leak." << std::endl;
+	}
+
+	if (verbose)
+	{
+		std::cout << "[Helpers] (Staging) High-water mark: " << stats_.high_water_bytes << " bytes (" << stats_.created << " buffers made, "
+				  << stats_.reused << " acquires served by reuse)." << std::endl;
+	}
+
+	// (the device is idle by now, so parked buffers are done too)
+	for (Parked &p : parked)
+	{
+		destroy_buffer(std::move(p.buffer));
+	}
+	parked.clear();
+
+	for (std::vector<Buffer> &buffers : free_buffers)
+	{
+		for (Buffer &buffer : buffers)
+		{
+			destroy_buffer(std::move(buffer));
+		}
+		buffers.clear();
+	}
+
+	helpers = nullptr;
+}
+
+//----------------------------
+
+StagingPool::Buffer StagingPool::acquire(VkDeviceSize size)
+{
+	assert(helpers != nullptr);
+	assert(size > 0);
+
+	collect();
+
+	VkDeviceSize class_size = std::bit_ceil(std::max(size, MinClassSize));
+	uint32_t size_class = uint32_t(std::countr_zero(class_size / MinClassSize));
+
+	Buffer buffer;
+	if (size_class < ClassCount && !free_buffers[size_class].empty())
+	{ // reuse an idle one:
+		buffer = std::move(free_buffers[size_class].back());
+		free_buffers[size_class].pop_back();
+
+		stats_.free_bytes -= buffer.size;
+		stats_.reused += 1;
+	}
+	else
+	{ // make another (unpooled sizes are rounded to 4k, just to keep odd sizes off the allocator):
+		VkDeviceSize buffer_size = size_class < ClassCount ? class_size : (size + 4095) / 4096 * 4096;
+
+		// (copied from on the transfer queue by upload batches, and on the graphics queue by per-frame streaming and live
+		//  uploads, so shared by both families when they differ)
+		RTG const &rtg = helpers->rtg;
+		std::array<uint32_t, 2> queue_families{rtg.transfer_queue_family.value(), rtg.graphics_queue_family.value()};
+		bool shared = queue_families[0] != queue_families[1];
+
+		VkDevice device = rtg.device;
+		VkBufferCreateInfo create_info{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = buffer_size,
+			.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			.sharingMode = shared ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+			.queueFamilyIndexCount = shared ? uint32_t(queue_families.size()) : 0,
+			.pQueueFamilyIndices = shared ? queue_families.data() : nullptr,
+		};
+		VK(vkCreateBuffer(device, &create_info, nullptr, &buffer.handle));
+		buffer.size = buffer_size;
+
+		VkMemoryRequirements req;
+		vkGetBufferMemoryRequirements(device, buffer.handle, &req);
+
+		uint32_t memory_type = helpers->find_memory_type(req.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		buffer.memory = helpers->block_allocator.allocate(req.size, req.alignment, memory_type, BlockAllocator::Linear);
+		assert(buffer.memory.mapped != nullptr);
+
+		VK(vkBindBufferMemory(device, buffer.handle, buffer.memory.memory, buffer.memory.offset));
+		helpers->account(Helpers::Staging, buffer.size, true);
+
+		stats_.created += 1;
+	}
+
+	stats_.in_use_bytes += buffer.size;
+	stats_.high_water_bytes = std::max(stats_.high_water_bytes, stats_.in_use_bytes + stats_.pending_bytes + stats_.free_bytes);
+
+	return buffer;
+}
+
+void StagingPool::release(Buffer &&buffer, Timeline *timeline, uint64_t value)
+{
+	assert(helpers != nullptr);
+	assert(buffer.handle != VK_NULL_HANDLE);
+
+	stats_.in_use_bytes -= buffer.size;
+
+	if (timeline != nullptr && !timeline->reached(value))
+	{
+		stats_.pending_bytes += buffer.size;
+		parked.emplace_back(Parked{.buffer = std::move(buffer), .timeline = timeline, .value = value});
+	}
+	else
+	{
+		recycle(std::move(buffer));
+	}
+	buffer = Buffer{};
+}
+
+void StagingPool::collect()
+{
+	for (size_t i = 0; i < parked.size();)
+	{
+		// (a comparison with the timeline's cached counter; the GPU's is only read while that is behind)
+		if (!parked[i].timeline->reached(parked[i].value))
+		{
+			++i;
+			continue;
+		}
+
+		stats_.pending_bytes -= parked[i].buffer.size;
+		recycle(std::move(parked[i].buffer));
+
+		parked[i] = std::move(parked.back());
+		parked.pop_back();
+	}
+}
+
+//----------------------------
+
+void StagingPool::recycle(Buffer &&buffer)
+{
+	uint32_t size_class = uint32_t(std::countr_zero(buffer.size / MinClassSize));
+	bool pooled = std::has_single_bit(buffer.size) && buffer.size >= MinClassSize && size_class < ClassCount;
+
+	if (!pooled || stats_.free_bytes + buffer.size > max_free_bytes)
+	{
+		destroy_buffer(std::move(buffer));
+		return;
+	}
+
+	stats_.free_bytes += buffer.size;
+	free_buffers[size_class].emplace_back(std::move(buffer));
+}
+
+void StagingPool::destroy_buffer(Buffer &&buffer)
+{
+	vkDestroyBuffer(helpers->rtg.device, buffer.handle, nullptr);
+	helpers->block_allocator.free(buffer.memory.memory, buffer.memory.offset);
+	helpers->account(Helpers::Staging, buffer.size, false);
+	buffer = Buffer{};
+}
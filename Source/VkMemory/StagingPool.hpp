@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Source/VkMemory/BlockAllocator.hpp"
+#include "Source/VkMemory/Timeline.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+struct Helpers;
+
+/*
+ * Recycled staging buffers (host visible, coherent, persistently mapped, TRANSFER_SRC), shared by the upload batcher
+ *  and per-frame streaming:
+ *
+ *  StagingPool::Buffer staging = helpers.staging.acquire(size); // at least size bytes
+ *  std::memcpy(staging.data(), src, size);
+ *  vkCmdCopyBuffer(command_buffer, staging.handle, target, 1, &region);
+ *  helpers.staging.release(std::move(staging), &timeline, value); // reused once timeline reaches value
+ *
+ * Buffers come in power-of-two size classes (from MinClassSize up to MinClassSize << (ClassCount - 1)), so a released
+ *  buffer fits later requests of any size in its class. Larger requests get a buffer of their own that is destroyed on
+ *  release. At most max_free_bytes of idle buffers are kept; anything released beyond that is destroyed.
+ *
+ * release() with a timeline value parks the buffer until collect() sees the timeline reach it (collect() runs on every
+ *  acquire); without one the caller vouches the GPU is done with it.
+ */
+struct StagingPool
+{
+	static constexpr VkDeviceSize MinClassSize = 64ull * 1024;
+	static constexpr uint32_t ClassCount = 11; // 64KiB .. 64MiB
+	static constexpr VkDeviceSize DefaultMaxFreeBytes = 64ull * 1024 * 1024;
+
+	struct Buffer
+	{
+		VkBuffer handle = VK_NULL_HANDLE;
+		VkDeviceSize size = 0; // bytes in the buffer (the whole size class; at least what was asked for)
+		BlockAllocator::Region memory;
+		void *data() const { return reinterpret_cast<char *>(memory.mapped) + memory.offset; }
+	};
+
+	Buffer acquire(VkDeviceSize size);
+	void release(Buffer &&buffer, Timeline *timeline = nullptr, uint64_t value = 0);
+
+	void collect(); // recycle parked buffers whose timeline values are reached
+
+	VkDeviceSize max_free_bytes = DefaultMaxFreeBytes;
+
+	struct Stats
+	{
+		VkDeviceSize in_use_bytes = 0;	   // acquired, not yet released
+		VkDeviceSize pending_bytes = 0;	   // released with a timeline value that hasn't been seen reached
+		VkDeviceSize free_bytes = 0;	   // idle, ready for reuse
+		VkDeviceSize high_water_bytes = 0; // most staging memory ever held at once
+		uint64_t created = 0;			   // buffers made
+		uint64_t reused = 0;			   // acquires served from idle buffers
+	};
+	Stats const &stats() const { return stats_; }
+
+	//-----------------------
+	// internals:
+
+	// used to synchronize create/destroy with Helpers:
+	void create(Helpers &helpers);
+	void destroy(); // destroys every buffer (complains about buffers still acquired)
+
+	Helpers *helpers = nullptr;
+	bool verbose = false; // report the high-water mark on destroy
+
+	std::array<std::vector<Buffer>, ClassCount> free_buffers; // [size class]
+	struct Parked
+	{
+		Buffer buffer;
+		Timeline *timeline = nullptr;
+		uint64_t value = 0; // reusable once timeline reaches it
+	};
+	std::vector<Parked> parked;
+	Stats stats_;
+
+	void recycle(Buffer &&buffer); // to free_buffers, or destroyed if unpooled / over max_free_bytes
+	void destroy_buffer(Buffer &&buffer);
+};
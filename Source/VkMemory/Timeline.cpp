@@ -0,0 +1,67 @@
+#include "Source/VkMemory/Timeline.hpp"
+
+#include "Source/Helper/VK.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+void Timeline::create(VkDevice device_, uint64_t initial)
+{
+	assert(semaphore == VK_NULL_HANDLE);
+
+	device = device_;
+	submitted = completed = initial;
+
+	VkSemaphoreTypeCreateInfo type_info{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue = initial,
+	};
+	VkSemaphoreCreateInfo create_info{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = &type_info,
+	};
+	VK(vkCreateSemaphore(device, &create_info, nullptr, &semaphore));
+}
+
+void Timeline::destroy()
+{
+	if (semaphore != VK_NULL_HANDLE)
+	{
+		vkDestroySemaphore(device, semaphore, nullptr);
+		semaphore = VK_NULL_HANDLE;
+	}
+	device = VK_NULL_HANDLE;
+	submitted = completed = 0;
+}
+
+uint64_t Timeline::poll()
+{
+	assert(semaphore != VK_NULL_HANDLE);
+
+	uint64_t value = 0;
+	VK(vkGetSemaphoreCounterValue(device, semaphore, &value));
+	completed = std::max(completed, value);
+	return completed;
+}
+
+bool Timeline::reached(uint64_t value)
+{
+	return value <= completed || poll() >= value;
+}
+
+void Timeline::wait(uint64_t value)
+{
+	if (value <= completed)
+		return;
+	assert(value <= submitted); // (nothing will ever signal a value not handed out yet)
+
+	VkSemaphoreWaitInfo wait_info{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+		.semaphoreCount = 1,
+		.pSemaphores = &semaphore,
+		.pValues = &value,
+	};
+	VK(vkWaitSemaphores(device, &wait_info, UINT64_MAX));
+	completed = std::max(completed, value);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+
+/*
+ * A timeline semaphore (Vulkan 1.2) and the values handed out on it: each submit that finishes a unit of work (a frame,
+ *  an upload batch) signals the next value, so whether that work is done is just a comparison with the GPU's counter.
+ *
+ *  uint64_t value = timeline.next();           // signal this from the submit (VkTimelineSemaphoreSubmitInfo)
+ *  ...
+ *  if (timeline.reached(value)) { recycle(); } // poll,
+ *  timeline.wait(value);                       // or block
+ *
+ * Values only ever grow, so anything stamped with a value is free once the counter reaches it -- no fence per submit to
+ *  reset, and no waiting for a whole queue to go idle.
+ */
+struct Timeline
+{
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	uint64_t submitted = 0; // newest value handed out by next() (its submit will signal it)
+	uint64_t completed = 0; // newest value the GPU was seen to reach (refreshed by poll / reached / wait)
+
+	void create(VkDevice device, uint64_t initial = 0);
+	void destroy();
+
+	uint64_t next() { return ++submitted; }
+
+	uint64_t poll();			  // read the GPU's counter into completed
+	bool reached(uint64_t value); // has the GPU signaled value (or a later one)?
+	void wait(uint64_t value);	  // block until reached(value)
+
+	//-----------------------
+	// internals:
+
+	VkDevice device = VK_NULL_HANDLE;
+};
@@ -0,0 +1,527 @@
+#include "Source/VkMemory/UploadBatcher.hpp"
+
+#include "Source/Configuration/RTG.hpp"
+#include "Source/Helper/VK.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+void UploadBatcher::create(Helpers &helpers_)
+{
+	assert(helpers == nullptr);
+
+	helpers = &helpers_;
+	RTG const &rtg = helpers->rtg;
+
+	verbose = rtg.configuration.debug;
+	separate_family = rtg.transfer_queue_family.value() != rtg.graphics_queue_family.value();
+	staged_bytes = 0;
+
+	{ // command pools for the queue(s) batches run on:
+		VkCommandPoolCreateInfo create_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+			.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, // batches' command buffers are re-recorded on reuse
+			.queueFamilyIndex = rtg.transfer_queue_family.value()};
+		VK(vkCreateCommandPool(rtg.device, &create_info, nullptr, &transfer_pool));
+
+		if (separate_family)
+		{
+			create_info.queueFamilyIndex = rtg.graphics_queue_family.value();
+			VK(vkCreateCommandPool(rtg.device, &create_info, nullptr, &acquire_pool));
+		}
+	}
+
+	done.create(rtg.device);
+	if (separate_family)
+	{
+		transferred.create(rtg.device);
+	}
+}
+
+void UploadBatcher::destroy()
+{
+	if (helpers == nullptr)
+		return;
+
+	VkDevice device = helpers->rtg.device;
+
+	while (!in_flight.empty())
+	{
+		wait_oldest();
+	}
+	if (recording)
+	{
+		// (never submitted; its staging goes straight back, and its command buffers go with the pools)
+		for (StagingPool::Buffer &buffer : recording->staging)
+		{
+			helpers->staging.release(std::move(buffer));
+		}
+		recording->staging.clear();
+		idle.emplace_back(std::move(recording));
+	}
+
+	idle.clear();
+
+	transferred.destroy();
+	done.destroy();
+
+	// (this also frees the batches' command buffers)
+	if (acquire_pool != VK_NULL_HANDLE)
+	{
+		vkDestroyCommandPool(device, acquire_pool, nullptr);
+		acquire_pool = VK_NULL_HANDLE;
+	}
+	if (transfer_pool != VK_NULL_HANDLE)
+	{
+		vkDestroyCommandPool(device, transfer_pool, nullptr);
+		transfer_pool = VK_NULL_HANDLE;
+	}
+
+	helpers = nullptr;
+}
+
+//----------------------------
+
+UploadBatcher::Ticket UploadBatcher::upload_buffer(void const *data, VkDeviceSize size, VkBuffer target, VkDeviceSize target_offset, bool live)
+{
+	assert(helpers != nullptr);
+
+	char const *src = reinterpret_cast<char const *>(data);
+	for (VkDeviceSize uploaded = 0; uploaded < size;)
+	{
+		VkDeviceSize piece = std::min(size - uploaded, MaxPieceSize);
+		Staged staged = reserve(piece);
+		std::memcpy(staged.data, src + uploaded, piece);
+
+		Batch &batch = begin_batch();
+
+		VkBufferCopy copy_region{
+			.srcOffset = staged.offset,
+			.dstOffset = target_offset + uploaded,
+			.size = piece};
+		// (a live target stays with the graphics queue family: handing it over would need a release there first)
+		bool on_graphics = live && separate_family;
+		vkCmdCopyBuffer(on_graphics ? batch.acquire_commands : batch.transfer_commands, staged.buffer, target, 1, &copy_region);
+
+		// (access masks and queue families are filled in by flush)
+		(on_graphics ? batch.live_writes : batch.buffer_handoffs).emplace_back(VkBufferMemoryBarrier{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+			.buffer = target,
+			.offset = target_offset + uploaded,
+			.size = piece,
+		});
+		batch.bytes += piece;
+
+		uploaded += piece;
+	}
+
+	return recording ? recording->ticket : done.submitted;
+}
+
+UploadBatcher::Ticket UploadBatcher::upload_image(void const *data, VkDeviceSize size, VkImage target, VkExtent2D extent, VkDeviceSize texel_size)
+{
+	assert(helpers != nullptr);
+	assert(size == VkDeviceSize(extent.width) * extent.height * texel_size);
+	assert(CopyAlignment % texel_size == 0); // (staging offsets must be a multiple of the texel size)
+
+	VkDeviceSize row_bytes = VkDeviceSize(extent.width) * texel_size;
+	assert(row_bytes <= MaxPieceSize);
+
+	VkImageSubresourceRange whole_image{
+		.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+		.baseMipLevel = 0,
+		.levelCount = 1,
+		.baseArrayLayer = 0,
+		.layerCount = 1,
+	};
+
+	// rows go in pieces of up to MaxPieceSize; the image stays in TRANSFER_DST (and on the transfer queue) until its last piece:
+	char const *src = reinterpret_cast<char const *>(data);
+	for (uint32_t row = 0; row < extent.height;)
+	{
+		uint32_t rows = uint32_t(std::min<VkDeviceSize>(extent.height - row, MaxPieceSize / row_bytes));
+		VkDeviceSize piece = rows * row_bytes;
+		Staged staged = reserve(piece);
+		std::memcpy(staged.data, src + row * row_bytes, piece);
+
+		Batch &batch = begin_batch();
+
+		if (row == 0)
+		{ // put the receiving image in destination-optimal layout:
+			VkImageMemoryBarrier barrier{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = 0,
+				.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED, // throw away old image
+				.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = target,
+				.subresourceRange = whole_image,
+			};
+
+			vkCmdPipelineBarrier(
+				batch.transfer_commands,		   // commandBuffer
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, // srcStageMask
+				VK_PIPELINE_STAGE_TRANSFER_BIT,	   // dstStageMask
+				0,								   // dependencyFlags
+				0, nullptr,						   // memory barrier count, pointer
+				0, nullptr,						   // buffer memory barrier count, pointer
+				1, &barrier						   // image memory barrier count, pointer
+			);
+		}
+
+		VkBufferImageCopy region{
+			.bufferOffset = staged.offset,
+			.bufferRowLength = extent.width,
+			.bufferImageHeight = rows,
+			.imageSubresource{
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.mipLevel = 0,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+			.imageOffset{.x = 0, .y = int32_t(row), .z = 0},
+			.imageExtent{
+				.width = extent.width,
+				.height = rows,
+				.depth = 1},
+		};
+		vkCmdCopyBufferToImage(batch.transfer_commands, staged.buffer, target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		batch.bytes += piece;
+
+		row += rows;
+		if (row == extent.height)
+		{
+			// (access masks and queue families are filled in by flush)
+			batch.image_handoffs.emplace_back(VkImageMemoryBarrier{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				.image = target,
+				.subresourceRange = whole_image,
+			});
+		}
+	}
+
+	return recording ? recording->ticket : done.submitted;
+}
+
+UploadBatcher::Ticket UploadBatcher::flush()
+{
+	if (!recording)
+		return done.submitted;
+
+	RTG const &rtg = helpers->rtg;
+	Batch &batch = *recording;
+
+	// the batch signals its ticket on done (the next value, since batches are submitted in order):
+	[[maybe_unused]] uint64_t done_value = done.next();
+	assert(done_value == batch.ticket);
+
+	if (!separate_family)
+	{ // make everything written visible to later work on this queue (and move images to their shader-read layout):
+		for (VkBufferMemoryBarrier &barrier : batch.buffer_handoffs)
+		{
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		}
+		for (VkImageMemoryBarrier &barrier : batch.image_handoffs)
+		{
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		}
+
+		vkCmdPipelineBarrier(
+			batch.transfer_commands,								   // commandBuffer
+			VK_PIPELINE_STAGE_TRANSFER_BIT,							   // srcStageMask
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,						   // dstStageMask
+			0,														   // dependencyFlags
+			0, nullptr,												   // memory barrier count, pointer
+			uint32_t(batch.buffer_handoffs.size()), batch.buffer_handoffs.data(), // buffer memory barrier count, pointer
+			uint32_t(batch.image_handoffs.size()), batch.image_handoffs.data()	   // image memory barrier count, pointer
+		);
+
+		VK(vkEndCommandBuffer(batch.transfer_commands));
+
+		VkTimelineSemaphoreSubmitInfo timeline_info{
+			.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+			.signalSemaphoreValueCount = 1,
+			.pSignalSemaphoreValues = &batch.ticket};
+		VkSubmitInfo submit_info{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = &timeline_info,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &batch.transfer_commands,
+			.signalSemaphoreCount = 1,
+			.pSignalSemaphores = &done.semaphore};
+		VK(vkQueueSubmit(rtg.transfer_queue, 1, &submit_info, VK_NULL_HANDLE));
+	}
+	else
+	{ // release everything written on the transfer queue, then acquire it on the graphics queue:
+		for (VkBufferMemoryBarrier &barrier : batch.buffer_handoffs)
+		{
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = 0;
+			barrier.srcQueueFamilyIndex = rtg.transfer_queue_family.value();
+			barrier.dstQueueFamilyIndex = rtg.graphics_queue_family.value();
+		}
+		for (VkImageMemoryBarrier &barrier : batch.image_handoffs)
+		{
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = 0;
+			barrier.srcQueueFamilyIndex = rtg.transfer_queue_family.value();
+			barrier.dstQueueFamilyIndex = rtg.graphics_queue_family.value();
+		}
+
+		vkCmdPipelineBarrier(
+			batch.transfer_commands,								   // commandBuffer
+			VK_PIPELINE_STAGE_TRANSFER_BIT,							   // srcStageMask
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,					   // dstStageMask
+			0,														   // dependencyFlags
+			0, nullptr,												   // memory barrier count, pointer
+			uint32_t(batch.buffer_handoffs.size()), batch.buffer_handoffs.data(), // buffer memory barrier count, pointer
+			uint32_t(batch.image_handoffs.size()), batch.image_handoffs.data()	   // image memory barrier count, pointer
+		);
+
+		VK(vkEndCommandBuffer(batch.transfer_commands));
+
+		// the acquiring half of each barrier (same families and layouts; the graphics queue's accesses):
+		for (VkBufferMemoryBarrier &barrier : batch.buffer_handoffs)
+		{
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		}
+		for (VkImageMemoryBarrier &barrier : batch.image_handoffs)
+		{
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		}
+
+		vkCmdPipelineBarrier(
+			batch.acquire_commands,									   // commandBuffer
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,						   // srcStageMask
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,						   // dstStageMask
+			0,														   // dependencyFlags
+			0, nullptr,												   // memory barrier count, pointer
+			uint32_t(batch.buffer_handoffs.size()), batch.buffer_handoffs.data(), // buffer memory barrier count, pointer
+			uint32_t(batch.image_handoffs.size()), batch.image_handoffs.data()	   // image memory barrier count, pointer
+		);
+
+		if (!batch.live_writes.empty())
+		{ // make what the live copies (recorded ahead of the acquires) wrote visible to later work on the graphics queue:
+			for (VkBufferMemoryBarrier &barrier : batch.live_writes)
+			{
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+				barrier.srcQueueFamilyIndex = barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			}
+
+			vkCmdPipelineBarrier(
+				batch.acquire_commands,									   // commandBuffer
+				VK_PIPELINE_STAGE_TRANSFER_BIT,							   // srcStageMask
+				VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,						   // dstStageMask
+				0,														   // dependencyFlags
+				0, nullptr,												   // memory barrier count, pointer
+				uint32_t(batch.live_writes.size()), batch.live_writes.data(), // buffer memory barrier count, pointer
+				0, nullptr												   // image memory barrier count, pointer
+			);
+		}
+
+		VK(vkEndCommandBuffer(batch.acquire_commands));
+
+		// (the copies signal the batch's ticket on transferred; the acquires wait for it, then signal it on done)
+		[[maybe_unused]] uint64_t transferred_value = transferred.next();
+		assert(transferred_value == batch.ticket);
+
+		VkTimelineSemaphoreSubmitInfo transfer_timeline{
+			.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+			.signalSemaphoreValueCount = 1,
+			.pSignalSemaphoreValues = &batch.ticket};
+		VkSubmitInfo transfer_submit{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = &transfer_timeline,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &batch.transfer_commands,
+			.signalSemaphoreCount = 1,
+			.pSignalSemaphores = &transferred.semaphore};
+		VK(vkQueueSubmit(rtg.transfer_queue, 1, &transfer_submit, VK_NULL_HANDLE));
+
+		VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		VkTimelineSemaphoreSubmitInfo acquire_timeline{
+			.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+			.waitSemaphoreValueCount = 1,
+			.pWaitSemaphoreValues = &batch.ticket,
+			.signalSemaphoreValueCount = 1,
+			.pSignalSemaphoreValues = &batch.ticket};
+		VkSubmitInfo acquire_submit{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = &acquire_timeline,
+			.waitSemaphoreCount = 1,
+			.pWaitSemaphores = &transferred.semaphore,
+			.pWaitDstStageMask = &wait_stage,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &batch.acquire_commands,
+			.signalSemaphoreCount = 1,
+			.pSignalSemaphores = &done.semaphore};
+		VK(vkQueueSubmit(rtg.graphics_queue, 1, &acquire_submit, VK_NULL_HANDLE));
+	}
+
+	if (verbose)
+	{
+		std::cout << "[Helpers] (Uploads) Batch " << batch.ticket << ": " << batch.bytes << " bytes, " << batch.buffer_handoffs.size() << " buffer ranges and "
+				  << batch.image_handoffs.size() << " images, on the " << (separate_family ? "transfer" : "graphics") << " queue";
+		if (!batch.live_writes.empty())
+			std::cout << " (and " << batch.live_writes.size() << " ranges of live buffers on the graphics queue)";
+		std::cout << "." << std::endl;
+	}
+
+	// staging comes back to the pool once the batch is done:
+	for (StagingPool::Buffer &buffer : batch.staging)
+	{
+		helpers->staging.release(std::move(buffer), &done, batch.ticket);
+	}
+	batch.staging.clear();
+
+	in_flight.emplace_back(std::move(recording));
+
+	return done.submitted;
+}
+
+bool UploadBatcher::finished(Ticket ticket)
+{
+	retire();
+	return done.completed >= ticket;
+}
+
+void UploadBatcher::wait(Ticket ticket)
+{
+	if (ticket > done.submitted)
+		flush();
+
+	// (one wait on the timeline covers every batch up to ticket)
+	done.wait(ticket);
+	retire();
+}
+
+//----------------------------
+
+UploadBatcher::Batch &UploadBatcher::begin_batch()
+{
+	if (recording)
+		return *recording;
+
+	VkDevice device = helpers->rtg.device;
+
+	if (!idle.empty())
+	{
+		recording = std::move(idle.back());
+		idle.pop_back();
+	}
+	else
+	{ // nothing to reuse, make another:
+		recording = std::make_unique<Batch>();
+
+		VkCommandBufferAllocateInfo alloc_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.commandPool = transfer_pool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1};
+		VK(vkAllocateCommandBuffers(device, &alloc_info, &recording->transfer_commands));
+
+		if (separate_family)
+		{
+			alloc_info.commandPool = acquire_pool;
+			VK(vkAllocateCommandBuffers(device, &alloc_info, &recording->acquire_commands));
+		}
+	}
+
+	Batch &batch = *recording;
+	batch.ticket = done.submitted + 1; // (batches are submitted in order, so this is the value flush() hands out)
+	batch.staging.clear();
+	batch.staging_head = 0;
+	batch.staging_bytes = 0;
+	batch.buffer_handoffs.clear();
+	batch.image_handoffs.clear();
+	batch.live_writes.clear();
+	batch.bytes = 0;
+
+	VkCommandBufferBeginInfo begin_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT // record again every submit
+	};
+	VK(vkBeginCommandBuffer(batch.transfer_commands, &begin_info));
+	if (separate_family)
+	{
+		VK(vkBeginCommandBuffer(batch.acquire_commands, &begin_info));
+	}
+
+	return batch;
+}
+
+UploadBatcher::Staged UploadBatcher::reserve(VkDeviceSize size)
+{
+	assert(size <= MaxPieceSize);
+
+	{ // room left in the recording batch's last staging buffer?
+		Batch &batch = begin_batch();
+		VkDeviceSize offset = (batch.staging_head + CopyAlignment - 1) & ~(CopyAlignment - 1);
+		if (!batch.staging.empty() && offset + size <= batch.staging.back().size)
+		{
+			batch.staging_head = offset + size;
+			return Staged{
+				.buffer = batch.staging.back().handle,
+				.offset = offset,
+				.data = reinterpret_cast<char *>(batch.staging.back().data()) + offset};
+		}
+	}
+
+	// another buffer is needed; first make sure batches don't hold too much staging:
+	VkDeviceSize wanted = std::max(size, ChunkSize);
+	while (staged_bytes + wanted > max_staged_bytes && staged_bytes != 0)
+	{
+		if (in_flight.empty())
+		{
+			flush(); // (the recording batch holds all of it)
+		}
+		wait_oldest();
+	}
+
+	Batch &batch = begin_batch();
+	StagingPool::Buffer &buffer = batch.staging.emplace_back(helpers->staging.acquire(wanted));
+	batch.staging_head = size;
+	batch.staging_bytes += buffer.size;
+	staged_bytes += buffer.size;
+
+	return Staged{
+		.buffer = buffer.handle,
+		.offset = 0,
+		.data = reinterpret_cast<char *>(buffer.data())};
+}
+
+void UploadBatcher::retire()
+{
+	while (!in_flight.empty())
+	{
+		if (!done.reached(in_flight.front()->ticket))
+			break;
+
+		staged_bytes -= in_flight.front()->staging_bytes;
+		in_flight.front()->staging_bytes = 0;
+
+		idle.emplace_back(std::move(in_flight.front()));
+		in_flight.pop_front();
+	}
+}
+
+void UploadBatcher::wait_oldest()
+{
+	assert(!in_flight.empty());
+
+	done.wait(in_flight.front()->ticket);
+	retire();
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Source/VkMemory/StagingPool.hpp"
+#include "Source/VkMemory/Timeline.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+struct Helpers;
+
+/*
+ * Batched, asynchronous CPU -> GPU uploads (behind Helpers::transfer_to_buffer / transfer_to_image):
+ *  data is copied into staging (from the StagingPool) right away, and the copy out of it is recorded into the current
+ *  batch, so many uploads share one command buffer and one submit. Batches are numbered in order, and batch n signals
+ *  value n on the `done` timeline semaphore when it finishes, so a ticket is simply the value to wait for.
+ *
+ *  UploadBatcher::Ticket ticket = uploads.upload_buffer(data, size, buffer, offset); // (data can be freed right after)
+ *  ...
+ *  uploads.flush();          // submit the batch; later graphics-queue work sees its results
+ *  uploads.finished(ticket); // poll,
+ *  uploads.wait(ticket);     // or block (e.g. before destroying the target)
+ *
+ * When the device has a transfer-only queue family, batches run on it and hand their targets over to the graphics
+ *  queue family (release on the transfer queue, acquire on the graphics queue, chained by the `transferred` timeline);
+ *  otherwise they run on the graphics queue. Either way, graphics-queue work submitted after flush() sees the uploaded
+ *  data, and images end in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. (Ownership moves without a release on the graphics side,
+ *  which is only valid for fresh targets; uploads into live buffers -- a range of a buffer graphics work already reads --
+ *  are recorded into the batch's graphics-queue commands instead, so the buffer never leaves the graphics queue family.)
+ *
+ * Batches stage into ChunkSize buffers (bigger pieces get a buffer to themselves), handed back to the pool with the
+ *  batch's ticket. Once batches in flight hold max_staged_bytes of staging, the current batch is submitted and the oldest
+ *  ones are waited on; uploads larger than MaxPieceSize are split into pieces.
+ */
+struct UploadBatcher
+{
+	using Ticket = uint64_t; // batch number (from 1) and its value on done; an upload is done once done reaches its ticket
+
+	static constexpr VkDeviceSize ChunkSize = 4ull * 1024 * 1024;				// staging buffers shared by small uploads
+	static constexpr VkDeviceSize MaxPieceSize = 16ull * 1024 * 1024;			// uploads are split into pieces of at most this
+	static constexpr VkDeviceSize DefaultMaxStagedBytes = 32ull * 1024 * 1024; // (keeps the staging held by batches bounded)
+	static constexpr VkDeviceSize CopyAlignment = 16;							// staging offsets (a multiple of every texel size used here)
+
+	VkDeviceSize max_staged_bytes = DefaultMaxStagedBytes;
+
+	// stage size bytes of data for target (starting at target_offset); returns the ticket of the batch that copies it
+	//  live: graphics work already uses target (copied on the graphics queue if batches run on a transfer-only family)
+	Ticket upload_buffer(void const *data, VkDeviceSize size, VkBuffer target, VkDeviceSize target_offset = 0, bool live = false);
+
+	// stage a whole single-mip color image of texel_size-byte texels (size must be extent.width * extent.height * texel_size)
+	Ticket upload_image(void const *data, VkDeviceSize size, VkImage target, VkExtent2D extent, VkDeviceSize texel_size);
+
+	// submit whatever the current batch recorded; returns the newest submitted ticket
+	Ticket flush();
+
+	bool finished(Ticket ticket); // has the batch with ticket (and every batch before it) finished?
+	void wait(Ticket ticket);	  // submit (if needed) and block until finished(ticket)
+
+	Ticket submitted() const { return done.submitted; } // newest submitted batch
+	Ticket completed() const { return done.completed; } // newest batch known to have finished
+
+	Timeline done; // batch n signals n when it is finished (graphics-queue submits can also wait on it)
+
+	//-----------------------
+	// internals:
+
+	// used to synchronize create/destroy with Helpers:
+	void create(Helpers &helpers);
+	void destroy(); // (waits for batches in flight)
+
+	Helpers *helpers = nullptr;
+	bool separate_family = false; // batches run on a transfer-only queue and hand targets over to the graphics queue
+	bool verbose = false;		  // log each batch as it is submitted
+
+	VkDeviceSize staged_bytes = 0; // staging held by the recording and in-flight batches
+
+	VkCommandPool transfer_pool = VK_NULL_HANDLE; // for the transfer queue family
+	VkCommandPool acquire_pool = VK_NULL_HANDLE;  // for the graphics queue family (only if separate_family)
+	Timeline transferred;						  // batch n's copies signal n, which its acquires wait for (only if separate_family)
+
+	struct Batch
+	{
+		VkCommandBuffer transfer_commands = VK_NULL_HANDLE; // copies (and releases, if separate_family)
+		VkCommandBuffer acquire_commands = VK_NULL_HANDLE;	// acquires and live copies on the graphics queue (only if separate_family)
+
+		Ticket ticket = 0;
+		std::vector<StagingPool::Buffer> staging;			// staged from (released to the pool, with ticket, on submit)
+		VkDeviceSize staging_head = 0;						// bytes used in staging.back()
+		VkDeviceSize staging_bytes = 0;						// size of all of staging
+		std::vector<VkBufferMemoryBarrier> buffer_handoffs; // written ranges, made visible at the end of the batch
+		std::vector<VkImageMemoryBarrier> image_handoffs;	// written images, moved to shader-read layout at the end
+		std::vector<VkBufferMemoryBarrier> live_writes;		// ranges of live targets written by acquire_commands (only if separate_family)
+		VkDeviceSize bytes = 0;
+	};
+	std::unique_ptr<Batch> recording;			   // batch being recorded (nullptr between batches)
+	std::deque<std::unique_ptr<Batch>> in_flight; // submitted, oldest first
+	std::vector<std::unique_ptr<Batch>> idle;	   // finished, ready for reuse
+
+	struct Staged
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		char *data = nullptr; // mapped pointer to offset
+	};
+	Batch &begin_batch();				// recording, starting one if needed
+	Staged reserve(VkDeviceSize size);	// staging space for size bytes in the recording batch (submitting / waiting as needed)
+	void retire();		// move finished batches from in_flight to idle
+	void wait_oldest(); // block until the oldest batch in flight is finished
+};
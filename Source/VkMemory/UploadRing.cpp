@@ -0,0 +1,101 @@
+#include "Source/VkMemory/UploadRing.hpp"
+
+#include "Source/Configuration/RTG.hpp"
+#include "Source/Helper/VK.hpp"
+
+#include <cassert>
+#include <utility>
+
+void UploadRing::create(Helpers &helpers, VkDeviceSize size, VkBufferUsageFlags usage)
+{
+	assert(host.handle == VK_NULL_HANDLE && device.handle == VK_NULL_HANDLE);
+
+	if (helpers.streaming_memory_type != UINT32_MAX)
+	{
+		// one buffer in memory both sides can reach; the GPU reads what the CPU wrote in place:
+		VkBufferCreateInfo create_info{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = size,
+			.usage = usage,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE, // only used by one queue family
+		};
+		VK(vkCreateBuffer(helpers.rtg.device, &create_info, nullptr, &host.handle));
+		host.size = size;
+
+		VkMemoryRequirements req;
+		vkGetBufferMemoryRequirements(helpers.rtg.device, host.handle, &req);
+		if (req.memoryTypeBits & (1u << helpers.streaming_memory_type))
+		{
+			host.allocation = helpers.allocate(req.size, req.alignment, helpers.streaming_memory_type, Helpers::Mapped, Helpers::Workspace);
+			VK(vkBindBufferMemory(helpers.rtg.device, host.handle, host.allocation.handle, host.allocation.offset));
+			head = 0;
+			return;
+		}
+
+		// (this buffer can't live in that memory type after all; fall back to staging)
+		vkDestroyBuffer(helpers.rtg.device, host.handle, nullptr);
+		host.handle = VK_NULL_HANDLE;
+		host.size = 0;
+	}
+
+	host = helpers.create_buffer(
+		size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,											// have GPU copy data from host
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // host visible memory, coherent (no special sync needed)
+		Helpers::Mapped,															// put it somewhere in the CPU address space
+		Helpers::Workspace);
+	device = helpers.create_buffer(
+		size,
+		usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, // used by the pipelines, and a target of a memory copy
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,	  // on GPU, not host visible
+		Helpers::Unmapped,
+		Helpers::Workspace);
+	head = 0;
+}
+
+void UploadRing::destroy(Helpers &helpers)
+{
+	if (host.handle != VK_NULL_HANDLE)
+	{
+		helpers.destroy_buffer(std::move(host));
+	}
+	if (device.handle != VK_NULL_HANDLE)
+	{
+		helpers.destroy_buffer(std::move(device));
+	}
+	head = 0;
+}
+
+VkDeviceSize UploadRing::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+	VkDeviceSize offset = (head + alignment - 1) & ~(alignment - 1);
+	if (offset + size > capacity())
+		return VK_WHOLE_SIZE;
+
+	head = offset + size;
+	return offset;
+}
+
+void UploadRing::record_flush(VkCommandBuffer command_buffer, BarrierBatch &barriers, std::initializer_list<Use> uses) const
+{
+	if (reads_in_place() || head == 0)
+		return;
+
+	// one copy for everything streamed this frame:
+	VkBufferCopy copy_region{
+		.srcOffset = 0,
+		.dstOffset = 0,
+		.size = head};
+	vkCmdCopyBuffer(command_buffer, host.handle, device.handle, 1, &copy_region);
+
+	// ...but each piece only waits where it is read:
+	for (Use const &use : uses)
+	{
+		assert(use.size == 0 || use.offset + use.size <= head);
+		barriers.buffer(device.handle, use.offset, use.size,
+						VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+						use.stages, use.access);
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Source/VkMemory/BarrierBatch.hpp"
+#include "Source/VkMemory/Helpers.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <initializer_list>
+
+/*
+ * Per-frame streaming memory: one persistently mapped buffer that everything uploaded in a frame is bump-allocated from
+ *  (bind the pieces with dynamic offsets / vertex buffer offsets into buffer()).
+ *
+ *  ring.reset();                                  // start of the frame (the GPU is done with the previous contents)
+ *  VkDeviceSize offset = ring.allocate(size, alignment);
+ *  std::memcpy(ring.data(offset), src, size);
+ *  ring.record_flush(command_buffer, barriers, {     // before anything reads it,
+ *  	{offset, size, VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT}, // with how each piece is read
+ *  });
+ *  barriers.record(command_buffer);
+ *
+ * If Helpers found host-visible device-local memory (resizable BAR / unified memory) shaders read the mapped buffer in
+ *  place and record_flush does nothing; otherwise the used range goes to a device-local twin in a single copy,
+ *  followed by one barrier per piece (so storage buffers wait only on vertex shading, vertex data only on vertex input).
+ */
+struct UploadRing
+{
+	Helpers::AllocatedBuffer host;	 // host visible, coherent, persistently mapped
+	Helpers::AllocatedBuffer device; // device-local twin (empty when read in place)
+	VkDeviceSize head = 0;			 // bytes allocated since reset()
+
+	bool reads_in_place() const { return device.handle == VK_NULL_HANDLE; }
+	VkBuffer buffer() const { return reads_in_place() ? host.handle : device.handle; } // what descriptors and bindings should reference
+	VkDeviceSize capacity() const { return host.size; }
+
+	// usage: how buffer() is used by the pipelines (transfer usages are added as needed)
+	void create(Helpers &helpers, VkDeviceSize size, VkBufferUsageFlags usage);
+	void destroy(Helpers &helpers);
+
+	void reset() { head = 0; }
+
+	// reserve size bytes at an offset aligned to alignment (a power of two); returns VK_WHOLE_SIZE if the ring is full
+	VkDeviceSize allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+	void *data(VkDeviceSize offset) const { return reinterpret_cast<char *>(host.allocation.data()) + offset; }
+
+	// a piece of the ring and how the frame reads it:
+	struct Use
+	{
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0; // (empty uses are skipped)
+		VkPipelineStageFlags2 stages = 0;
+		VkAccessFlags2 access = 0;
+	};
+
+	// copy everything allocated since reset() to the device-local twin and add a barrier to barriers making each use
+	//  visible (nothing to do when read in place: host writes are visible to the GPU at submit)
+	void record_flush(VkCommandBuffer command_buffer, BarrierBatch &barriers, std::initializer_list<Use> uses) const;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Source/VkMemory/Helpers.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+/*
+ * A uniform block whose content carries a version, with one persistently mapped copy per workspace that is only
+ *  re-written when the version it holds is behind:
+ *
+ *  VersionedUniform<World> world;
+ *  world.create(helpers, workspace_count); // descriptors reference world.buffer(workspace_index)
+ *  world.set(value);                       // bumps the version only if the content actually changed
+ *  world.sync(workspace_index);            // once the workspace's previous submission is done
+ *
+ * Copies live in host-visible, coherent memory, so a write is visible to the GPU at submit with no copy recorded;
+ *  a workspace whose copy is current costs a comparison.
+ */
+template <typename T>
+struct VersionedUniform
+{
+	T value{};
+	uint64_t version = 1; // (copies start at 0, so each copy is written on its first sync)
+
+	struct Copy
+	{
+		Helpers::AllocatedBuffer buffer; // host visible, coherent, persistently mapped
+		uint64_t version = 0;			 // version of the value in buffer
+	};
+	std::vector<Copy> copies;
+
+	void create(Helpers &helpers, uint32_t count)
+	{
+		assert(copies.empty());
+		copies.resize(count);
+		for (Copy &copy : copies)
+		{
+			copy.buffer = helpers.create_buffer(
+				sizeof(T),
+				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,										   // read as a uniform buffer
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, // written by the host, no flushes needed
+				Helpers::Mapped,
+				Helpers::Workspace);
+		}
+	}
+
+	void destroy(Helpers &helpers)
+	{
+		for (Copy &copy : copies)
+		{
+			if (copy.buffer.handle != VK_NULL_HANDLE)
+				helpers.destroy_buffer(std::move(copy.buffer));
+		}
+		copies.clear();
+	}
+
+	VkBuffer buffer(uint32_t index) const { return copies[index].buffer.handle; }
+
+	// returns true if the content changed (and so the version was bumped)
+	bool set(T const &new_value)
+	{
+		if (std::memcmp(&new_value, &value, sizeof(T)) == 0)
+			return false;
+		value = new_value;
+		++version;
+		return true;
+	}
+
+	// bring copy `index` up to date (the GPU must not be reading it); returns true if it had to be written
+	bool sync(uint32_t index)
+	{
+		Copy &copy = copies[index];
+		if (copy.version == version)
+			return false;
+		std::memcpy(copy.buffer.allocation.data(), &value, sizeof(T));
+		copy.version = version;
+		return true;
+	}
+};
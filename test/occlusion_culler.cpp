@@ -0,0 +1,152 @@
+// OcclusionCuller against known depth buffers (no GPU needed; glm must be on the include path):
+//  g++ -std=c++20 -O2 -I. test/occlusion_culler.cpp Source/Culling/OcclusionCuller.cpp Source/DataType/BBox.cpp Source/Tools/ThreadPool.cpp -pthread -o test/build/occlusion_culler
+#include "Source/Culling/OcclusionCuller.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+static int failures = 0;
+
+#define CHECK(condition)                                                               \
+    do                                                                                 \
+    {                                                                                  \
+        if (!(condition))                                                              \
+        {                                                                              \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": failed: " #condition "\n"; \
+            ++failures;                                                                \
+        }                                                                              \
+    } while (0)
+
+// 64x32 pixels (8x4 tiles); with clip_from_world = identity, world x and y in [-1, 1] cover the buffer and world z is depth:
+static constexpr uint32_t Width = 64;
+static constexpr uint32_t Height = 32;
+
+static float world_x(float px) { return px / float(Width) * 2.0f - 1.0f; }
+static float world_y(float py) { return py / float(Height) * 2.0f - 1.0f; }
+
+// box covering pixels [px0, px1) x [py0, py1) (shrunk a little, so it doesn't touch the pixels around it) at depths [z0, z1]
+static BBox pixel_box(float px0, float py0, float px1, float py1, float z0, float z1)
+{
+    return BBox(glm::vec3(world_x(px0 + 0.1f), world_y(py0 + 0.1f), z0), glm::vec3(world_x(px1 - 0.1f), world_y(py1 - 0.1f), z1));
+}
+
+// write depth z into pixels [px0, px1) x [py0, py1), keeping the per-tile maximums (the Hi-Z level) up to date
+static void fill_depth(OcclusionCuller &culler, uint32_t px0, uint32_t py0, uint32_t px1, uint32_t py1, float z)
+{
+    uint32_t tile_size = OcclusionCuller::TileWidth * OcclusionCuller::TileHeight;
+    for (uint32_t y = py0; y < py1; ++y)
+    {
+        for (uint32_t x = px0; x < px1; ++x)
+        {
+            uint32_t tile = (y / OcclusionCuller::TileHeight) * culler.tiles_x + x / OcclusionCuller::TileWidth;
+            culler.depth[tile * tile_size + (y % OcclusionCuller::TileHeight) * OcclusionCuller::TileWidth + x % OcclusionCuller::TileWidth] = z;
+        }
+    }
+    for (uint32_t tile = 0; tile < culler.tile_max_depth.size(); ++tile)
+    {
+        float farthest = 0.0f;
+        for (uint32_t i = 0; i < tile_size; ++i)
+        {
+            farthest = std::max(farthest, culler.depth[tile * tile_size + i]);
+        }
+        culler.tile_max_depth[tile] = farthest;
+    }
+}
+
+static void test_cleared()
+{
+    OcclusionCuller culler(Width, Height);
+    culler.begin_frame(glm::mat4(1.0f));
+
+    // nothing rasterized: everything is in front of the far plane
+    CHECK(culler.is_bbox_visible(pixel_box(8, 8, 16, 16, 0.5f, 0.9f)));
+    CHECK(culler.is_bbox_visible(pixel_box(0, 0, 64, 32, 0.99f, 0.999f)));
+    CHECK(culler.stats.tested == 2 && culler.stats.culled == 0);
+}
+
+static void test_known_depth()
+{
+    OcclusionCuller culler(Width, Height);
+    culler.begin_frame(glm::mat4(1.0f));
+
+    // left half at depth 0.5, right half cleared:
+    fill_depth(culler, 0, 0, 32, 32, 0.5f);
+
+    CHECK(!culler.is_bbox_visible(pixel_box(4, 4, 28, 28, 0.6f, 0.9f))); // behind, fully over the near half
+    CHECK(culler.is_bbox_visible(pixel_box(4, 4, 28, 28, 0.3f, 0.4f)));  // in front
+    CHECK(culler.is_bbox_visible(pixel_box(4, 4, 28, 28, 0.4f, 0.9f)));  // nearest point in front
+    CHECK(culler.is_bbox_visible(pixel_box(4, 4, 28, 28, 0.5f, 0.9f)));  // touching the occluder depth counts as visible
+    CHECK(culler.is_bbox_visible(pixel_box(24, 4, 40, 28, 0.6f, 0.9f))); // reaches over the cleared half
+    CHECK(culler.is_bbox_visible(pixel_box(40, 4, 60, 28, 0.6f, 0.9f))); // only over the cleared half
+    CHECK(culler.stats.tested == 6 && culler.stats.culled == 1);
+}
+
+static void test_hole_in_tile()
+{
+    OcclusionCuller culler(Width, Height);
+    culler.begin_frame(glm::mat4(1.0f));
+
+    // everything near except one far pixel, (13, 10), in the middle of tile (1, 1):
+    fill_depth(culler, 0, 0, Width, Height, 0.25f);
+    fill_depth(culler, 13, 10, 14, 11, 1.0f);
+
+    CHECK(culler.is_bbox_visible(pixel_box(12, 9, 15, 12, 0.5f, 0.6f)));   // over the hole
+    CHECK(!culler.is_bbox_visible(pixel_box(8, 12, 12, 16, 0.5f, 0.6f)));  // same tile, beside the hole
+    CHECK(!culler.is_bbox_visible(pixel_box(16, 8, 24, 16, 0.5f, 0.6f)));  // next tile (skipped by its maximum)
+    CHECK(culler.is_bbox_visible(pixel_box(16, 8, 24, 16, 0.1f, 0.6f)));   // in front of everything
+}
+
+static void test_rasterized_occluder()
+{
+    OcclusionCuller culler(Width, Height);
+    culler.begin_frame(glm::mat4(1.0f));
+
+    // a flat quad at depth 0.5 over pixels [16, 48) x [8, 24):
+    float x0 = world_x(16), x1 = world_x(48), y0 = world_y(8), y1 = world_y(24);
+    culler.add_occluder({
+                            glm::vec3(x0, y0, 0.5f), glm::vec3(x1, y0, 0.5f), glm::vec3(x1, y1, 0.5f),
+                            glm::vec3(x0, y0, 0.5f), glm::vec3(x1, y1, 0.5f), glm::vec3(x0, y1, 0.5f),
+                        },
+                        glm::mat4(1.0f));
+    ThreadPool pool(0);
+    culler.rasterize_occluders(pool);
+    CHECK(culler.stats.occluders == 1 && culler.stats.triangles == 2);
+
+    CHECK(!culler.is_bbox_visible(pixel_box(20, 10, 44, 22, 0.6f, 0.8f))); // behind the quad
+    CHECK(culler.is_bbox_visible(pixel_box(20, 10, 44, 22, 0.2f, 0.8f)));  // reaching in front of it
+    CHECK(culler.is_bbox_visible(pixel_box(8, 10, 20, 22, 0.6f, 0.8f)));   // sticking out past its left edge
+    CHECK(culler.is_bbox_visible(pixel_box(20, 26, 44, 30, 0.6f, 0.8f)));  // below it
+}
+
+static void test_near_plane()
+{
+    // w = z, so boxes reaching z < NearW are (partly) behind the camera:
+    glm::mat4 clip_from_world(1.0f);
+    clip_from_world[2][3] = 1.0f;
+    clip_from_world[3][3] = 0.0f;
+
+    OcclusionCuller culler(Width, Height);
+    culler.begin_frame(clip_from_world);
+    fill_depth(culler, 0, 0, Width, Height, 0.0f); // (nearest possible everywhere)
+
+    CHECK(culler.is_bbox_visible(BBox(glm::vec3(-0.1f, -0.1f, -1.0f), glm::vec3(0.1f, 0.1f, 2.0f))));
+    CHECK(culler.screen_coverage(BBox(glm::vec3(-0.1f, -0.1f, -1.0f), glm::vec3(0.1f, 0.1f, 2.0f))) == 1.0f);
+    CHECK(!culler.is_bbox_visible(BBox(glm::vec3(-0.1f, -0.1f, 1.0f), glm::vec3(0.1f, 0.1f, 2.0f))));
+}
+
+int main()
+{
+    test_cleared();
+    test_known_depth();
+    test_hole_in_tile();
+    test_rasterized_occluder();
+    test_near_plane();
+
+    if (failures != 0)
+    {
+        std::cout << failures << " checks failed.\n";
+        return 1;
+    }
+    std::cout << "All checks passed.\n";
+    return 0;
+}
@@ -0,0 +1,216 @@
+// CPU time to record the objects' per-draw texture selection for a 10k-instance scene, with a descriptor set bind per
+//  draw (the default) vs. a push constant per draw (--push-constants). Needs a Vulkan device (no window):
+//  g++ -std=c++20 -O2 -I. -I${VULKAN_SDK}/include test/recording_benchmark.cpp -L${VULKAN_SDK}/lib -lvulkan -o test/build/recording_benchmark
+//
+// The draws themselves are the same either way, so only what differs is recorded: worst case, every instance has its own
+//  texture (Textures sets, used round-robin), so every draw switches. Recording happens outside a render pass and never
+//  draws, so the sets can stay unwritten.
+#include "Source/Helper/VK.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+static constexpr uint32_t Instances = 10000;
+static constexpr uint32_t Textures = 256;
+static constexpr uint32_t Runs = 200;
+
+// same layout as ObjectsPipeline::Push:
+struct Push
+{
+    uint32_t MATERIAL;
+    uint32_t TEXTURE;
+    uint32_t FLAGS;
+};
+
+int main()
+{
+    VkApplicationInfo app_info{
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .pApplicationName = "recording benchmark",
+        .apiVersion = VK_API_VERSION_1_2,
+    };
+    VkInstanceCreateInfo instance_info{
+        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .pApplicationInfo = &app_info,
+    };
+    VkInstance instance = VK_NULL_HANDLE;
+    VK(vkCreateInstance(&instance_info, nullptr, &instance));
+
+    uint32_t physical_device_count = 0;
+    VK(vkEnumeratePhysicalDevices(instance, &physical_device_count, nullptr));
+    if (physical_device_count == 0)
+    {
+        std::cerr << "No Vulkan devices." << std::endl;
+        return 1;
+    }
+    std::vector<VkPhysicalDevice> physical_devices(physical_device_count);
+    VK(vkEnumeratePhysicalDevices(instance, &physical_device_count, physical_devices.data()));
+    VkPhysicalDevice physical_device = physical_devices[0];
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+    uint32_t graphics_family = 0;
+    while (graphics_family < family_count && !(families[graphics_family].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+        ++graphics_family;
+    if (graphics_family == family_count)
+    {
+        std::cerr << "No graphics queue on " << properties.deviceName << "." << std::endl;
+        return 1;
+    }
+
+    float priority = 1.0f;
+    VkDeviceQueueCreateInfo queue_info{
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .queueFamilyIndex = graphics_family,
+        .queueCount = 1,
+        .pQueuePriorities = &priority,
+    };
+    VkDeviceCreateInfo device_info{
+        .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .queueCreateInfoCount = 1,
+        .pQueueCreateInfos = &queue_info,
+    };
+    VkDevice device = VK_NULL_HANDLE;
+    VK(vkCreateDevice(physical_device, &device_info, nullptr, &device));
+
+    // sets 0 and 1 stand in for the objects pipeline's (not re-bound per draw); set 2 is one texture, as in Textures:
+    VkDescriptorSetLayoutCreateInfo empty_info{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+    };
+    VkDescriptorSetLayout empty_layout = VK_NULL_HANDLE;
+    VK(vkCreateDescriptorSetLayout(device, &empty_info, nullptr, &empty_layout));
+
+    VkDescriptorSetLayoutBinding texture_binding{
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+    };
+    VkDescriptorSetLayoutCreateInfo texture_info{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &texture_binding,
+    };
+    VkDescriptorSetLayout texture_layout = VK_NULL_HANDLE;
+    VK(vkCreateDescriptorSetLayout(device, &texture_info, nullptr, &texture_layout));
+
+    std::array<VkDescriptorSetLayout, 3> set_layouts{empty_layout, empty_layout, texture_layout};
+    VkPushConstantRange push_range{
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .offset = 0,
+        .size = sizeof(Push),
+    };
+    VkPipelineLayoutCreateInfo layout_info{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = uint32_t(set_layouts.size()),
+        .pSetLayouts = set_layouts.data(),
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_range,
+    };
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VK(vkCreatePipelineLayout(device, &layout_info, nullptr, &layout));
+
+    VkDescriptorPoolSize pool_size{
+        .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = Textures,
+    };
+    VkDescriptorPoolCreateInfo pool_info{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = Textures,
+        .poolSizeCount = 1,
+        .pPoolSizes = &pool_size,
+    };
+    VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+    VK(vkCreateDescriptorPool(device, &pool_info, nullptr, &descriptor_pool));
+
+    std::vector<VkDescriptorSetLayout> texture_layouts(Textures, texture_layout);
+    VkDescriptorSetAllocateInfo sets_info{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptor_pool,
+        .descriptorSetCount = Textures,
+        .pSetLayouts = texture_layouts.data(),
+    };
+    std::vector<VkDescriptorSet> texture_descriptors(Textures);
+    VK(vkAllocateDescriptorSets(device, &sets_info, texture_descriptors.data()));
+
+    VkCommandPoolCreateInfo command_pool_info{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = graphics_family,
+    };
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    VK(vkCreateCommandPool(device, &command_pool_info, nullptr, &command_pool));
+
+    VkCommandBufferAllocateInfo command_buffer_info{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    VK(vkAllocateCommandBuffers(device, &command_buffer_info, &command_buffer));
+
+    // record Instances texture selections Runs times; returns the average time per recording:
+    auto measure = [&](bool push_constants) -> double
+    {
+        double total = 0.0;
+        for (uint32_t run = 0; run < Runs; ++run)
+        {
+            VK(vkResetCommandBuffer(command_buffer, 0));
+            VkCommandBufferBeginInfo begin_info{
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            };
+
+            auto start = std::chrono::high_resolution_clock::now();
+
+            VK(vkBeginCommandBuffer(command_buffer, &begin_info));
+            for (uint32_t i = 0; i < Instances; ++i)
+            {
+                uint32_t texture = i % Textures;
+                if (push_constants)
+                {
+                    Push push{.MATERIAL = texture, .TEXTURE = texture, .FLAGS = 0};
+                    vkCmdPushConstants(command_buffer, layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push), &push);
+                }
+                else
+                {
+                    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 2, 1, &texture_descriptors[texture], 0, nullptr);
+                }
+            }
+            VK(vkEndCommandBuffer(command_buffer));
+
+            auto end = std::chrono::high_resolution_clock::now();
+            total += std::chrono::duration<double>(end - start).count();
+        }
+        return total / Runs;
+    };
+
+    measure(false); // (warm up the command pool's memory)
+    double binds = measure(false);
+    double pushes = measure(true);
+
+    std::cout << properties.deviceName << ", " << Instances << " draws, average of " << Runs << " recordings:\n";
+    std::cout << "  descriptor set binds: " << binds * 1e6 << " us (" << binds * 1e9 / Instances << " ns per draw)\n";
+    std::cout << "  push constants:       " << pushes * 1e6 << " us (" << pushes * 1e9 / Instances << " ns per draw)\n";
+
+    vkDestroyCommandPool(device, command_pool, nullptr);
+    vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+    vkDestroyPipelineLayout(device, layout, nullptr);
+    vkDestroyDescriptorSetLayout(device, texture_layout, nullptr);
+    vkDestroyDescriptorSetLayout(device, empty_layout, nullptr);
+    vkDestroyDevice(device, nullptr);
+    vkDestroyInstance(instance, nullptr);
+
+    return 0;
+}